@@ -1,24 +1,21 @@
 #ifndef __APP_H__
 #define __APP_H__
 
+#include <stdint.h>
+
 typedef enum {
-	STAGE_START_ENTER = 0,
-	STAGE_START,
-	STAGE_START_EXIT,
-	STAGE_MAINMENU_ENTER,
+	STAGE_START = 0,
 	STAGE_MAINMENU,
-	STAGE_MAINMENU_EXIT,
-	STAGE_SNAKE_ENTER,
 	STAGE_SNAKE,
-	STAGE_SNAKE_EXIT,
-	STAGE_TEST_ENTER,
 	STAGE_TEST,
-	STAGE_TEST_EXIT,
 	STAGE_RESET,
+	STAGE_COUNT,
 } App_Stage_t;
 
 void App_Init(void);
-void App_Loop(void);
+void App_Start(void);
 void App_Set_Stage(App_Stage_t stage_new);
+uint8_t App_Get_Player(void);
+uint32_t App_Get_Changes(void);
 
 #endif /* __APP_H__ */
@@ -147,14 +147,33 @@
 #define CONN_P(x) ((int)((x)/1.25f))
 #define SCAN_P (0x400)
 #define SCAN_L (0x400)
+/* Scan window while a controller is connected, a quarter of the interval */
+#define SCAN_L_CONNECTED (0x100)
 #define CONN_P1   (CONN_P(50))
 #define CONN_P2   (CONN_P(100))
 #define SUPERV_TIMEOUT (0x1F4)
 #define CONN_L1   (CONN_L(10))
 #define CONN_L2   (CONN_L(10))
+/* Connection profiles applied once connected, low latency in game stages and relaxed in menus */
+#define CONN_GAME_P          (CONN_P(7.5))
+#define CONN_GAME_LATENCY    (0)
+#define CONN_GAME_L          (CONN_L(2.5))
+#define CONN_MENU_P1         (CONN_P(30))
+#define CONN_MENU_P2         (CONN_P(45))
+#define CONN_MENU_LATENCY    (4)
+#define CONN_MENU_L          (CONN_L(5))
+/* Data length extension, largest LL payload and its time on LE 1M */
+#define CONN_DLE_OCTETS      (251)
+#define CONN_DLE_TIME        (2120)
 #define OOB_DEMO                                0   /* Out Of Box Demo */
 
 /* USER CODE BEGIN Specific_Parameters */
+/* Bonded controllers are reconnected directly, a general discovery runs when none shows up in time */
+#define RECONNECT_TIMEOUT_MS    (8000)
+#define RECONNECT_MAX_PEERS     (4)
+/* With a controller connected, an empty discovery delays the next search, doubling up to the max */
+#define SCAN_BACKOFF_MIN_MS     (2000)
+#define SCAN_BACKOFF_MAX_MS     (32000)
 
 /* USER CODE END Specific_Parameters */
 
@@ -442,8 +461,9 @@
 /**
  *  When set to 1, the low power mode is enable
  *  When set to 0, the device stays in RUN mode
+ *  The power module enters Stop2 when the timers and the debug UART allow it
  */
-#define CFG_LPM_SUPPORTED    0
+#define CFG_LPM_SUPPORTED    1
 
 /******************************************************************************
  * RTC interface
@@ -574,10 +594,9 @@ typedef enum
 #define CFG_DEBUG_TRACE             1
 #endif
 
+/* The debug UART holds off Stop2 until its buffers are sent, traces and low power can run together */
 #if (CFG_DEBUG_TRACE != 0)
-#undef CFG_LPM_SUPPORTED
 #undef CFG_DEBUGGER_SUPPORTED
-#define CFG_LPM_SUPPORTED           0
 #define CFG_DEBUGGER_SUPPORTED      1
 #endif
 
@@ -607,8 +626,9 @@ typedef enum
 
 /**
  * When not set, the traces is looping on sending the trace over UART
+ * Not set, DbgOutputTraces copies into the dbg_out buffers and returns at once
  */
-#define DBG_TRACE_USE_CIRCULAR_QUEUE 1
+#define DBG_TRACE_USE_CIRCULAR_QUEUE 0
 
 /**
  * max buffer Size to queue data traces and max data trace allowed.
@@ -618,6 +638,15 @@ typedef enum
 #define MAX_DBG_TRACE_MSG_SIZE   1024
 
 /* USER CODE BEGIN Defines */
+/**
+ * Binary trace records, independent of the text traces so they can stay in release builds
+ */
+#define CFG_TRACE_ENABLED           1
+
+/**
+ * Profiling zones, timed with the cycle counter, see profile.h
+ */
+#define CFG_PROFILE_ENABLED         1
 
 /* USER CODE END Defines */
 
@@ -640,6 +669,7 @@ typedef enum
   CFG_TASK_PAIR_DEV_ID,
   CFG_TASK_SEARCH_SERVICE_ID,
   CFG_TASK_CONN_UPDATE_ID,
+  CFG_TASK_HID_OUTPUT_ID,
   CFG_TASK_HCI_ASYNCH_EVT_ID,
   CFG_LAST_TASK_ID_WITH_HCICMD,                                               /**< Shall be LAST in the list */
 } CFG_Task_Id_With_HCI_Cmd_t;
@@ -650,6 +680,12 @@ typedef enum
   CFG_FIRST_TASK_ID_WITH_NO_HCICMD = CFG_LAST_TASK_ID_WITH_HCICMD - 1,        /**< Shall be FIRST in the list */
   CFG_TASK_SYSTEM_HCI_ASYNCH_EVT_ID,
   /* USER CODE BEGIN CFG_Task_Id_With_NO_HCI_Cmd_t */
+  CFG_TASK_APP_FRAME_ID,
+  CFG_TASK_APP_INPUT_ID,
+  CFG_TASK_APP_BATTERY_ID,
+  CFG_TASK_APP_LINK_ID,
+  CFG_TASK_TRACE_ID,
+  CFG_TASK_HR_TIMER_ID,
 
   /* USER CODE END CFG_Task_Id_With_NO_HCI_Cmd_t */
   CFG_LAST_TASK_ID_WITH_NO_HCICMD                                            /**< Shall be LAST in the list */
@@ -694,7 +730,10 @@ typedef enum
   CFG_LPM_APP,
   CFG_LPM_APP_BLE,
   /* USER CODE BEGIN CFG_LPM_Id_t */
-
+  CFG_LPM_APP_DEADLINE,
+  CFG_LPM_APP_TRACE,
+  CFG_LPM_APP_BUZZER,
+  CFG_LPM_APP_HR_TIMER,
   /* USER CODE END CFG_LPM_Id_t */
 } CFG_LPM_Id_t;
 
@@ -4,8 +4,8 @@
 #include "main.h"
 
 extern TIM_HandleTypeDef BUZZER_TIM_HANDLE;
-extern TIM_HandleTypeDef BUZZER_TIM2_HANDLE;
 
+void Buzzer_Init(void);
 void Buzzer_Play_Boot(void);
 void Buzzer_Play_Connected(void);
 void Buzzer_Play_Menu_Move(void);
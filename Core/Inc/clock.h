@@ -0,0 +1,32 @@
+#ifndef __CLOCK_H__
+#define __CLOCK_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Frame work above this at 32 MHz boosts the next frames to 64 MHz
+#define CLOCK_BOOST_US 6000
+// Boosted frames all under this for CLOCK_RELAX_FRAMES drop back to 32 MHz
+#define CLOCK_RELAX_US 2500
+#define CLOCK_RELAX_FRAMES 30
+
+typedef enum {
+	CLOCK_HSE_32MHZ = 0,
+	CLOCK_PLL_64MHZ,
+	CLOCK_LEVEL_COUNT,
+} Clock_Level_t;
+
+typedef struct {
+	uint64_t residency_us[CLOCK_LEVEL_COUNT];
+	uint32_t switches;
+} Clock_Stats_t;
+
+void Clock_Init(void);
+void Clock_Set(Clock_Level_t level);
+Clock_Level_t Clock_Get_Level(void);
+void Clock_Governor_Frame(uint32_t work_us);
+void Clock_Governor_Idle(void);
+const Clock_Stats_t* Clock_Get_Stats(void);
+void Clock_Dump(void);
+
+#endif /* __CLOCK_H__ */
@@ -0,0 +1,25 @@
+#ifndef __DBG_OUT_H__
+#define __DBG_OUT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Buffers filled in turn, one is sent by the UART DMA while the next ones fill
+#define DBG_OUT_BUFFERS 2
+#define DBG_OUT_BUFFER_SIZE 2048
+// A buffer is sent once it holds that much, or once its first byte is that old
+#define DBG_OUT_FLUSH_SIZE 256
+#define DBG_OUT_FLUSH_MS 5
+
+typedef struct {
+	uint32_t bytes;
+	uint32_t transfers;
+	uint32_t dropped;		// Bytes of the writes lost because the buffers did not have room for them
+} Dbg_Out_Stats_t;
+
+void Dbg_Out_Init(void);
+bool Dbg_Out_Write(const uint8_t *data, uint16_t size);
+void Dbg_Out_Flush(void);
+const Dbg_Out_Stats_t* Dbg_Out_Get_Stats(void);
+
+#endif /* __DBG_OUT_H__ */
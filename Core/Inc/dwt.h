@@ -0,0 +1,23 @@
+#ifndef __DWT_H__
+#define __DWT_H__
+
+#include <stdint.h>
+#include "main.h"
+
+// At the current clock, convert each sample before summing, the clock level may change between them
+#define DWT_CYCLES_TO_US(cycles) ((uint32_t) ((uint64_t) (cycles) * 1000000UL / SystemCoreClock))
+
+/*
+ * Cycle counter of the Cortex-M4 debug unit, wraps around every 2^32 cycles (134 s at 32 MHz).
+ * It does not count while the core sleeps.
+ */
+static inline void Dwt_Init(void) {
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+static inline uint32_t Dwt_Get_Cycles(void) {
+	return DWT->CYCCNT;
+}
+
+#endif /* __DWT_H__ */
@@ -0,0 +1,28 @@
+#ifndef __FRAME_H__
+#define __FRAME_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FRAME_RATE 60
+#define FRAME_STEP_US (1000000UL / FRAME_RATE)
+// Updates run back to back at most this many times after a late frame, older time is dropped
+#define FRAME_MAX_CATCH_UP 4
+
+typedef struct {
+	uint32_t runs;
+	uint32_t frames;
+	uint32_t updates;
+	uint32_t dropped_us;
+	uint32_t busy_us;
+	uint32_t worst_us;		// Longest frame since the last Frame_Clear_Worst
+} Frame_Stats_t;
+
+void Frame_Init(void (*update)(void), void (*render)(void));
+void Frame_Start(void);
+void Frame_Wake(void);
+void Frame_Request(void);
+const Frame_Stats_t* Frame_Get_Stats(void);
+void Frame_Clear_Worst(void);
+
+#endif /* __FRAME_H__ */
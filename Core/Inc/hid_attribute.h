@@ -0,0 +1,46 @@
+#ifndef __HID_ATTRIBUTE_H__
+#define __HID_ATTRIBUTE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define HID_MAX_ATTRIBUTES 32
+
+/* Characteristic of the peer database, with the descriptors that follow its value */
+typedef struct {
+	uint16_t Uuid;				// 0 for 128 bit UUIDs
+	uint16_t ValueHandle;
+	uint16_t CccdHandle;
+	uint16_t ReportRefHandle;
+	uint8_t Properties;
+} HID_Attribute_t;
+
+/* Characteristics of the whole database, sorted by handle, filled by a single discovery pass */
+typedef struct {
+	HID_Attribute_t Attributes[HID_MAX_ATTRIBUTES];
+	uint8_t Count;
+} HID_Attribute_Table_t;
+
+/* Handles used by the HID host, 0 when the peer does not have them */
+typedef struct {
+	uint16_t Report1;
+	uint16_t Report1Cccd;
+	uint16_t Report1Ref;
+	uint16_t Report2;
+	uint16_t Report2Ref;
+	uint16_t OutputReport;
+	uint16_t ReportMap;
+	uint16_t Information;
+	uint16_t BatteryLevel;
+	uint16_t BatteryLevelCccd;
+	uint16_t ServiceChanged;
+	uint16_t ServiceChangedCccd;
+} HID_Attribute_Handles_t;
+
+void HID_Attribute_Reset(HID_Attribute_Table_t *table);
+void HID_Attribute_Characs(HID_Attribute_Table_t *table, const uint8_t *data, uint8_t length, uint8_t pair_length);
+void HID_Attribute_Descs(HID_Attribute_Table_t *table, const uint8_t *data, uint8_t length);
+const HID_Attribute_t* HID_Attribute_Find(const HID_Attribute_Table_t *table, uint16_t uuid, uint8_t nth);
+bool HID_Attribute_Resolve(const HID_Attribute_Table_t *table, HID_Attribute_Handles_t *handles);
+
+#endif /* __HID_ATTRIBUTE_H__ */
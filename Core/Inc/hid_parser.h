@@ -0,0 +1,48 @@
+#ifndef __HID_PARSER_H__
+#define __HID_PARSER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hid_host_app.h"
+
+#define HID_PARSER_MAP_SIZE 512
+#define HID_PARSER_MAX_FIELDS 24
+#define HID_PARSER_MAX_USAGES 16
+#define HID_PARSER_MAX_REPORTS 8
+
+typedef enum {
+	HID_FIELD_AXIS = 0,
+	HID_FIELD_TRIGGER,
+	HID_FIELD_HAT,
+	HID_FIELD_BUTTON,
+} HID_Field_Kind_t;
+
+/*
+ * One value of the report, extracted with a little-endian load of bytes from byte,
+ * then shifted and masked, and scaled into the field of HID_Report_t at dest.
+ */
+typedef struct {
+	uint8_t byte;
+	uint8_t bytes;
+	uint8_t shift;
+	uint8_t kind;
+	uint8_t dest;			// offsetof in HID_Report_t
+	uint32_t mask;
+	int32_t min;
+	uint32_t range;
+	uint32_t scale;			// Q16, range to the output range
+} HID_Field_t;
+
+typedef struct {
+	uint8_t report_id;		// 0 when the descriptor does not use report IDs
+	uint8_t length;			// Shortest report holding every field
+	uint8_t count;
+	HID_Field_t fields[HID_PARSER_MAX_FIELDS];
+} HID_Plan_t;
+
+bool HID_Parser_Compile(const uint8_t *map, uint16_t length, HID_Plan_t *plan);
+void HID_Parser_Default(HID_Plan_t *plan);
+void HID_Parser_Neutral(HID_Report_t *report);
+bool HID_Parser_Decode(const HID_Plan_t *plan, const uint8_t *data, uint16_t length, HID_Report_t *report);
+
+#endif /* __HID_PARSER_H__ */
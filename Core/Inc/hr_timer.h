@@ -0,0 +1,26 @@
+#ifndef __HR_TIMER_H__
+#define __HR_TIMER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 1 us timers on the 32-bit TIM2, its clock stays at 32 MHz whatever the core clock
+#define HR_TIMER_MAX 8
+#define HR_TIMER_TICK_HZ 1000000UL
+
+typedef enum {
+	HR_TIMER_SINGLE_SHOT = 0,
+	HR_TIMER_REPEATED,
+} Hr_Timer_Mode_t;
+
+// Run from a sequencer task without HCI commands
+typedef void (*Hr_Timer_Cb_t)(void);
+
+void Hr_Timer_Init(void);
+bool Hr_Timer_Create(uint8_t *id, Hr_Timer_Mode_t mode, Hr_Timer_Cb_t callback);
+void Hr_Timer_Start(uint8_t id, uint32_t delay_us);
+void Hr_Timer_Stop(uint8_t id);
+bool Hr_Timer_Is_Running(uint8_t id);
+uint32_t Hr_Timer_Now(void);
+
+#endif /* __HR_TIMER_H__ */
@@ -0,0 +1,17 @@
+#ifndef __HUD_H__
+#define __HUD_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ui.h"
+#include "hid_host_app.h"
+
+#define HUD_WIDTH 100
+#define HUD_HEIGHT 15
+#define HUD_UPDATE_MS 250
+
+void Hud_Init(UI_Rect_t bounds, uint16_t color, uint16_t bgcolor);
+UI_Widget_t* Hud_Get_Widget(void);
+void Hud_Update(HID_Report_t *report);
+
+#endif /* __HUD_H__ */
@@ -0,0 +1,118 @@
+#ifndef __INPUT_H__
+#define __INPUT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hid_host_app.h"
+
+// Per player, must be a power of two
+#define INPUT_QUEUE_SIZE 32
+
+#define INPUT_REPEAT_DELAY_MS 400
+#define INPUT_REPEAT_PERIOD_MS 120
+
+// Sticks and triggers act as keys, with hysteresis between press and release, on the normalized values
+#define INPUT_STICK_PRESS 0x5000
+#define INPUT_STICK_RELEASE 0x3000
+#define INPUT_TRIGGER_PRESS 0x4000
+#define INPUT_TRIGGER_RELEASE 0x3000
+
+// Analog values are Q15, INPUT_ANALOG_MAX is full deflection
+#define INPUT_ANALOG_MAX 0x7FFF
+// Radial deadzone of the sticks, the range between is rescaled to the full output range
+#define INPUT_STICK_DEADZONE 0x0C00
+#define INPUT_STICK_SATURATION 0x7800
+#define INPUT_TRIGGER_DEADZONE 0x0200
+// 8-way direction, set past the press magnitude, kept until under the release one or 30 degrees away
+#define INPUT_DIR_PRESS 0x4000
+#define INPUT_DIR_RELEASE 0x2800
+#define INPUT_DIR_KEEP_COS 0x6EDA
+// A stick is only calibrated when it rests that close to the nominal center
+#define INPUT_CALIBRATE_RANGE 0x1000
+
+typedef enum {
+	INPUT_KEY_A = 0,
+	INPUT_KEY_B,
+	INPUT_KEY_X,
+	INPUT_KEY_Y,
+	INPUT_KEY_LB,
+	INPUT_KEY_RB,
+	INPUT_KEY_VIEW,
+	INPUT_KEY_MENU,
+	INPUT_KEY_XBOX,
+	INPUT_KEY_PROFILE,
+	INPUT_KEY_LSTICK,
+	INPUT_KEY_RSTICK,
+	INPUT_KEY_UP,
+	INPUT_KEY_DOWN,
+	INPUT_KEY_LEFT,
+	INPUT_KEY_RIGHT,
+	INPUT_KEY_LSTICK_UP,
+	INPUT_KEY_LSTICK_DOWN,
+	INPUT_KEY_LSTICK_LEFT,
+	INPUT_KEY_LSTICK_RIGHT,
+	INPUT_KEY_RSTICK_UP,
+	INPUT_KEY_RSTICK_DOWN,
+	INPUT_KEY_RSTICK_LEFT,
+	INPUT_KEY_RSTICK_RIGHT,
+	INPUT_KEY_LT,
+	INPUT_KEY_RT,
+	INPUT_KEY_COUNT,
+} Input_Key_t;
+
+#define INPUT_MASK(key) (1UL << (key))
+
+/* Same numbering as the HAT switch */
+typedef enum {
+	INPUT_DIR_NONE = HATSWITCH_NONE,
+	INPUT_DIR_UP = HATSWITCH_UP,
+	INPUT_DIR_UPRIGHT = HATSWITCH_UPRIGHT,
+	INPUT_DIR_RIGHT = HATSWITCH_RIGHT,
+	INPUT_DIR_DOWNRIGHT = HATSWITCH_DOWNRIGHT,
+	INPUT_DIR_DOWN = HATSWITCH_DOWN,
+	INPUT_DIR_DOWNLEFT = HATSWITCH_DOWNLEFT,
+	INPUT_DIR_LEFT = HATSWITCH_LEFT,
+	INPUT_DIR_UPLEFT = HATSWITCH_UPLEFT,
+} Input_Direction_t;
+
+typedef struct {
+	int16_t x;				// Q15, grows rightwards, 0 inside the deadzone
+	int16_t y;				// Q15, grows upwards
+	uint16_t magnitude;		// Q15, at most INPUT_ANALOG_MAX
+	uint8_t direction;		// Input_Direction_t
+} Input_Stick_t;
+
+typedef struct {
+	Input_Stick_t left;
+	Input_Stick_t right;
+	uint16_t left_trigger;	// Q15
+	uint16_t right_trigger;
+} Input_Analog_t;
+
+typedef enum {
+	INPUT_PRESS = 0,
+	INPUT_RELEASE,
+	INPUT_REPEAT,
+} Input_Event_Type_t;
+
+typedef struct {
+	uint32_t tick;
+	uint32_t stamp;		// Latency clock at notification time
+	uint8_t key;
+	uint8_t type;
+	uint8_t player;
+} Input_Event_t;
+
+bool Input_Report(uint8_t player, const HID_Report_t *report, uint32_t tick, uint32_t stamp);
+uint32_t Input_Poll(uint32_t tick);
+bool Input_Get_Event(Input_Event_t *event);
+bool Input_Get_Player_Event(uint8_t player, Input_Event_t *event);
+void Input_Flush(void);
+uint32_t Input_Get_Held(void);
+uint32_t Input_Get_Player_Held(uint8_t player);
+void Input_Set_Repeat(uint32_t mask, uint16_t delay_ms, uint16_t period_ms);
+uint32_t Input_Get_Dropped(void);
+bool Input_Get_Analog(uint8_t player, Input_Analog_t *analog);
+bool Input_Calibrate(uint8_t player);
+
+#endif /* __INPUT_H__ */
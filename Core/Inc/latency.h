@@ -0,0 +1,19 @@
+#ifndef __LATENCY_H__
+#define __LATENCY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "app.h"
+
+#define LATENCY_BUCKET_US 500
+#define LATENCY_BUCKETS 96
+
+uint32_t Latency_Now(void);
+void Latency_Arm(uint32_t stamp);
+void Latency_Photon(void);
+void Latency_Frame_End(void);
+void Latency_Set_Stage(App_Stage_t stage);
+void Latency_Dump(App_Stage_t stage, const char *name);
+void Latency_Reset(void);
+
+#endif /* __LATENCY_H__ */
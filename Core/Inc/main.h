@@ -65,7 +65,7 @@ void MX_USART1_UART_Init(void);
 /* Private defines -----------------------------------------------------------*/
 #define ST7735_SPI_PORT hspi1
 #define BUZZER_TIM_HANDLE htim1
-#define BUZZER_TIM2_HANDLE htim2
+#define HR_TIMER_TIM_HANDLE htim2
 #define ST7735_DC_Pin GPIO_PIN_2
 #define ST7735_DC_GPIO_Port GPIOA
 #define ST7735_CS_Pin GPIO_PIN_3
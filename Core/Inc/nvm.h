@@ -0,0 +1,18 @@
+#ifndef __NVM_H__
+#define __NVM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Multiple of 8, flash is programmed by double words
+#define NVM_SLOT_SIZE 1536
+
+typedef enum {
+	NVM_SLOT_GATT_CACHE = 0,
+	NVM_SLOT_COUNT,
+} Nvm_Slot_t;
+
+bool Nvm_Read(Nvm_Slot_t slot, void *data, uint16_t size);
+bool Nvm_Write(Nvm_Slot_t slot, const void *data, uint16_t size);
+
+#endif /* __NVM_H__ */
@@ -0,0 +1,41 @@
+#ifndef __POWER_H__
+#define __POWER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Stop2 is only entered when the next timer server timer is further away, the HSE restarts on wake up
+#define POWER_STOP_MIN_US 2000
+
+typedef enum {
+	POWER_RUN = 0,
+	POWER_SLEEP,
+	POWER_STOP,
+	POWER_STATE_COUNT,
+} Power_State_t;
+
+typedef enum {
+	POWER_WAKE_TIMER = 0,	// Timer server, frames included
+	POWER_WAKE_BLE,			// IPCC or HSEM from CPU2
+	POWER_WAKE_UART,
+	POWER_WAKE_HR_TIMER,
+	POWER_WAKE_TICK,
+	POWER_WAKE_OTHER,
+	POWER_WAKE_COUNT,
+} Power_Wake_t;
+
+typedef struct {
+	uint64_t residency_us[POWER_STATE_COUNT];
+	uint32_t entries[POWER_STATE_COUNT];
+	uint32_t wakes[POWER_STATE_COUNT][POWER_WAKE_COUNT];
+	uint32_t stop_deferred;		// Idle periods kept in sleep as a timer was too close
+} Power_Stats_t;
+
+void Power_Init(void);
+void Power_Idle(void);
+void Power_Enter(Power_State_t state);
+void Power_Exit(void);
+const Power_Stats_t* Power_Get_Stats(void);
+void Power_Dump(void);
+
+#endif /* __POWER_H__ */
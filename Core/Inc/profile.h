@@ -0,0 +1,81 @@
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include <stdint.h>
+
+/*
+ * Zone id and the name printed by the dump. Zones nest, the time of an inner zone also counts in the outer one.
+ */
+#define PROFILE_ZONES(X) \
+	X(TASK_FRAME,       "task frame") \
+	X(TASK_INPUT,       "task input") \
+	X(TASK_BATTERY,     "task battery") \
+	X(TASK_LINK,        "task link") \
+	X(TASK_TRACE,       "task trace") \
+	X(TASK_HR_TIMER,    "task hr timer") \
+	X(TASK_HCI_EVENT,   "task HCI event") \
+	X(TASK_DISCOVERY,   "task discovery") \
+	X(TASK_CONN_POLICY, "task conn policy") \
+	X(TASK_HID_OUTPUT,  "task HID output") \
+	X(HID_EVENT,        "HID event handler") \
+	X(FRAME_UPDATE,     "frame update") \
+	X(FRAME_RENDER,     "frame render") \
+	X(STAGE_ENTER,      "stage enter") \
+	X(STAGE_UPDATE,     "stage update") \
+	X(LCD_PIXEL,        "ST7735 pixel") \
+	X(LCD_STRING,       "ST7735 string") \
+	X(LCD_FILL,         "ST7735 fill") \
+	X(LCD_IMAGE,        "ST7735 image")
+
+#define PROFILE_ENUM(id, name) PROFILE_##id,
+typedef enum {
+	PROFILE_ZONES(PROFILE_ENUM)
+	PROFILE_ZONE_COUNT,
+} Profile_Zone_Id_t;
+#undef PROFILE_ENUM
+
+typedef struct {
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t total;
+} Profile_Zone_t;
+
+/*
+ * The host build, for the simulation, counts ns from clock_gettime instead of the core cycles.
+ */
+#ifdef PROFILE_HOST
+#include <time.h>
+#ifndef CFG_PROFILE_ENABLED
+#define CFG_PROFILE_ENABLED 1
+#endif
+#define PROFILE_UNIT "ns"
+
+static inline uint32_t Profile_Now(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t) ((uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec);
+}
+#else
+#include "app_conf.h"
+#include "dwt.h"
+#define PROFILE_UNIT "cycles"
+#define Profile_Now() Dwt_Get_Cycles()
+#endif
+
+void Profile_Add(Profile_Zone_Id_t zone, uint32_t elapsed);
+const Profile_Zone_t* Profile_Get_Zone(Profile_Zone_Id_t zone);
+void Profile_Reset(void);
+void Profile_Dump(void);
+
+/* From the main loop only, the zones are not updated atomically */
+#if (CFG_PROFILE_ENABLED != 0)
+#define PROFILE_BEGIN(zone) uint32_t profile_start_##zone = Profile_Now()
+#define PROFILE_END(zone) Profile_Add(PROFILE_##zone, Profile_Now() - profile_start_##zone)
+#else
+#define PROFILE_BEGIN(zone)
+#define PROFILE_END(zone)
+#endif
+
+#endif /* __PROFILE_H__ */
@@ -8,15 +8,28 @@
 #ifndef __SCREEN_H__
 #define __SCREEN_H__
 #include <stdint.h>
+#include <stdbool.h>
+#include "ui.h"
+#include "transition.h"
 
 #define SCREEN_BACKGROUND_COLOR ST7735_MAGENTA
 #define SCREEN_HEADER_COLOR ST7735_WHITE
 #define SCREEN_TEXT_COLOR ST7735_WHITE
+#define SCREEN_DISABLED_COLOR ST7735_COLOR565(0xA0, 0xA0, 0xA0)
 #define SCREEN_HEADER_HEIGHT 15
 
 void Screen_Init(void);
-void Screen_Header_Draw(const char *title, uint8_t battery);
-void Screen_Background_Draw(void);
-void Screen_Status_Draw(const char* title, const char* text);
+void Screen_Update(void);
+void Screen_Set_Title(const char *title);
+void Screen_Set_Battery(uint8_t battery);
+void Screen_Show_Status(const char *title, const char *text);
+void Screen_Show_Menu(const UI_Menu_Item_t *items, uint8_t count);
+void Screen_Menu_Select(uint8_t selected);
+bool Screen_Menu_Move(int8_t step);
+const UI_Menu_Item_t* Screen_Menu_Get_Selected(void);
+void Screen_Show_Canvas(void);
+void Screen_Transition_Start(Transition_Type_t type);
+bool Screen_Transition_Is_Running(void);
+void Screen_Set_Hud(bool visible);
 
 #endif /* __SCREEN_H__ */
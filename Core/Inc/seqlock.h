@@ -0,0 +1,50 @@
+#ifndef __SEQLOCK_H__
+#define __SEQLOCK_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * The host build, for the stress test, uses a full hardware fence (the atomic builtin) instead of the DMB.
+ */
+#ifdef SEQLOCK_HOST
+#define SEQLOCK_BARRIER() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#else
+#include "main.h"
+#define SEQLOCK_BARRIER() __DMB()
+#endif
+
+/*
+ * Sequence lock for data written from a single context, odd while the data is being written.
+ * The reader never blocks the writer, it retries its copy if a write ran meanwhile.
+ */
+typedef volatile uint32_t Seqlock_t;
+
+static inline void Seqlock_Write_Begin(Seqlock_t *seq) {
+	(*seq)++;
+	SEQLOCK_BARRIER();
+}
+
+static inline void Seqlock_Write_End(Seqlock_t *seq) {
+	SEQLOCK_BARRIER();
+	(*seq)++;
+}
+
+/*
+ * Copy a consistent snapshot of data, return the number of writes so far.
+ */
+static inline uint32_t Seqlock_Read(const Seqlock_t *seq, void *dest, const volatile void *data, size_t size) {
+	uint32_t start;
+
+	do {
+		start = *seq;
+		SEQLOCK_BARRIER();
+		memcpy(dest, (const void*) data, size);
+		SEQLOCK_BARRIER();
+	} while ((start & 1) || (start != *seq));
+
+	return start / 2;
+}
+
+#endif /* __SEQLOCK_H__ */
@@ -98,5 +98,6 @@ void ST7735_FillScreen(uint16_t color);
 void ST7735_DrawImage(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *data);
 void ST7735_InvertColors(bool invert);
 void ST7735_SetGamma(GammaDef gamma);
+uint32_t ST7735_GetTransferredBytes(void);
 
 #endif // __ST7735_H__
@@ -1,16 +1,41 @@
 #ifndef __STAGE_H__
 #define __STAGE_H__
 
+#include <stdint.h>
+#include <stdbool.h>
 #include "hid_host_app.h"
+#include "transition.h"
 
-void Stage_MainMenu_Enter_Handle(HID_Report_t* report, uint8_t battery);
-void Stage_MainMenu_Handle(HID_Report_t* report, uint8_t battery);
-void Stage_MainMenu_Exit_Handle(HID_Report_t* report, uint8_t battery);
-void Stage_Snake_Enter_Handle(HID_Report_t* report, uint8_t battery);
-void Stage_Snake_Handle(HID_Report_t* report, uint8_t battery);
-void Stage_Snake_Exit_Handle(HID_Report_t* report, uint8_t battery);
-void Stage_Test_Enter_Handle(HID_Report_t* report, uint8_t battery);
-void Stage_Test_Handle(HID_Report_t* report, uint8_t battery);
-void Stage_Test_Exit_Handle(HID_Report_t* report, uint8_t battery);
+// Scratch memory shared by all stages, only the running stage owns it
+#define STAGE_ARENA_SIZE 2048
+
+typedef enum {
+	STAGE_RENDER_UI = 0,	// Stage uses the screen widgets
+	STAGE_RENDER_CANVAS,	// Stage draws directly on the body area
+} Stage_Render_t;
+
+/*
+ * Description of a stage, dispatched by App_Loop.
+ * enter is called once the enter transition is over, with the scratch memory cleared.
+ * update is called at frame_rate (every loop when 0) until the stage calls App_Set_Stage.
+ * exit is called when leaving for another stage, suspend when the controller is lost instead.
+ * low_latency asks the controller for the shortest connection interval while the stage runs.
+ */
+typedef struct {
+	const char *name;
+	Stage_Render_t render;
+	Transition_Type_t transition;
+	uint8_t frame_rate;
+	bool low_latency;
+	uint16_t scratch_size;
+	void (*enter)(void *scratch);
+	void (*update)(HID_Report_t *report, uint8_t battery);
+	void (*exit)(void);
+	void (*suspend)(void);
+} Stage_Desc_t;
+
+extern const Stage_Desc_t Stage_MainMenu;
+extern const Stage_Desc_t Stage_Snake;
+extern const Stage_Desc_t Stage_Test;
 
 #endif /* __STAGE_H__ */
@@ -0,0 +1,52 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+#include "app_conf.h"
+
+// Records held until the UART sends them, must be a power of two
+#define TRACE_RING_SIZE 64
+#define TRACE_ARGS 4
+// Starts each record, ASCII text never holds it so records can share the UART with the text traces
+#define TRACE_SYNC 0xA5
+
+/*
+ * Event id and the printf format the host decoder prints its arguments with, arguments are 32 bit integers.
+ * Tools/trace_decode.py reads this table from this file, keep one entry per line.
+ */
+#define TRACE_EVENTS(X) \
+	X(TRACE_DROPPED,         "%u records dropped, ring or output full") \
+	X(TRACE_HID_REPORT,      "player %u report %08x %08x, changes 0x%x") \
+	X(TRACE_HID_DUPLICATE,   "player %u duplicate report") \
+	X(TRACE_HID_BATTERY,     "player %u battery %u%%") \
+	X(TRACE_HID_OUTPUT,      "player %u output report, result 0x%x") \
+	X(TRACE_INPUT_EVENT,     "player %u key %u type %u") \
+	X(TRACE_PROFILE_ZONE,    "zone %u: n %u, avg %u, max %u")
+
+#define TRACE_ENUM(id, format) id,
+typedef enum {
+	TRACE_EVENTS(TRACE_ENUM)
+	TRACE_ID_COUNT,
+} Trace_Id_t;
+#undef TRACE_ENUM
+
+/* Little endian on the wire, as laid out in RAM */
+typedef struct {
+	uint8_t sync;
+	uint8_t id;
+	uint16_t seq;			// Gaps tell records lost on the host side
+	uint32_t stamp;			// Latency_Now, us
+	uint32_t args[TRACE_ARGS];
+} Trace_Record_t;
+
+void Trace_Init(void);
+void Trace_Write(Trace_Id_t id, uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3);
+
+#if (CFG_TRACE_ENABLED != 0)
+#define TRACE(id, arg0, arg1, arg2, arg3) Trace_Write((id), (arg0), (arg1), (arg2), (arg3))
+#else
+// Arguments still type checked, the call is removed by the compiler
+#define TRACE(id, arg0, arg1, arg2, arg3) do { if (0) Trace_Write((id), (arg0), (arg1), (arg2), (arg3)); } while (0)
+#endif
+
+#endif /* __TRACE_H__ */
@@ -0,0 +1,26 @@
+#ifndef __TRANSITION_H__
+#define __TRANSITION_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ui.h"
+
+// Time a transition may spend on SPI transfers each frame
+#define TRANSITION_FRAME_BUDGET_US 4000
+// Sustained ST7735 fill throughput (SPI at 16 MHz plus HAL overhead per line)
+#define TRANSITION_SPI_BYTES_PER_US 1
+#define TRANSITION_DURATION_MS 250
+
+typedef enum {
+	TRANSITION_NONE = 0,
+	TRANSITION_WIPE_DOWN,
+	TRANSITION_WIPE_RIGHT,
+	TRANSITION_BLINDS,
+} Transition_Type_t;
+
+void Transition_Start(Transition_Type_t type, UI_Rect_t area, uint16_t color, uint16_t duration_ms);
+bool Transition_Step(void);
+void Transition_Stop(void);
+bool Transition_Is_Running(void);
+
+#endif /* __TRANSITION_H__ */
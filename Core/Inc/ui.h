@@ -0,0 +1,106 @@
+#ifndef __UI_H__
+#define __UI_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "fonts.h"
+
+#define UI_LABEL_TEXT_SIZE 24
+
+#define UI_FLAG_VISIBLE     0x01
+#define UI_FLAG_DIRTY       0x02
+#define UI_FLAG_CHILD_DIRTY 0x04
+#define UI_FLAG_PARTIAL     0x08
+
+typedef struct {
+	uint8_t x;
+	uint8_t y;
+	uint8_t w;
+	uint8_t h;
+} UI_Rect_t;
+
+typedef struct UI_Widget UI_Widget_t;
+
+/*
+ * Base of every widget, always the first member of the concrete widget struct.
+ * Widgets form a tree : a parent repainting its background forces its children to repaint.
+ * When only UI_FLAG_PARTIAL is requested, paint is called with full set to false and the widget
+ * repaints only the parts it tracked as changed.
+ */
+struct UI_Widget {
+	UI_Rect_t bounds;
+	uint8_t flags;
+	void (*paint)(UI_Widget_t *widget, bool full);
+	UI_Widget_t *parent;
+	UI_Widget_t *child;
+	UI_Widget_t *next;
+};
+
+typedef struct {
+	UI_Widget_t widget;
+	uint16_t color;
+} UI_Panel_t;
+
+typedef struct {
+	UI_Widget_t widget;
+	const FontDef *font;
+	uint16_t color;
+	uint16_t bgcolor;
+	char text[UI_LABEL_TEXT_SIZE];
+} UI_Label_t;
+
+typedef struct {
+	UI_Widget_t widget;
+	const FontDef *font;
+	uint16_t color;
+	uint16_t bgcolor;
+	uint8_t level;
+} UI_Battery_t;
+
+typedef struct {
+	const char *label;
+	uint8_t action;
+	bool enabled;
+} UI_Menu_Item_t;
+
+typedef struct {
+	UI_Widget_t widget;
+	const FontDef *font;
+	uint16_t color;
+	uint16_t bgcolor;
+	uint16_t disabled_color;
+	uint8_t row_height;
+	uint8_t rows;
+	const UI_Menu_Item_t *items;
+	uint8_t count;
+	uint8_t selected;
+	uint8_t first;
+	uint32_t dirty_rows;
+} UI_Menu_t;
+
+void UI_Widget_Init(UI_Widget_t *widget, UI_Rect_t bounds, void (*paint)(UI_Widget_t *widget, bool full));
+void UI_Widget_Add(UI_Widget_t *parent, UI_Widget_t *child);
+void UI_Widget_Invalidate(UI_Widget_t *widget);
+void UI_Widget_Invalidate_Partial(UI_Widget_t *widget);
+void UI_Widget_Validate(UI_Widget_t *widget);
+void UI_Widget_Set_Visible(UI_Widget_t *widget, bool visible);
+bool UI_Widget_Is_Visible(UI_Widget_t *widget);
+
+void UI_Panel_Init(UI_Panel_t *panel, UI_Rect_t bounds, uint16_t color);
+
+void UI_Label_Init(UI_Label_t *label, UI_Rect_t bounds, const FontDef *font, uint16_t color, uint16_t bgcolor);
+void UI_Label_Set_Text(UI_Label_t *label, const char *text);
+
+void UI_Battery_Init(UI_Battery_t *battery, UI_Rect_t bounds, const FontDef *font, uint16_t color, uint16_t bgcolor);
+void UI_Battery_Set_Level(UI_Battery_t *battery, uint8_t level);
+
+void UI_Menu_Init(UI_Menu_t *menu, UI_Rect_t bounds, const FontDef *font, uint16_t color, uint16_t bgcolor,
+		uint16_t disabled_color, uint8_t row_height);
+void UI_Menu_Set_Items(UI_Menu_t *menu, const UI_Menu_Item_t *items, uint8_t count);
+void UI_Menu_Set_Selected(UI_Menu_t *menu, uint8_t selected);
+bool UI_Menu_Move(UI_Menu_t *menu, int8_t step);
+const UI_Menu_Item_t* UI_Menu_Get_Selected(UI_Menu_t *menu);
+
+void UI_Paint(UI_Widget_t *root);
+
+#endif /* __UI_H__ */
@@ -5,103 +5,343 @@
 #include "hid_host_app.h"
 #include "st7735.h"
 #include "buzzer.h"
+#include "hud.h"
+#include "dwt.h"
+#include "dbg_trace.h"
+#include "frame.h"
+#include "stm32_seq.h"
+#include "input.h"
+#include "latency.h"
+#include "conn_policy.h"
+#include "dbg_out.h"
+#include "power.h"
+#include "clock.h"
+#include "hr_timer.h"
+#include "profile.h"
 
-static App_Stage_t stage;
+typedef struct {
+	uint32_t us;
+	uint32_t updates;
+} stage_stats_t;
 
-static void Stage_Start_Enter_Handle(HID_Report_t* report, uint8_t battery);
-static void Stage_Start_Handle(HID_Report_t* report, uint8_t battery);
-static void Stage_Start_Exit_Handle(HID_Report_t* report, uint8_t battery);
+typedef struct {
+	uint32_t input;
+	uint32_t battery;
+	uint32_t link;
+} task_runs_t;
 
+static void Stage_Start_Enter(void *scratch);
+static void Stage_Start_Update(HID_Report_t* report, uint8_t battery);
+static void Stage_Reset_Enter(void *scratch);
+static void App_Update(void);
+static void App_Render(void);
+static void App_Input_Task(void);
+static void App_Battery_Task(void);
+static void App_Link_Task(void);
 
+static const Stage_Desc_t Stage_Start = {
+	.name = "INIT",
+	.render = STAGE_RENDER_UI,
+	.transition = TRANSITION_NONE,
+	.frame_rate = 30,
+	.enter = Stage_Start_Enter,
+	.update = Stage_Start_Update,
+};
+
+static const Stage_Desc_t Stage_Reset = {
+	.name = "RESET",
+	.render = STAGE_RENDER_UI,
+	.transition = TRANSITION_NONE,
+	.enter = Stage_Reset_Enter,
+};
+
+static const Stage_Desc_t* const stages[STAGE_COUNT] = {
+	[STAGE_START] = &Stage_Start,
+	[STAGE_MAINMENU] = &Stage_MainMenu,
+	[STAGE_SNAKE] = &Stage_Snake,
+	[STAGE_TEST] = &Stage_Test,
+	[STAGE_RESET] = &Stage_Reset,
+};
+
+static App_Stage_t stage = STAGE_START;
+// Report fields of the primary player changed since the previous frame
+static uint32_t frame_changes;
+// Requested stage, applied at the start of the next update so a stage never runs after leaving
+static App_Stage_t stage_next = STAGE_COUNT;
+static bool stage_entering = true;
+static uint8_t stage_steps;
+static stage_stats_t stage_stats[STAGE_COUNT];
+static uint32_t stage_arena[STAGE_ARENA_SIZE / sizeof(uint32_t)];
+static task_runs_t task_runs;
+static bool dump_chord;
+// Wakes the frames when the next auto-repeat is due
+static uint8_t repeat_timer;
+
+static void App_Stage_Switch(void) {
+	const Stage_Desc_t* desc = stages[stage];
+
+	if (desc->exit != NULL) {
+		desc->exit();
+	}
+	APP_DBG_MSG("Stage %s : %lu updates, %lu us\n", desc->name, stage_stats[stage].updates,
+			stage_stats[stage].us)
+	APP_DBG_MSG("Task runs : frame %lu, input %lu, battery %lu, link %lu\n", Frame_Get_Stats()->runs,
+			task_runs.input, task_runs.battery, task_runs.link)
+
+	stage = stage_next;
+	stage_next = STAGE_COUNT;
+	stage_entering = true;
+	if (stages[stage]->transition != TRANSITION_NONE) {
+		Screen_Transition_Start(stages[stage]->transition);
+	}
+}
+
+static void App_Stage_Suspend(void) {
+	const Stage_Desc_t* desc = stages[stage];
+
+	if (stage != STAGE_START && !stage_entering && desc->suspend != NULL) {
+		desc->suspend();
+	}
+	stage = STAGE_START;
+	stage_next = STAGE_COUNT;
+	stage_entering = true;
+	Input_Flush();
+}
+
+static void App_Stage_Run(HID_Report_t* report, uint8_t battery) {
+	const Stage_Desc_t* desc;
+	uint32_t start;
+
+	if (stage_next != STAGE_COUNT) {
+		App_Stage_Switch();
+	}
+	if (Screen_Transition_Is_Running()) {
+		// Enter handlers run once the previous screen has been wiped
+		Frame_Request();
+		return;
+	}
+
+	desc = stages[stage];
+	start = Dwt_Get_Cycles();
+
+	if (stage_entering) {
+		stage_entering = false;
+		Latency_Set_Stage(stage);
+		Conn_Policy_Set_Profile(desc->low_latency ? CONN_PROFILE_LOW_LATENCY : CONN_PROFILE_RELAXED);
+		Screen_Set_Title(desc->name);
+		if (desc->render == STAGE_RENDER_CANVAS) {
+			Screen_Show_Canvas();
+		}
+		// Events queued for the previous stage or during the transition are not for this one
+		Input_Flush();
+		Input_Set_Repeat(0, INPUT_REPEAT_DELAY_MS, INPUT_REPEAT_PERIOD_MS);
+		memset(stage_arena, 0, desc->scratch_size);
+		PROFILE_BEGIN(STAGE_ENTER);
+		desc->enter((desc->scratch_size > 0) ? stage_arena : NULL);
+		PROFILE_END(STAGE_ENTER);
+		stage_steps = 0;
+	} else if (desc->update != NULL) {
+		uint32_t repeat_ms = Input_Poll(HAL_GetTick());
+
+		// Auto-repeat is generated here, polled again when the next one is due while a key is held
+		if (repeat_ms) {
+			Hr_Timer_Start(repeat_timer, repeat_ms * 1000UL);
+		} else {
+			Hr_Timer_Stop(repeat_timer);
+		}
+		if (++stage_steps >= FRAME_RATE / MAX(desc->frame_rate, 1)) {
+			PROFILE_BEGIN(STAGE_UPDATE);
+
+			stage_steps = 0;
+			desc->update(report, battery);
+			stage_stats[stage].updates++;
+			PROFILE_END(STAGE_UPDATE);
+		} else {
+			// The input that woke the frames has not been seen by the stage yet
+			Frame_Request();
+		}
+	}
+
+	if (stage_next != STAGE_COUNT) {
+		Frame_Request();
+	}
+
+	// Summed in us, the clock level may change between frames
+	stage_stats[stage].us += DWT_CYCLES_TO_US(Dwt_Get_Cycles() - start);
+}
+
+/*
+ * View + Y dumps the latency histograms, the connection, power and clock stats and the profiling zones on the debug UART.
+ */
+static void App_Dump_Update(void) {
+	uint32_t keys = INPUT_MASK(INPUT_KEY_VIEW) | INPUT_MASK(INPUT_KEY_Y);
+	bool chord = (Input_Get_Held() & keys) == keys;
+	const Dbg_Out_Stats_t *out = Dbg_Out_Get_Stats();
+
+	if (chord && !dump_chord) {
+		APP_DBG_MSG("Debug UART : %lu bytes in %lu transfers, %lu dropped\n", out->bytes, out->transfers, out->dropped)
+		for (uint8_t i = 0; i < STAGE_COUNT; i++) {
+			Latency_Dump(i, stages[i]->name);
+		}
+		Conn_Policy_Dump();
+		Power_Dump();
+		Clock_Dump();
+		Profile_Dump();
+	}
+	dump_chord = chord;
+}
 
 void App_Init(void) {
+	for (uint8_t i = 0; i < STAGE_COUNT; i++) {
+		if (stages[i]->scratch_size > STAGE_ARENA_SIZE) {
+			Error_Handler();
+		}
+	}
+
+	Dwt_Init();
+	Power_Init();
+	Clock_Init();
+	Hr_Timer_Init();
+	Hr_Timer_Create(&repeat_timer, HR_TIMER_SINGLE_SHOT, Frame_Wake);
+	Buzzer_Init();
 	Screen_Init();
+	Frame_Init(App_Update, App_Render);
+	UTIL_SEQ_RegTask(1 << CFG_TASK_APP_INPUT_ID, UTIL_SEQ_RFU, App_Input_Task);
+	UTIL_SEQ_RegTask(1 << CFG_TASK_APP_BATTERY_ID, UTIL_SEQ_RFU, App_Battery_Task);
+	UTIL_SEQ_RegTask(1 << CFG_TASK_APP_LINK_ID, UTIL_SEQ_RFU, App_Link_Task);
 	Buzzer_Play_Boot();
 }
 
-void App_Loop(void) {
-	HID_Report_t* report = HID_Host_Get_Report();
-	HID_HOST_Status_t status =  HID_Host_Get_State();
-	uint8_t battery = HID_Host_Get_Battery_Level();
+void App_Start(void) {
+	Frame_Start();
+}
+
+/*
+ * The player driving the menus and the screen header, the first ready controller,
+ * else the one furthest in its connection.
+ */
+uint8_t App_Get_Player(void) {
+	uint8_t player = 0;
+
+	for (uint8_t i = 0; i < HID_HOST_MAX_PLAYERS; i++) {
+		if (HID_Host_Get_State(i) == HID_HOST_DONE) {
+			return i;
+		}
+		if (HID_Host_Get_State(i) > HID_Host_Get_State(player)) {
+			player = i;
+		}
+	}
+	return player;
+}
+
+/*
+ * HID_CHANGE_MASK bits of the report given to the stage update, a stage can skip its input handling when 0.
+ */
+uint32_t App_Get_Changes(void) {
+	return frame_changes;
+}
+
+static void App_Update(void) {
+	HID_Report_t snapshot;
+	HID_Report_t* report = &snapshot;
+	uint8_t player = App_Get_Player();
+	HID_HOST_Status_t status =  HID_Host_Get_State(player);
+	uint8_t battery = HID_Host_Get_Battery_Level(player);
+
+	HID_Host_Read_Report(player, &snapshot);
+	frame_changes = HID_Host_Take_Changes(player);
 
 	switch(status) {
 		case HID_HOST_IDLE:
-			Screen_Status_Draw("Scanning...", "Searching a controller");
-			stage = STAGE_START;
+			App_Stage_Suspend();
+			Screen_Set_Title("INIT");
+			Screen_Show_Status("Scanning...", "Searching a controller");
 			break;
 		case HID_HOST_CONNECTED:
-			Screen_Status_Draw("Pairing...", "Trying to bound");
-			stage = STAGE_START_ENTER;
+			App_Stage_Suspend();
+			Screen_Set_Title("INIT");
+			Screen_Show_Status("Pairing...", "Trying to bound");
 			break;
 		case HID_HOST_DONE:
-			switch(stage) {
-			case STAGE_START_ENTER:
-				Stage_Start_Enter_Handle(report, battery);
-				break;
-			case STAGE_START:
-				Stage_Start_Handle(report, battery);
-				break;
-			case STAGE_START_EXIT:
-				Stage_Start_Exit_Handle(report, battery);
-				break;
-			case STAGE_MAINMENU_ENTER:
-				Stage_MainMenu_Enter_Handle(report, battery);
-				break;
-			case STAGE_MAINMENU:
-				Stage_MainMenu_Handle(report, battery);
-				break;
-			case STAGE_MAINMENU_EXIT:
-				Stage_MainMenu_Exit_Handle(report, battery);
-				break;
-			case STAGE_SNAKE_ENTER:
-				Stage_Snake_Enter_Handle(report, battery);
-				break;
-			case STAGE_SNAKE:
-				Stage_Snake_Handle(report, battery);
-				break;
-			case STAGE_SNAKE_EXIT:
-				Stage_Snake_Exit_Handle(report, battery);
-				break;
-			case STAGE_TEST_ENTER:
-				Stage_Test_Enter_Handle(report, battery);
-				break;
-			case STAGE_TEST:
-				Stage_Test_Handle(report, battery);
-				break;
-			case STAGE_TEST_EXIT:
-				Stage_Test_Exit_Handle(report, battery);
-				break;
-			case STAGE_RESET:
-				NVIC_SystemReset();
-				break;
-			default:
-				break;
-			}
+			App_Stage_Run(report, battery);
 			break;
 		default:
-//			Screen_Status_Draw("ERROR", "Reset the device");
+//			Screen_Show_Status("ERROR", "Reset the device");
 //			stage = STAGE_START;
 			break;
 	}
+
+	Hud_Update(report);
+	App_Dump_Update();
+}
+
+static void App_Render(void) {
+	bool animating = Screen_Transition_Is_Running();
+
+	Screen_Update();
+	if (animating) {
+		Frame_Request();
+	}
+	Latency_Frame_End();
+}
+
+/*
+ * Woken by the HID host on each report notification.
+ */
+static void App_Input_Task(void) {
+	PROFILE_BEGIN(TASK_INPUT);
+
+	task_runs.input++;
+	Frame_Wake();
+	PROFILE_END(TASK_INPUT);
+}
+
+/*
+ * Only the header changes, no stage update is needed.
+ */
+static void App_Battery_Task(void) {
+	PROFILE_BEGIN(TASK_BATTERY);
+
+	task_runs.battery++;
+	Screen_Set_Battery(HID_Host_Get_Battery_Level(App_Get_Player()));
+	Screen_Update();
+	PROFILE_END(TASK_BATTERY);
+}
+
+/*
+ * Woken by the HID host when the controller connects, is ready or is lost.
+ */
+static void App_Link_Task(void) {
+	PROFILE_BEGIN(TASK_LINK);
+
+	task_runs.link++;
+	Frame_Wake();
+	PROFILE_END(TASK_LINK);
 }
 
 void App_Set_Stage(App_Stage_t stage_new) {
-	stage = stage_new;
+	if (stage_new < STAGE_COUNT) {
+		stage_next = stage_new;
+	}
 }
 
-static void Stage_Start_Enter_Handle(HID_Report_t* report, uint8_t battery) {
+static void Stage_Start_Enter(void *scratch) {
 	Buzzer_Play_Connected();
-	Screen_Header_Draw("INIT", battery);
-	Screen_Status_Draw("Connected !", "Press B to start");
-	stage = STAGE_START;
+	Screen_Show_Status("Connected !", "Press B to start");
 }
 
-static void Stage_Start_Handle(HID_Report_t* report, uint8_t battery) {
-	if(report->BTN_B) {
-		stage = STAGE_START_EXIT;
+static void Stage_Start_Update(HID_Report_t* report, uint8_t battery) {
+	Input_Event_t event;
+
+	while (Input_Get_Event(&event)) {
+		if (event.key == INPUT_KEY_B && event.type == INPUT_PRESS) {
+			// The sticks rest while B is pressed, a good time to take their centers
+			Input_Calibrate(event.player);
+			App_Set_Stage(STAGE_MAINMENU);
+		}
 	}
 }
 
-static void Stage_Start_Exit_Handle(HID_Report_t* report, uint8_t battery) {
-	stage = STAGE_MAINMENU_ENTER;
+static void Stage_Reset_Enter(void *scratch) {
+	NVIC_SystemReset();
 }
@@ -1,7 +1,11 @@
 #include "buzzer.h"
+#include "app_common.h"
+#include "stm32_lpm.h"
+#include "hr_timer.h"
 
 #define TONE_BUF_SIZE 255
-#define TIMR_FREQ 32000000
+// TIM1 runs at the core clock, see Clock_Set
+#define TIMR_FREQ SystemCoreClock
 #define TIMR_ARR 1000
 #define TIMR_PRS(freq) ((TIMR_FREQ/(TIMR_ARR*freq))-1)
 
@@ -13,6 +17,7 @@ typedef struct tone {
 
 static tone_t tone_buf;
 static uint32_t tone_id;
+static uint8_t tone_timer;
 
 static const uint16_t boot_freqs[] = { 523, 659, 784, 1047 };
 static const uint16_t boot_durations[] = { 150, 150, 150, 300 };
@@ -33,32 +38,35 @@ const uint16_t snake_food_freqs[] = { 988};
 const uint16_t snake_food_durations[] = { 100};
 
 static void Buzzer_Play_Tone(uint16_t frequency, uint16_t duration) {
-	__HAL_TIM_SET_COUNTER(&BUZZER_TIM2_HANDLE, duration);
-
 	if (frequency != 0) {
 		__HAL_TIM_SET_PRESCALER(&BUZZER_TIM_HANDLE, TIMR_PRS(frequency));
 		HAL_TIM_PWM_Start(&BUZZER_TIM_HANDLE, TIM_CHANNEL_1);
 	}
-
-	__HAL_TIM_ENABLE_IT(&BUZZER_TIM2_HANDLE, TIM_IT_UPDATE);
-	__HAL_TIM_ENABLE(&BUZZER_TIM2_HANDLE);
+	Hr_Timer_Start(tone_timer, duration * 1000UL);
 }
 
-void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim) {
-	if (htim->Instance == TIM2) {
-		HAL_TIM_PWM_Stop(&BUZZER_TIM_HANDLE, TIM_CHANNEL_1);
-		tone_id++;
-		if (tone_id < tone_buf.size) {
-			Buzzer_Play_Tone(tone_buf.frequency[tone_id], tone_buf.duration[tone_id]);
-		}
+static void Buzzer_Tone_End(void) {
+	HAL_TIM_PWM_Stop(&BUZZER_TIM_HANDLE, TIM_CHANNEL_1);
+	tone_id++;
+	if (tone_id < tone_buf.size) {
+		Buzzer_Play_Tone(tone_buf.frequency[tone_id], tone_buf.duration[tone_id]);
+	} else {
+		UTIL_LPM_SetStopMode(1 << CFG_LPM_APP_BUZZER, UTIL_LPM_ENABLE);
 	}
 }
 
+void Buzzer_Init(void) {
+	Hr_Timer_Create(&tone_timer, HR_TIMER_SINGLE_SHOT, Buzzer_Tone_End);
+}
+
 void Buzzer_Play(const uint16_t *tone, const uint16_t *duration, uint32_t size) {
 	tone_buf.frequency = tone;
 	tone_buf.duration = duration;
 	tone_buf.size = size;
 	tone_id = 0;
+	HAL_TIM_PWM_Stop(&BUZZER_TIM_HANDLE, TIM_CHANNEL_1);
+	// The PWM stops in Stop2
+	UTIL_LPM_SetStopMode(1 << CFG_LPM_APP_BUZZER, UTIL_LPM_DISABLE);
 
 	// Play first tone
 	Buzzer_Play_Tone(tone_buf.frequency[tone_id], tone_buf.duration[tone_id]);
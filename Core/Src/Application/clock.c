@@ -0,0 +1,139 @@
+#include <string.h>
+#include "clock.h"
+#include "main.h"
+#include "app_common.h"
+#include "utilities_conf.h"
+#include "dbg_trace.h"
+#include "latency.h"
+
+typedef struct {
+	Clock_Level_t level;
+	uint8_t relax_frames;
+	uint32_t stamp_us;
+	// Part of a ms lost when the SysTick is reloaded, given back to the HAL tick
+	uint32_t tick_remainder_us;
+	Clock_Stats_t stats;
+} sysclk_t;
+
+static const char* const level_names[CLOCK_LEVEL_COUNT] = { "HSE 32 MHz", "PLL 64 MHz" };
+
+static sysclk_t sysclk;
+
+void Clock_Init(void) {
+	memset(&sysclk, 0, sizeof(sysclk));
+	sysclk.level = CLOCK_HSE_32MHZ;
+	sysclk.stamp_us = Latency_Now();
+}
+
+/* 64 MHz from the 32 MHz HSE : M 2, N 8, R 2, the flash needs 3 wait states */
+static void Clock_Boost(void) {
+	LL_RCC_PLL_ConfigDomain_SYS(LL_RCC_PLLSOURCE_HSE, LL_RCC_PLLM_DIV_2, 8, LL_RCC_PLLR_DIV_2);
+	LL_RCC_PLL_Enable();
+	LL_RCC_PLL_EnableDomain_SYS();
+	while (!LL_RCC_PLL_IsReady()) {
+	}
+	__HAL_FLASH_SET_LATENCY(FLASH_LATENCY_3);
+	while (__HAL_FLASH_GET_LATENCY() != FLASH_LATENCY_3) {
+	}
+	// CPU2 runs at 32 MHz at most, the prescalers keep 32 MHz on the SPI, the UART and both timers
+	LL_C2_RCC_SetAHBPrescaler(LL_RCC_SYSCLK_DIV_2);
+	LL_RCC_SetAPB1Prescaler(LL_RCC_APB1_DIV_4);
+	LL_RCC_SetAPB2Prescaler(LL_RCC_APB2_DIV_2);
+	LL_RCC_SetSysClkSource(LL_RCC_SYS_CLKSOURCE_PLL);
+	while (LL_RCC_GetSysClkSource() != LL_RCC_SYS_CLKSOURCE_STATUS_PLL) {
+	}
+}
+
+/* Back to the SystemClock_Config settings */
+static void Clock_Relax(void) {
+	LL_RCC_SetSysClkSource(LL_RCC_SYS_CLKSOURCE_HSE);
+	while (LL_RCC_GetSysClkSource() != LL_RCC_SYS_CLKSOURCE_STATUS_HSE) {
+	}
+	LL_RCC_SetAPB2Prescaler(LL_RCC_APB2_DIV_1);
+	LL_RCC_SetAPB1Prescaler(LL_RCC_APB1_DIV_1);
+	LL_C2_RCC_SetAHBPrescaler(LL_RCC_SYSCLK_DIV_1);
+	__HAL_FLASH_SET_LATENCY(FLASH_LATENCY_1);
+	LL_RCC_PLL_Disable();
+}
+
+/*
+ * Switch the system clock, from the main loop or a critical section. The voltage stays in range 1
+ * that 32 MHz already needs. TIM1 runs from twice the APB2 clock, its prescaler follows the core
+ * clock and takes effect on the next PWM period. The HAL tick is reloaded for the new clock.
+ */
+void Clock_Set(Clock_Level_t level) {
+	uint32_t now, old_hz;
+
+	if (level >= CLOCK_LEVEL_COUNT || level == sysclk.level) {
+		return;
+	}
+	UTILS_ENTER_CRITICAL_SECTION();
+	now = Latency_Now();
+	sysclk.stats.residency_us[sysclk.level] += now - sysclk.stamp_us;
+	sysclk.stamp_us = now;
+	sysclk.stats.switches++;
+	// The part of the current ms is lost with the reload
+	sysclk.tick_remainder_us += ((SysTick->LOAD - SysTick->VAL) * 1000) / (SysTick->LOAD + 1);
+	old_hz = SystemCoreClock;
+
+	while (LL_HSEM_1StepLock(HSEM, CFG_HW_RCC_SEMID)) {
+	}
+	if (level == CLOCK_PLL_64MHZ) {
+		Clock_Boost();
+	} else {
+		Clock_Relax();
+	}
+	LL_HSEM_ReleaseLock(HSEM, CFG_HW_RCC_SEMID, 0);
+
+	SystemCoreClockUpdate();
+	TIM1->PSC = ((TIM1->PSC + 1) * (SystemCoreClock / 1000000)) / (old_hz / 1000000) - 1;
+	HAL_InitTick(uwTickPrio);
+	uwTick += sysclk.tick_remainder_us / 1000;
+	sysclk.tick_remainder_us %= 1000;
+	sysclk.level = level;
+	UTILS_EXIT_CRITICAL_SECTION();
+}
+
+Clock_Level_t Clock_Get_Level(void) {
+	return sysclk.level;
+}
+
+/*
+ * Called at the end of each frame with the time it took, from the frame task.
+ */
+void Clock_Governor_Frame(uint32_t work_us) {
+	if (sysclk.level == CLOCK_HSE_32MHZ) {
+		if (work_us > CLOCK_BOOST_US) {
+			sysclk.relax_frames = 0;
+			Clock_Set(CLOCK_PLL_64MHZ);
+		}
+		return;
+	}
+	if (work_us >= CLOCK_RELAX_US) {
+		sysclk.relax_frames = 0;
+	} else if (++sysclk.relax_frames >= CLOCK_RELAX_FRAMES) {
+		Clock_Set(CLOCK_HSE_32MHZ);
+	}
+}
+
+/*
+ * No more frames until the next event.
+ */
+void Clock_Governor_Idle(void) {
+	Clock_Set(CLOCK_HSE_32MHZ);
+}
+
+const Clock_Stats_t* Clock_Get_Stats(void) {
+	return &sysclk.stats;
+}
+
+void Clock_Dump(void) {
+	uint32_t now = Latency_Now();
+
+	for (uint8_t i = 0; i < CLOCK_LEVEL_COUNT; i++) {
+		uint64_t residency = sysclk.stats.residency_us[i] + ((i == sysclk.level) ? now - sysclk.stamp_us : 0);
+
+		APP_DBG_MSG("Clock %s : %lu ms\n", level_names[i], (uint32_t) (residency / 1000))
+	}
+	APP_DBG_MSG("Clock switches : %lu\n", sysclk.stats.switches)
+}
@@ -0,0 +1,191 @@
+#include <string.h>
+#include "dbg_out.h"
+#include "main.h"
+#include "app_common.h"
+#include "hw_if.h"
+#include "utilities_conf.h"
+#include "stm32_lpm.h"
+
+#define DBG_OUT_TIMER_TICKS DIVR(DBG_OUT_FLUSH_MS * 1000, CFG_TS_TICK_VAL)
+
+typedef struct {
+	uint8_t data[DBG_OUT_BUFFER_SIZE];
+	uint16_t length;
+	// Writes reserved in the buffer and still being copied, it is not sent before they are done
+	uint8_t writers;
+} dbg_out_buffer_t;
+
+/* Part of a write, in one buffer */
+typedef struct {
+	dbg_out_buffer_t *buffer;
+	uint16_t offset;
+	uint16_t length;
+} dbg_out_span_t;
+
+typedef struct {
+	dbg_out_buffer_t buffers[DBG_OUT_BUFFERS];
+	// Buffers from tail to fill are closed, tail is sent first, fill takes the writes
+	uint8_t fill;
+	uint8_t tail;
+	uint8_t closed;
+	bool sending;
+	bool initialized;
+	uint8_t timer_id;
+	Dbg_Out_Stats_t stats;
+} dbg_out_t;
+
+static dbg_out_t dbg_out;
+
+static void Dbg_Out_Send(void);
+
+static void Dbg_Out_Tx_Done(void) {
+	UTILS_ENTER_CRITICAL_SECTION();
+	dbg_out.buffers[dbg_out.tail].length = 0;
+	dbg_out.tail = (dbg_out.tail + 1) % DBG_OUT_BUFFERS;
+	dbg_out.closed--;
+	dbg_out.sending = false;
+	// Whatever came in meanwhile has waited long enough
+	if (dbg_out.closed == 0 && dbg_out.buffers[dbg_out.fill].length > 0) {
+		dbg_out.fill = (dbg_out.fill + 1) % DBG_OUT_BUFFERS;
+		dbg_out.closed++;
+	}
+	if (dbg_out.closed == 0) {
+		UTIL_LPM_SetStopMode(1 << CFG_LPM_APP_TRACE, UTIL_LPM_ENABLE);
+	}
+	UTILS_EXIT_CRITICAL_SECTION();
+	Dbg_Out_Send();
+}
+
+/* Start the DMA on the oldest closed buffer, if it is idle */
+static void Dbg_Out_Send(void) {
+	dbg_out_buffer_t *buffer;
+
+	UTILS_ENTER_CRITICAL_SECTION();
+	if (dbg_out.sending || dbg_out.closed == 0 || dbg_out.buffers[dbg_out.tail].writers > 0) {
+		UTILS_EXIT_CRITICAL_SECTION();
+		return;
+	}
+	dbg_out.sending = true;
+	buffer = &dbg_out.buffers[dbg_out.tail];
+	UTILS_EXIT_CRITICAL_SECTION();
+
+	dbg_out.stats.transfers++;
+	dbg_out.stats.bytes += buffer->length;
+	if (HW_UART_Transmit_DMA(CFG_DEBUG_TRACE_UART, buffer->data, buffer->length, Dbg_Out_Tx_Done) != hw_uart_ok) {
+		// The buffer is kept, sent by the next flush
+		dbg_out.sending = false;
+	}
+}
+
+/* Close the buffer being filled, unless every other one still waits for the DMA */
+static void Dbg_Out_Close(void) {
+	UTILS_ENTER_CRITICAL_SECTION();
+	if (dbg_out.buffers[dbg_out.fill].length > 0 && dbg_out.closed < DBG_OUT_BUFFERS - 1) {
+		dbg_out.fill = (dbg_out.fill + 1) % DBG_OUT_BUFFERS;
+		dbg_out.closed++;
+	}
+	UTILS_EXIT_CRITICAL_SECTION();
+}
+
+/* The copies of a write are done, its buffers can be sent */
+static void Dbg_Out_Commit(const dbg_out_span_t *spans, uint8_t count) {
+	UTILS_ENTER_CRITICAL_SECTION();
+	for (uint8_t i = 0; i < count; i++) {
+		spans[i].buffer->writers--;
+	}
+	UTILS_EXIT_CRITICAL_SECTION();
+}
+
+/* Age threshold, in interrupt context */
+static void Dbg_Out_Timer_Callback(void) {
+	Dbg_Out_Flush();
+}
+
+/*
+ * The UART itself is started by DbgOutputInit, or by the trace module without text traces.
+ * The timer server has to be initialized.
+ */
+void Dbg_Out_Init(void) {
+	if (dbg_out.initialized) {
+		return;
+	}
+	memset(&dbg_out, 0, sizeof(dbg_out));
+	dbg_out.initialized = true;
+	HW_TS_Create(CFG_TIM_PROC_ID_ISR, &dbg_out.timer_id, hw_ts_SingleShot, Dbg_Out_Timer_Callback);
+}
+
+/*
+ * Copy into the buffer being filled and return at once, callable from interrupts.
+ * The space is reserved under the critical section and the copy runs outside of it.
+ * A write that does not fit in the free space of the buffers is dropped whole and counted, return false then.
+ */
+bool Dbg_Out_Write(const uint8_t *data, uint16_t size) {
+	dbg_out_span_t spans[DBG_OUT_BUFFERS];
+	uint8_t count = 0;
+	uint32_t space;
+	bool started = false, flush = false;
+
+	if (!dbg_out.initialized) {
+		return false;
+	}
+	UTILS_ENTER_CRITICAL_SECTION();
+	// The buffers neither closed nor filled are empty
+	space = DBG_OUT_BUFFER_SIZE - dbg_out.buffers[dbg_out.fill].length
+			+ (uint32_t) (DBG_OUT_BUFFERS - 1 - dbg_out.closed) * DBG_OUT_BUFFER_SIZE;
+	if (size > space) {
+		dbg_out.stats.dropped += size;
+		UTILS_EXIT_CRITICAL_SECTION();
+		return false;
+	}
+	// The UART stops in Stop2, it is allowed again once everything is sent
+	UTIL_LPM_SetStopMode(1 << CFG_LPM_APP_TRACE, UTIL_LPM_DISABLE);
+	while (size > 0) {
+		dbg_out_buffer_t *buffer = &dbg_out.buffers[dbg_out.fill];
+		uint16_t length = MIN(size, DBG_OUT_BUFFER_SIZE - buffer->length);
+
+		started |= (buffer->length == 0);
+		spans[count++] = (dbg_out_span_t ) { buffer, buffer->length, length };
+		buffer->writers++;
+		buffer->length += length;
+		size -= length;
+		if (size > 0) {
+			dbg_out.fill = (dbg_out.fill + 1) % DBG_OUT_BUFFERS;
+			dbg_out.closed++;
+			flush = true;
+		}
+	}
+	flush |= (dbg_out.buffers[dbg_out.fill].length >= DBG_OUT_FLUSH_SIZE);
+	UTILS_EXIT_CRITICAL_SECTION();
+
+	for (uint8_t i = 0; i < count; i++) {
+		memcpy(&spans[i].buffer->data[spans[i].offset], data, spans[i].length);
+		data += spans[i].length;
+	}
+	Dbg_Out_Commit(spans, count);
+
+	if (flush) {
+		Dbg_Out_Flush();
+	} else {
+		// A buffer closed meanwhile waited for this copy
+		Dbg_Out_Send();
+		if (started) {
+			HW_TS_Start(dbg_out.timer_id, DBG_OUT_TIMER_TICKS);
+		}
+	}
+	return true;
+}
+
+/*
+ * Send what is buffered without waiting for the thresholds.
+ */
+void Dbg_Out_Flush(void) {
+	if (!dbg_out.initialized) {
+		return;
+	}
+	Dbg_Out_Close();
+	Dbg_Out_Send();
+}
+
+const Dbg_Out_Stats_t* Dbg_Out_Get_Stats(void) {
+	return &dbg_out.stats;
+}
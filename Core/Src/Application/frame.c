@@ -0,0 +1,128 @@
+#include "frame.h"
+#include "main.h"
+#include "stm32_seq.h"
+#include "dwt.h"
+#include "clock.h"
+#include "profile.h"
+
+// Timer server ticks per frame, the accumulator absorbs the rounding
+#define FRAME_TIMER_TICKS DIVR(FRAME_STEP_US, CFG_TS_TICK_VAL)
+
+typedef struct {
+	void (*update)(void);
+	void (*render)(void);
+	uint8_t timer_id;
+	bool running;
+	bool requested;
+	uint32_t last_tick;
+	uint32_t accumulator_us;
+	Frame_Stats_t stats;
+} frame_t;
+
+static frame_t frame;
+
+static void Frame_Timer_Callback(void) {
+	UTIL_SEQ_SetTask(1 << CFG_TASK_APP_FRAME_ID, CFG_SCH_PRIO_0);
+}
+
+/*
+ * Fixed timestep : the game logic always advances by FRAME_STEP_US whatever the wake up jitter,
+ * the screen is then rendered once. The timer only runs while something requests frames.
+ */
+static void Frame_Task(void) {
+	uint32_t tick = HAL_GetTick();
+	uint32_t start = Dwt_Get_Cycles();
+	uint32_t us;
+	uint8_t steps = 0;
+	PROFILE_BEGIN(TASK_FRAME);
+
+	frame.stats.runs++;
+	frame.requested = false;
+	frame.accumulator_us += (tick - frame.last_tick) * 1000;
+	frame.last_tick = tick;
+
+	if (frame.accumulator_us > FRAME_MAX_CATCH_UP * FRAME_STEP_US) {
+		frame.stats.dropped_us += frame.accumulator_us - FRAME_MAX_CATCH_UP * FRAME_STEP_US;
+		frame.accumulator_us = FRAME_MAX_CATCH_UP * FRAME_STEP_US;
+	}
+
+	while (frame.accumulator_us >= FRAME_STEP_US) {
+		PROFILE_BEGIN(FRAME_UPDATE);
+
+		frame.accumulator_us -= FRAME_STEP_US;
+		frame.update();
+		steps++;
+		PROFILE_END(FRAME_UPDATE);
+	}
+
+	if (steps > 0) {
+		PROFILE_BEGIN(FRAME_RENDER);
+
+		frame.render();
+		PROFILE_END(FRAME_RENDER);
+		frame.stats.frames++;
+		frame.stats.updates += steps;
+	}
+
+	// The cycle counter stops during sleep, it only measures the work done
+	// Converted at the clock of this frame, the governor may switch it before the next one
+	us = DWT_CYCLES_TO_US(Dwt_Get_Cycles() - start);
+	frame.stats.busy_us += us;
+	if (us > frame.stats.worst_us) {
+		frame.stats.worst_us = us;
+	}
+	Clock_Governor_Frame(us);
+
+	// Nothing animates, sleep until the next input, battery or link event
+	if (!frame.requested && frame.running) {
+		HW_TS_Stop(frame.timer_id);
+		frame.running = false;
+		Clock_Governor_Idle();
+	}
+	PROFILE_END(TASK_FRAME);
+}
+
+void Frame_Init(void (*update)(void), void (*render)(void)) {
+	memset(&frame, 0, sizeof(frame));
+	frame.update = update;
+	frame.render = render;
+	Dwt_Init();
+	UTIL_SEQ_RegTask(1 << CFG_TASK_APP_FRAME_ID, UTIL_SEQ_RFU, Frame_Task);
+}
+
+/*
+ * The timer server is only available once MX_APPE_Init has run.
+ */
+void Frame_Start(void) {
+	HW_TS_Create(CFG_TIM_PROC_ID_ISR, &frame.timer_id, hw_ts_Repeated, Frame_Timer_Callback);
+	Frame_Wake();
+}
+
+/*
+ * Restart the frames after an idle period, one update runs right away.
+ */
+void Frame_Wake(void) {
+	if (frame.running) {
+		return;
+	}
+	frame.running = true;
+	frame.last_tick = HAL_GetTick();
+	frame.accumulator_us = FRAME_STEP_US;
+	HW_TS_Start(frame.timer_id, FRAME_TIMER_TICKS);
+	UTIL_SEQ_SetTask(1 << CFG_TASK_APP_FRAME_ID, CFG_SCH_PRIO_0);
+}
+
+/*
+ * Keep the frames running after the current one, to be called by anything still animating.
+ */
+void Frame_Request(void) {
+	frame.requested = true;
+}
+
+const Frame_Stats_t* Frame_Get_Stats(void) {
+	return &frame.stats;
+}
+
+void Frame_Clear_Worst(void) {
+	frame.stats.worst_us = 0;
+}
@@ -0,0 +1,111 @@
+#include <string.h>
+#include "hid_attribute.h"
+#include "ble_defs.h"
+#include "uuid.h"
+
+static uint16_t HID_Attribute_U16(const uint8_t *data) {
+	return (uint16_t) data[0] | ((uint16_t) data[1] << 8);
+}
+
+void HID_Attribute_Reset(HID_Attribute_Table_t *table) {
+	table->Count = 0;
+}
+
+/*
+ * Add the characteristic declarations of a read by type response to the table.
+ * Each pair holds the declaration handle, the properties, the value handle and the UUID,
+ * pair_length is 7 for 16 bit UUIDs and 21 for 128 bit UUIDs.
+ */
+void HID_Attribute_Characs(HID_Attribute_Table_t *table, const uint8_t *data, uint8_t length, uint8_t pair_length) {
+	if (pair_length != 7 && pair_length != 21) {
+		return;
+	}
+	for (uint8_t idx = 0; idx + pair_length <= length && table->Count < HID_MAX_ATTRIBUTES; idx += pair_length) {
+		HID_Attribute_t *attribute = &table->Attributes[table->Count++];
+
+		memset(attribute, 0, sizeof(HID_Attribute_t));
+		attribute->Properties = data[idx + 2];
+		attribute->ValueHandle = HID_Attribute_U16(&data[idx + 3]);
+		// 128 bit characteristics are kept so their descriptors are not given to the previous one
+		attribute->Uuid = (pair_length == 7) ? HID_Attribute_U16(&data[idx + 5]) : 0;
+	}
+}
+
+/*
+ * Attach the descriptors of a find information response, pairs of handle and 16 bit UUID,
+ * to the characteristic they follow.
+ */
+void HID_Attribute_Descs(HID_Attribute_Table_t *table, const uint8_t *data, uint8_t length) {
+	for (uint8_t idx = 0; idx + 4 <= length; idx += 4) {
+		uint16_t handle = HID_Attribute_U16(&data[idx]);
+		uint16_t uuid = HID_Attribute_U16(&data[idx + 2]);
+		HID_Attribute_t *owner = NULL;
+
+		if (uuid != CLIENT_CHAR_CONFIG_DESCRIPTOR_UUID && uuid != REPORT_REFERENCE_DESCRIPTOR_UUID) {
+			continue;
+		}
+		for (uint8_t i = 0; i < table->Count && table->Attributes[i].ValueHandle < handle; i++) {
+			owner = &table->Attributes[i];
+		}
+		if (!owner) {
+			continue;
+		}
+		if (uuid == CLIENT_CHAR_CONFIG_DESCRIPTOR_UUID) {
+			owner->CccdHandle = handle;
+		} else {
+			owner->ReportRefHandle = handle;
+		}
+	}
+}
+
+const HID_Attribute_t* HID_Attribute_Find(const HID_Attribute_Table_t *table, uint16_t uuid, uint8_t nth) {
+	for (uint8_t i = 0; i < table->Count; i++) {
+		if (table->Attributes[i].Uuid == uuid && nth-- == 0) {
+			return &table->Attributes[i];
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Resolve the handles used by the host from the table, return false if the peer has no HID report.
+ */
+bool HID_Attribute_Resolve(const HID_Attribute_Table_t *table, HID_Attribute_Handles_t *handles) {
+	const HID_Attribute_t *report1 = HID_Attribute_Find(table, REPORT_CHAR_UUID, 0);
+	const HID_Attribute_t *report2 = HID_Attribute_Find(table, REPORT_CHAR_UUID, 1);
+	const HID_Attribute_t *attribute;
+
+	memset(handles, 0, sizeof(HID_Attribute_Handles_t));
+	if (!report1) {
+		return false;
+	}
+	handles->Report1 = report1->ValueHandle;
+	handles->Report1Cccd = report1->CccdHandle;
+	handles->Report1Ref = report1->ReportRefHandle;
+	if (report2) {
+		handles->Report2 = report2->ValueHandle;
+		handles->Report2Ref = report2->ReportRefHandle;
+	}
+	// Input reports are notified, the output report is the one written without response
+	for (uint8_t nth = 0; (attribute = HID_Attribute_Find(table, REPORT_CHAR_UUID, nth)); nth++) {
+		if (attribute->Properties & CHAR_PROP_WRITE_WITHOUT_RESP) {
+			handles->OutputReport = attribute->ValueHandle;
+			break;
+		}
+	}
+	if ((attribute = HID_Attribute_Find(table, REPORT_MAP_CHAR_UUID, 0))) {
+		handles->ReportMap = attribute->ValueHandle;
+	}
+	if ((attribute = HID_Attribute_Find(table, HID_INFORMATION_CHAR_UUID, 0))) {
+		handles->Information = attribute->ValueHandle;
+	}
+	if ((attribute = HID_Attribute_Find(table, BATTERY_LEVEL_CHAR_UUID, 0))) {
+		handles->BatteryLevel = attribute->ValueHandle;
+		handles->BatteryLevelCccd = attribute->CccdHandle;
+	}
+	if ((attribute = HID_Attribute_Find(table, SERVICE_CHANGED_CHARACTERISTIC_UUID, 0))) {
+		handles->ServiceChanged = attribute->ValueHandle;
+		handles->ServiceChangedCccd = attribute->CccdHandle;
+	}
+	return true;
+}
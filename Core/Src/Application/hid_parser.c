@@ -0,0 +1,407 @@
+#include <string.h>
+#include <stddef.h>
+#include "hid_parser.h"
+
+// Short item tags, size bits masked out
+#define HID_ITEM_INPUT 0x80
+#define HID_ITEM_OUTPUT 0x90
+#define HID_ITEM_COLLECTION 0xA0
+#define HID_ITEM_FEATURE 0xB0
+#define HID_ITEM_END_COLLECTION 0xC0
+#define HID_ITEM_USAGE_PAGE 0x04
+#define HID_ITEM_LOGICAL_MIN 0x14
+#define HID_ITEM_LOGICAL_MAX 0x24
+#define HID_ITEM_REPORT_SIZE 0x74
+#define HID_ITEM_REPORT_ID 0x84
+#define HID_ITEM_REPORT_COUNT 0x94
+#define HID_ITEM_USAGE 0x08
+#define HID_ITEM_USAGE_MIN 0x18
+#define HID_ITEM_USAGE_MAX 0x28
+#define HID_ITEM_LONG 0xFE
+
+#define HID_INPUT_CONSTANT 0x01
+#define HID_INPUT_VARIABLE 0x02
+
+#define HID_PAGE_DESKTOP 0x01
+#define HID_PAGE_SIMULATION 0x02
+#define HID_PAGE_BUTTON 0x09
+#define HID_PAGE_CONSUMER 0x0C
+
+#define HID_USAGE(page, id) (((uint32_t) (page) << 16) | (id))
+
+// Widest field the 4 byte load can extract at any bit position
+#define HID_FIELD_MAX_BITS 24
+
+#define HID_AXIS_MAX 65535
+#define HID_TRIGGER_MAX 1023
+
+typedef struct {
+	// Global items
+	uint16_t page;
+	int32_t logical_min;
+	int32_t logical_max;
+	uint32_t logical_max_raw;
+	uint8_t report_size;
+	uint16_t report_count;
+	// Local items, cleared by every main item
+	uint32_t usages[HID_PARSER_MAX_USAGES];
+	uint8_t usage_count;
+	uint32_t usage_min;
+	uint32_t usage_max;
+	bool usage_range;
+	// Input bit offset of each report ID met so far
+	uint8_t ids[HID_PARSER_MAX_REPORTS];
+	uint16_t offsets[HID_PARSER_MAX_REPORTS];
+	uint8_t reports;
+	uint8_t report;
+	// Report ID of each compiled field
+	uint8_t field_ids[HID_PARSER_MAX_FIELDS];
+} hid_parser_t;
+
+/*
+ * Button number to field, 0 when the button is not used.
+ * Numbered as in the report of the Xbox controller.
+ */
+static const uint8_t hid_buttons[] = {
+	[1] = offsetof(HID_Report_t, BTN_A),
+	[2] = offsetof(HID_Report_t, BTN_B),
+	[3] = offsetof(HID_Report_t, BTN_RightJoystick),
+	[4] = offsetof(HID_Report_t, BTN_X),
+	[5] = offsetof(HID_Report_t, BTN_Y),
+	[6] = offsetof(HID_Report_t, BTN_BackLeft),
+	[7] = offsetof(HID_Report_t, BTN_BackRight),
+	[10] = offsetof(HID_Report_t, BTN_View),
+	[11] = offsetof(HID_Report_t, BTN_Menu),
+	[12] = offsetof(HID_Report_t, BTN_Xbox),
+	[13] = offsetof(HID_Report_t, BTN_LeftJoystick),
+};
+
+/*
+ * Report map of the 16 bytes report of the Xbox controller, used when the peer one
+ * could not be read or holds no gamepad.
+ */
+static const uint8_t hid_default_map[] = {
+	0x05, 0x01, 0x09, 0x05, 0xA1, 0x01,
+	// Sticks
+	0x09, 0x30, 0x09, 0x31, 0x09, 0x32, 0x09, 0x35, 0x15, 0x00, 0x27, 0xFF, 0xFF, 0x00, 0x00,
+	0x75, 0x10, 0x95, 0x04, 0x81, 0x02,
+	// Triggers, 10 bits padded to 16
+	0x05, 0x02, 0x09, 0xC5, 0x26, 0xFF, 0x03, 0x75, 0x0A, 0x95, 0x01, 0x81, 0x02,
+	0x75, 0x06, 0x81, 0x03,
+	0x09, 0xC4, 0x75, 0x0A, 0x81, 0x02,
+	0x75, 0x06, 0x81, 0x03,
+	// Hat switch, 4 bits padded to 8
+	0x05, 0x01, 0x09, 0x39, 0x15, 0x01, 0x25, 0x08, 0x75, 0x04, 0x81, 0x42,
+	0x81, 0x03,
+	// 15 buttons padded to 16
+	0x05, 0x09, 0x19, 0x01, 0x29, 0x0F, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x0F, 0x81, 0x02,
+	0x95, 0x01, 0x81, 0x03,
+	// Profile button padded to 8
+	0x05, 0x0C, 0x0A, 0x24, 0x02, 0x81, 0x02,
+	0x95, 0x07, 0x81, 0x03,
+	0xC0,
+};
+
+static bool HID_Parser_Target(uint32_t usage, uint8_t *kind, uint8_t *dest) {
+	uint16_t id = usage & 0xFFFF;
+
+	switch (usage) {
+	case HID_USAGE(HID_PAGE_DESKTOP, 0x30):			// X
+		*kind = HID_FIELD_AXIS;
+		*dest = offsetof(HID_Report_t, JOY_LeftAxisX);
+		return true;
+	case HID_USAGE(HID_PAGE_DESKTOP, 0x31):			// Y
+		*kind = HID_FIELD_AXIS;
+		*dest = offsetof(HID_Report_t, JOY_LeftAxisY);
+		return true;
+	case HID_USAGE(HID_PAGE_DESKTOP, 0x32):			// Z
+		*kind = HID_FIELD_AXIS;
+		*dest = offsetof(HID_Report_t, JOY_RightAxisX);
+		return true;
+	case HID_USAGE(HID_PAGE_DESKTOP, 0x35):			// Rz
+		*kind = HID_FIELD_AXIS;
+		*dest = offsetof(HID_Report_t, JOY_RightAxisY);
+		return true;
+	case HID_USAGE(HID_PAGE_DESKTOP, 0x33):			// Rx
+	case HID_USAGE(HID_PAGE_SIMULATION, 0xC5):		// Brake
+		*kind = HID_FIELD_TRIGGER;
+		*dest = offsetof(HID_Report_t, TRG_Left);
+		return true;
+	case HID_USAGE(HID_PAGE_DESKTOP, 0x34):			// Ry
+	case HID_USAGE(HID_PAGE_SIMULATION, 0xC4):		// Accelerator
+		*kind = HID_FIELD_TRIGGER;
+		*dest = offsetof(HID_Report_t, TRG_Right);
+		return true;
+	case HID_USAGE(HID_PAGE_DESKTOP, 0x39):			// Hat switch
+		*kind = HID_FIELD_HAT;
+		*dest = offsetof(HID_Report_t, HAT_Switch);
+		return true;
+	case HID_USAGE(HID_PAGE_CONSUMER, 0x224):		// AC Back
+	case HID_USAGE(HID_PAGE_CONSUMER, 0xB2):		// Record
+		*kind = HID_FIELD_BUTTON;
+		*dest = offsetof(HID_Report_t, BTN_Profile);
+		return true;
+	default:
+		break;
+	}
+
+	if ((usage >> 16) == HID_PAGE_BUTTON && id < sizeof(hid_buttons) && hid_buttons[id] != 0) {
+		*kind = HID_FIELD_BUTTON;
+		*dest = hid_buttons[id];
+		return true;
+	}
+	return false;
+}
+
+static void HID_Parser_Add(hid_parser_t *parser, HID_Plan_t *plan, uint32_t usage, uint16_t bit) {
+	HID_Field_t *field = &plan->fields[plan->count];
+	uint8_t size = parser->report_size;
+	int32_t max = parser->logical_max;
+	uint8_t kind, dest;
+
+	if (plan->count >= HID_PARSER_MAX_FIELDS || size == 0 || size > HID_FIELD_MAX_BITS
+			|| !HID_Parser_Target(usage, &kind, &dest)) {
+		return;
+	}
+	// Descriptors often encode an unsigned maximum in too few bytes, 255 as 0xFF
+	if (max < parser->logical_min) {
+		max = (int32_t) parser->logical_max_raw;
+	}
+	if (max < parser->logical_min || bit / 8 + 4 > 255) {
+		return;
+	}
+
+	field->byte = bit / 8;
+	field->shift = bit % 8;
+	field->bytes = (field->shift + size + 7) / 8;
+	field->kind = kind;
+	field->dest = dest;
+	field->mask = (1UL << size) - 1;
+	field->min = parser->logical_min;
+	field->range = (uint32_t) (max - parser->logical_min);
+	field->scale = 0;
+	if (field->range > 0) {
+		uint32_t out = (kind == HID_FIELD_TRIGGER) ? HID_TRIGGER_MAX : HID_AXIS_MAX;
+		field->scale = (uint32_t) (((uint64_t) out << 16) / field->range);
+	}
+	parser->field_ids[plan->count] = parser->ids[parser->report];
+	plan->count++;
+}
+
+static void HID_Parser_Input(hid_parser_t *parser, HID_Plan_t *plan, uint32_t flags) {
+	uint16_t *offset = &parser->offsets[parser->report];
+
+	if (!(flags & HID_INPUT_CONSTANT) && (flags & HID_INPUT_VARIABLE)) {
+		for (uint16_t i = 0; i < parser->report_count; i++) {
+			uint32_t usage;
+
+			if (parser->usage_range) {
+				usage = parser->usage_min + i;
+				if (usage > parser->usage_max) {
+					break;
+				}
+			} else if (parser->usage_count > 0) {
+				// The last usage applies to the remaining values
+				usage = parser->usages[(i < parser->usage_count) ? i : parser->usage_count - 1];
+			} else {
+				break;
+			}
+			HID_Parser_Add(parser, plan, usage, *offset + i * parser->report_size);
+		}
+	}
+	*offset += parser->report_size * parser->report_count;
+}
+
+static void HID_Parser_Select_Report(hid_parser_t *parser, uint8_t id) {
+	for (parser->report = 0; parser->report < parser->reports; parser->report++) {
+		if (parser->ids[parser->report] == id) {
+			return;
+		}
+	}
+	if (parser->reports < HID_PARSER_MAX_REPORTS) {
+		parser->reports++;
+	} else {
+		// Out of slots, the last one is shared and its offsets are wrong but harmless
+		parser->report = HID_PARSER_MAX_REPORTS - 1;
+	}
+	parser->ids[parser->report] = id;
+	parser->offsets[parser->report] = 0;
+}
+
+/*
+ * Walk the report map once and compile the fields of the gamepad report into plan.
+ * The gamepad report is the one holding the X axis, or the first one with a known usage.
+ * Push, pop, delimiters and array inputs are not supported, their fields are skipped.
+ */
+bool HID_Parser_Compile(const uint8_t *map, uint16_t length, HID_Plan_t *plan) {
+	hid_parser_t parser;
+	uint16_t i = 0;
+	uint8_t count;
+
+	memset(&parser, 0, sizeof(parser));
+	memset(plan, 0, sizeof(HID_Plan_t));
+	parser.reports = 1;
+
+	while (i < length) {
+		uint8_t prefix = map[i++];
+		uint8_t size = ((prefix & 0x03) == 3) ? 4 : (prefix & 0x03);
+		uint32_t data = 0;
+		int32_t value;
+
+		if (prefix == HID_ITEM_LONG) {
+			if (i >= length) {
+				break;
+			}
+			i += 2 + map[i];
+			continue;
+		}
+		if (i + size > length) {
+			return false;
+		}
+		for (uint8_t b = 0; b < size; b++) {
+			data |= (uint32_t) map[i + b] << (8 * b);
+		}
+		i += size;
+		value = (int32_t) data;
+		if (size > 0 && size < 4 && (data & (1UL << (8 * size - 1)))) {
+			value = (int32_t) (data | ~((1UL << (8 * size)) - 1));
+		}
+
+		switch (prefix & 0xFC) {
+		case HID_ITEM_USAGE_PAGE:
+			parser.page = data;
+			break;
+		case HID_ITEM_LOGICAL_MIN:
+			parser.logical_min = value;
+			break;
+		case HID_ITEM_LOGICAL_MAX:
+			parser.logical_max = value;
+			parser.logical_max_raw = data;
+			break;
+		case HID_ITEM_REPORT_SIZE:
+			parser.report_size = data;
+			break;
+		case HID_ITEM_REPORT_COUNT:
+			parser.report_count = data;
+			break;
+		case HID_ITEM_REPORT_ID:
+			HID_Parser_Select_Report(&parser, data);
+			break;
+		case HID_ITEM_USAGE:
+			if (parser.usage_count < HID_PARSER_MAX_USAGES) {
+				parser.usages[parser.usage_count++] = (size == 4) ? data : HID_USAGE(parser.page, data);
+			}
+			break;
+		case HID_ITEM_USAGE_MIN:
+			parser.usage_min = (size == 4) ? data : HID_USAGE(parser.page, data);
+			parser.usage_range = true;
+			break;
+		case HID_ITEM_USAGE_MAX:
+			parser.usage_max = (size == 4) ? data : HID_USAGE(parser.page, data);
+			parser.usage_range = true;
+			break;
+		case HID_ITEM_INPUT:
+			HID_Parser_Input(&parser, plan, data);
+			/* fall through */
+		case HID_ITEM_OUTPUT:
+		case HID_ITEM_FEATURE:
+		case HID_ITEM_COLLECTION:
+		case HID_ITEM_END_COLLECTION:
+			parser.usage_count = 0;
+			parser.usage_range = false;
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (plan->count == 0) {
+		return false;
+	}
+	plan->report_id = parser.field_ids[0];
+	for (i = 0; i < plan->count; i++) {
+		if (plan->fields[i].dest == offsetof(HID_Report_t, JOY_LeftAxisX)
+				&& plan->fields[i].kind == HID_FIELD_AXIS) {
+			plan->report_id = parser.field_ids[i];
+			break;
+		}
+	}
+
+	// Keep the fields of the gamepad report only
+	count = 0;
+	for (i = 0; i < plan->count; i++) {
+		if (parser.field_ids[i] == plan->report_id) {
+			HID_Field_t *field = &plan->fields[i];
+			plan->fields[count++] = *field;
+			if (field->byte + field->bytes > plan->length) {
+				plan->length = field->byte + field->bytes;
+			}
+		}
+	}
+	plan->count = count;
+	return true;
+}
+
+void HID_Parser_Default(HID_Plan_t *plan) {
+	HID_Parser_Compile(hid_default_map, sizeof(hid_default_map), plan);
+}
+
+/*
+ * Sticks centered and nothing pressed, for the fields a plan does not cover.
+ */
+void HID_Parser_Neutral(HID_Report_t *report) {
+	memset(report, 0, sizeof(HID_Report_t));
+	report->JOY_LeftAxisX = 0x8000;
+	report->JOY_LeftAxisY = 0x8000;
+	report->JOY_RightAxisX = 0x8000;
+	report->JOY_RightAxisY = 0x8000;
+}
+
+/*
+ * Decode a report with the plan, fields the plan does not hold are left untouched.
+ * Return false if the report is too short for the plan.
+ */
+bool HID_Parser_Decode(const HID_Plan_t *plan, const uint8_t *data, uint16_t length, HID_Report_t *report) {
+	if (length < plan->length) {
+		return false;
+	}
+
+	for (uint8_t i = 0; i < plan->count; i++) {
+		const HID_Field_t *field = &plan->fields[i];
+		uint8_t *dest = (uint8_t*) report + field->dest;
+		uint32_t raw = 0;
+		uint32_t offset;
+		int32_t value;
+
+		for (uint8_t b = 0; b < field->bytes; b++) {
+			raw |= (uint32_t) data[field->byte + b] << (8 * b);
+		}
+		raw = (raw >> field->shift) & field->mask;
+		value = (int32_t) raw;
+		if (field->min < 0 && (raw & ~(field->mask >> 1))) {
+			value = (int32_t) (raw | ~field->mask);
+		}
+		offset = (value < field->min) ? 0 : (uint32_t) (value - field->min);
+
+		switch (field->kind) {
+		case HID_FIELD_BUTTON:
+			*dest = (raw != 0);
+			break;
+		case HID_FIELD_HAT:
+			// Out of range is the null state, positions are spread over the 8 directions
+			if (value < field->min || offset > field->range) {
+				*dest = HATSWITCH_NONE;
+			} else {
+				*dest = offset * 8 / (field->range + 1) + 1;
+			}
+			break;
+		default:
+			if (offset > field->range) {
+				offset = field->range;
+			}
+			*(uint16_t*) dest = (offset * field->scale + 0x8000) >> 16;
+			break;
+		}
+	}
+	return true;
+}
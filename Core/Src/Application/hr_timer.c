@@ -0,0 +1,207 @@
+#include <string.h>
+#include "hr_timer.h"
+#include "main.h"
+#include "app_common.h"
+#include "stm32_seq.h"
+#include "stm32_lpm.h"
+#include "utilities_conf.h"
+#include "profile.h"
+
+#define HR_TIMER_NONE 0xFF
+
+extern TIM_HandleTypeDef HR_TIMER_TIM_HANDLE;
+#define HR_TIM (HR_TIMER_TIM_HANDLE.Instance)
+
+typedef struct {
+	Hr_Timer_Cb_t callback;
+	Hr_Timer_Mode_t mode;
+	uint32_t period_us;
+	uint32_t expiry;
+	bool created;
+	bool armed;
+	uint8_t next;
+} hr_timer_slot_t;
+
+typedef struct {
+	hr_timer_slot_t slots[HR_TIMER_MAX];
+	// Armed timers sorted by expiry, the compare channel is set on the first one
+	uint8_t head;
+	// Expired in the interrupt, their callbacks run in the task
+	volatile uint32_t expired;
+} hr_timer_t;
+
+static hr_timer_t hr_timer;
+
+static void Hr_Timer_Task(void);
+
+/* Remaining time, valid for delays under 2^31 us */
+static inline int32_t Hr_Timer_Left(uint32_t expiry, uint32_t now) {
+	return (int32_t) (expiry - now);
+}
+
+static void Hr_Timer_Unlink(uint8_t id) {
+	uint8_t *link = &hr_timer.head;
+
+	while (*link != HR_TIMER_NONE) {
+		if (*link == id) {
+			*link = hr_timer.slots[id].next;
+			break;
+		}
+		link = &hr_timer.slots[*link].next;
+	}
+	hr_timer.slots[id].armed = false;
+}
+
+static void Hr_Timer_Link(uint8_t id, uint32_t now) {
+	hr_timer_slot_t *slot = &hr_timer.slots[id];
+	uint8_t *link = &hr_timer.head;
+
+	while (*link != HR_TIMER_NONE
+			&& Hr_Timer_Left(hr_timer.slots[*link].expiry, now) <= Hr_Timer_Left(slot->expiry, now)) {
+		link = &hr_timer.slots[*link].next;
+	}
+	slot->next = *link;
+	slot->armed = true;
+	*link = id;
+}
+
+/*
+ * Set the compare channel on the first timer, in a critical section.
+ * TIM2 stops in Stop2, which is held off while a timer is armed.
+ */
+static void Hr_Timer_Program(void) {
+	if (hr_timer.head == HR_TIMER_NONE) {
+		HR_TIM->DIER &= ~TIM_DIER_CC1IE;
+		UTIL_LPM_SetStopMode(1 << CFG_LPM_APP_HR_TIMER, UTIL_LPM_ENABLE);
+		return;
+	}
+	UTIL_LPM_SetStopMode(1 << CFG_LPM_APP_HR_TIMER, UTIL_LPM_DISABLE);
+	HR_TIM->CCR1 = hr_timer.slots[hr_timer.head].expiry;
+	HR_TIM->SR = ~TIM_SR_CC1IF;
+	HR_TIM->DIER |= TIM_DIER_CC1IE;
+	// Already due while the compare was set, the match would only come after a wrap
+	if (Hr_Timer_Left(hr_timer.slots[hr_timer.head].expiry, HR_TIM->CNT) <= 0) {
+		HR_TIM->EGR = TIM_EGR_CC1G;
+	}
+}
+
+/*
+ * TIM2 was set up by MX_TIM2_Init as a free running 1 MHz counter.
+ */
+void Hr_Timer_Init(void) {
+	memset(&hr_timer, 0, sizeof(hr_timer));
+	hr_timer.head = HR_TIMER_NONE;
+	UTIL_SEQ_RegTask(1 << CFG_TASK_HR_TIMER_ID, UTIL_SEQ_RFU, Hr_Timer_Task);
+	__HAL_TIM_ENABLE(&HR_TIMER_TIM_HANDLE);
+}
+
+bool Hr_Timer_Create(uint8_t *id, Hr_Timer_Mode_t mode, Hr_Timer_Cb_t callback) {
+	for (uint8_t i = 0; i < HR_TIMER_MAX; i++) {
+		if (!hr_timer.slots[i].created) {
+			hr_timer.slots[i].created = true;
+			hr_timer.slots[i].mode = mode;
+			hr_timer.slots[i].callback = callback;
+			*id = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * (Re)start a timer, a repeated one then expires every delay_us without drifting.
+ */
+void Hr_Timer_Start(uint8_t id, uint32_t delay_us) {
+	uint32_t now;
+
+	if (id >= HR_TIMER_MAX || !hr_timer.slots[id].created) {
+		return;
+	}
+	UTILS_ENTER_CRITICAL_SECTION();
+	now = HR_TIM->CNT;
+	if (hr_timer.slots[id].armed) {
+		Hr_Timer_Unlink(id);
+	}
+	hr_timer.expired &= ~(1UL << id);
+	hr_timer.slots[id].period_us = MAX(delay_us, 1);
+	hr_timer.slots[id].expiry = now + hr_timer.slots[id].period_us;
+	Hr_Timer_Link(id, now);
+	Hr_Timer_Program();
+	UTILS_EXIT_CRITICAL_SECTION();
+}
+
+/*
+ * The callback does not run afterwards, even if the timer had already expired.
+ */
+void Hr_Timer_Stop(uint8_t id) {
+	if (id >= HR_TIMER_MAX) {
+		return;
+	}
+	UTILS_ENTER_CRITICAL_SECTION();
+	if (hr_timer.slots[id].armed) {
+		Hr_Timer_Unlink(id);
+		Hr_Timer_Program();
+	}
+	hr_timer.expired &= ~(1UL << id);
+	UTILS_EXIT_CRITICAL_SECTION();
+}
+
+bool Hr_Timer_Is_Running(uint8_t id) {
+	return id < HR_TIMER_MAX && (hr_timer.slots[id].armed || (hr_timer.expired & (1UL << id)));
+}
+
+/*
+ * Microseconds, wraps around every 71 minutes and does not count in Stop2.
+ */
+uint32_t Hr_Timer_Now(void) {
+	return HR_TIM->CNT;
+}
+
+/*
+ * Compare match, every due timer is handed to the task.
+ */
+void HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef *htim) {
+	uint32_t now;
+
+	if (htim->Instance != HR_TIM) {
+		return;
+	}
+	now = HR_TIM->CNT;
+	while (hr_timer.head != HR_TIMER_NONE && Hr_Timer_Left(hr_timer.slots[hr_timer.head].expiry, now) <= 0) {
+		uint8_t id = hr_timer.head;
+		hr_timer_slot_t *slot = &hr_timer.slots[id];
+
+		Hr_Timer_Unlink(id);
+		hr_timer.expired |= (1UL << id);
+		if (slot->mode == HR_TIMER_REPEATED) {
+			slot->expiry += slot->period_us;
+			// Late by more than a period, skip the missed expiries
+			if (Hr_Timer_Left(slot->expiry, now) <= 0) {
+				slot->expiry = now + slot->period_us;
+			}
+			Hr_Timer_Link(id, now);
+		}
+	}
+	Hr_Timer_Program();
+	UTIL_SEQ_SetTask(1 << CFG_TASK_HR_TIMER_ID, CFG_SCH_PRIO_0);
+}
+
+/*
+ * A timer stopped or restarted by an earlier callback is skipped.
+ */
+static void Hr_Timer_Task(void) {
+	PROFILE_BEGIN(TASK_HR_TIMER);
+
+	for (uint8_t id = 0; id < HR_TIMER_MAX && hr_timer.expired; id++) {
+		bool due;
+
+		UTILS_ENTER_CRITICAL_SECTION();
+		due = (hr_timer.expired & (1UL << id)) != 0;
+		hr_timer.expired &= ~(1UL << id);
+		UTILS_EXIT_CRITICAL_SECTION();
+		if (due && hr_timer.slots[id].callback) {
+			hr_timer.slots[id].callback();
+		}
+	}
+	PROFILE_END(TASK_HR_TIMER);
+}
@@ -0,0 +1,187 @@
+#include <string.h>
+#include "hud.h"
+#include "screen.h"
+#include "st7735.h"
+#include "frame.h"
+#include "main.h"
+#include "app.h"
+
+#define HUD_GLYPH_WIDTH 3
+#define HUD_GLYPH_HEIGHT 5
+#define HUD_GLYPH_ADVANCE (HUD_GLYPH_WIDTH + 1)
+#define HUD_ROW_1 2
+#define HUD_ROW_2 8
+
+// Colors are sent as is by ST7735_DrawImage, they have to be stored big endian
+#define HUD_SWAP(color) ((uint16_t) (((color) << 8) | ((color) >> 8)))
+
+typedef struct {
+	UI_Widget_t widget;
+	uint16_t color;
+	uint16_t bgcolor;
+	bool chord;
+	uint32_t window_tick;
+	uint32_t window_bytes;
+	uint32_t window_frames;
+	uint32_t window_busy;
+	uint16_t fps;
+	uint16_t worst_tenth_ms;
+	uint8_t busy;
+	uint32_t spi_bytes;
+	uint32_t report_age;
+} hud_t;
+
+// 3x5 glyphs, one octal digit per row from top to bottom, MSB on the left
+static const char hud_charset[] = " 0123456789.%ABCEFGIMPSUX";
+static const uint16_t hud_glyphs[] = { 000000, 075557, 026227, 071747, 071717, 055711, 074717, 074757, 071111, 075757,
+		075717, 000002, 051245, 025755, 065656, 074447, 074647, 074644, 074557, 072227, 057755, 065644, 074717, 055557,
+		055255 };
+
+static hud_t hud;
+static uint16_t hud_pixels[HUD_WIDTH * HUD_HEIGHT];
+
+static void Hud_Put_Char(uint8_t col, uint8_t y, char c) {
+	const char *found = strchr(hud_charset, c);
+	uint16_t glyph = (found != NULL && c != '\0') ? hud_glyphs[found - hud_charset] : 0;
+	uint16_t x = 1 + col * HUD_GLYPH_ADVANCE;
+
+	if (x + HUD_GLYPH_WIDTH > hud.widget.bounds.w) {
+		return;
+	}
+
+	for (uint8_t j = 0; j < HUD_GLYPH_HEIGHT; j++) {
+		uint16_t *pixel = &hud_pixels[(y + j) * hud.widget.bounds.w + x];
+		uint8_t bits = (glyph >> ((HUD_GLYPH_HEIGHT - 1 - j) * 3)) & 07;
+		for (uint8_t i = 0; i < HUD_GLYPH_WIDTH; i++) {
+			pixel[i] = (bits & (04 >> i)) ? hud.color : hud.bgcolor;
+		}
+	}
+}
+
+static uint8_t Hud_Put_Text(uint8_t col, uint8_t y, const char *text) {
+	while (*text) {
+		Hud_Put_Char(col++, y, *text++);
+	}
+	return col;
+}
+
+/*
+ * Fixed width, right aligned decimal number, clamped to the number of digits.
+ * A dot is inserted before the last digit when tenths is set.
+ */
+static uint8_t Hud_Put_Number(uint8_t col, uint8_t y, uint32_t value, uint8_t digits, bool tenths) {
+	uint32_t max = 1;
+	uint8_t width = digits + (tenths ? 1 : 0);
+	uint8_t pos = col + width;
+
+	for (uint8_t i = 0; i < digits; i++) {
+		max *= 10;
+	}
+	if (value >= max) {
+		value = max - 1;
+	}
+
+	for (uint8_t i = 0; i < digits; i++) {
+		if (tenths && i == 1) {
+			Hud_Put_Char(--pos, y, '.');
+		}
+		// Keep the digit left of the dot so 0.5 does not read as .5
+		if (value == 0 && i > (tenths ? 1 : 0)) {
+			Hud_Put_Char(--pos, y, ' ');
+		} else {
+			Hud_Put_Char(--pos, y, '0' + value % 10);
+		}
+		value /= 10;
+	}
+	return col + width;
+}
+
+static void Hud_Paint(UI_Widget_t *widget, bool full) {
+	uint16_t count = widget->bounds.w * widget->bounds.h;
+	uint8_t col;
+
+	for (uint16_t i = 0; i < count; i++) {
+		hud_pixels[i] = hud.bgcolor;
+	}
+
+	col = Hud_Put_Text(0, HUD_ROW_1, "FPS");
+	col = Hud_Put_Number(col, HUD_ROW_1, hud.fps, 3, false);
+	col = Hud_Put_Text(col + 1, HUD_ROW_1, "MAX");
+	col = Hud_Put_Number(col, HUD_ROW_1, hud.worst_tenth_ms, 3, true);
+	col = Hud_Put_Text(col + 1, HUD_ROW_1, "CPU");
+	col = Hud_Put_Number(col, HUD_ROW_1, hud.busy, 3, false);
+	Hud_Put_Text(col, HUD_ROW_1, "%");
+
+	col = Hud_Put_Text(0, HUD_ROW_2, "SPI");
+	col = Hud_Put_Number(col, HUD_ROW_2, hud.spi_bytes, 5, false);
+	col = Hud_Put_Text(col, HUD_ROW_2, "B");
+	col = Hud_Put_Text(col + 1, HUD_ROW_2, "AGE");
+	col = Hud_Put_Number(col, HUD_ROW_2, hud.report_age, 5, false);
+	Hud_Put_Text(col, HUD_ROW_2, "MS");
+
+	// A single transfer, the HUD costs the same whatever the values
+	ST7735_DrawImage(widget->bounds.x, widget->bounds.y, widget->bounds.w, widget->bounds.h, hud_pixels);
+}
+
+/*
+ * Performance overlay shown in the header instead of the title.
+ * Statistics come from the frame scheduler, the overlay is only redrawn every HUD_UPDATE_MS.
+ */
+void Hud_Init(UI_Rect_t bounds, uint16_t color, uint16_t bgcolor) {
+	bounds.w = MIN(bounds.w, HUD_WIDTH);
+	bounds.h = MIN(bounds.h, HUD_HEIGHT);
+	memset(&hud, 0, sizeof(hud));
+	UI_Widget_Init(&hud.widget, bounds, Hud_Paint);
+	hud.color = HUD_SWAP(color);
+	hud.bgcolor = HUD_SWAP(bgcolor);
+
+	hud.window_tick = HAL_GetTick();
+	hud.window_bytes = ST7735_GetTransferredBytes();
+}
+
+UI_Widget_t* Hud_Get_Widget(void) {
+	return &hud.widget;
+}
+
+/*
+ * Toggle the overlay on View + Menu and refresh its values at a low rate.
+ */
+void Hud_Update(HID_Report_t *report) {
+	bool chord = report->BTN_View && report->BTN_Menu;
+	uint32_t tick = HAL_GetTick();
+	uint32_t elapsed_ms = tick - hud.window_tick;
+	const Frame_Stats_t *stats = Frame_Get_Stats();
+	uint32_t frames, bytes;
+
+	if (chord && !hud.chord) {
+		Screen_Set_Hud(!UI_Widget_Is_Visible(&hud.widget));
+	}
+	hud.chord = chord;
+
+	if (UI_Widget_Is_Visible(&hud.widget)) {
+		// Keep measuring frames even when nothing else animates
+		Frame_Request();
+	}
+
+	if (elapsed_ms < HUD_UPDATE_MS) {
+		return;
+	}
+
+	frames = stats->frames - hud.window_frames;
+	bytes = ST7735_GetTransferredBytes();
+
+	if (UI_Widget_Is_Visible(&hud.widget) && frames > 0) {
+		hud.fps = (frames * 1000 + elapsed_ms / 2) / elapsed_ms;
+		hud.worst_tenth_ms = stats->worst_us / 100;
+		hud.busy = (stats->busy_us - hud.window_busy) / (elapsed_ms * 10);
+		hud.spi_bytes = (bytes - hud.window_bytes) / frames;
+		hud.report_age = tick - HID_Host_Get_Report_Tick(App_Get_Player());
+		UI_Widget_Invalidate(&hud.widget);
+	}
+
+	hud.window_tick = tick;
+	hud.window_bytes = bytes;
+	hud.window_frames = stats->frames;
+	hud.window_busy = stats->busy_us;
+	Frame_Clear_Worst();
+}
@@ -0,0 +1,414 @@
+#include <string.h>
+#include "input.h"
+#include "latency.h"
+#include "main.h"
+#include "app_common.h"
+#include "trace.h"
+
+#define INPUT_STICK_CENTER 0x8000
+#define INPUT_TRIGGER_RAW_MAX 1023
+
+typedef enum {
+	INPUT_AXIS_LX = 0,
+	INPUT_AXIS_LY,
+	INPUT_AXIS_RX,
+	INPUT_AXIS_RY,
+	INPUT_AXIS_COUNT,
+} input_axis_t;
+
+typedef struct {
+	Input_Event_t events[INPUT_QUEUE_SIZE];
+	volatile uint8_t head;
+	volatile uint8_t tail;
+	uint32_t dropped;
+	uint32_t held;
+	uint32_t repeat_tick[INPUT_KEY_COUNT];
+	// Last raw stick values, and their rest position relative to INPUT_STICK_CENTER
+	uint16_t raw[INPUT_AXIS_COUNT];
+	int16_t offset[INPUT_AXIS_COUNT];
+	Input_Analog_t analog;
+} input_player_t;
+
+typedef struct {
+	input_player_t players[HID_HOST_MAX_PLAYERS];
+	uint32_t repeat_mask;
+	uint16_t repeat_delay;
+	uint16_t repeat_period;
+} input_t;
+
+static input_t input = {
+	.repeat_delay = INPUT_REPEAT_DELAY_MS,
+	.repeat_period = INPUT_REPEAT_PERIOD_MS,
+};
+
+// Unit vector of each direction, Q15
+static const int16_t INPUT_DIR_UNIT[INPUT_DIR_UPLEFT + 1][2] = {
+	[INPUT_DIR_UP] = { 0, 0x7FFF },
+	[INPUT_DIR_UPRIGHT] = { 0x5A82, 0x5A82 },
+	[INPUT_DIR_RIGHT] = { 0x7FFF, 0 },
+	[INPUT_DIR_DOWNRIGHT] = { 0x5A82, -0x5A82 },
+	[INPUT_DIR_DOWN] = { 0, -0x7FFF },
+	[INPUT_DIR_DOWNLEFT] = { -0x5A82, -0x5A82 },
+	[INPUT_DIR_LEFT] = { -0x7FFF, 0 },
+	[INPUT_DIR_UPLEFT] = { -0x5A82, 0x5A82 },
+};
+
+static bool Input_Push(uint8_t player, uint8_t key, uint8_t type, uint32_t tick, uint32_t stamp) {
+	input_player_t *queue = &input.players[player];
+	uint8_t head = queue->head;
+
+	if ((uint8_t) (head - queue->tail) >= INPUT_QUEUE_SIZE) {
+		queue->dropped++;
+		return false;
+	}
+	queue->events[head & (INPUT_QUEUE_SIZE - 1)] = (Input_Event_t ) { tick, stamp, key, type, player };
+	TRACE(TRACE_INPUT_EVENT, player, key, type, 0);
+	queue->head = head + 1;
+	return true;
+}
+
+/*
+ * Press past the press threshold, release only once back under the release threshold.
+ */
+static bool Input_Threshold(int32_t value, bool held, int32_t press, int32_t release) {
+	return held ? (value > release) : (value > press);
+}
+
+static uint32_t Input_Sqrt(uint32_t value) {
+	uint32_t root = 0;
+	uint32_t bit = 1UL << 30;
+
+	while (bit > value) {
+		bit >>= 2;
+	}
+	while (bit != 0) {
+		if (value >= root + bit) {
+			value -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return root;
+}
+
+/*
+ * Raw axis to a signed value around the calibrated center, within +-INPUT_ANALOG_MAX.
+ */
+static int32_t Input_Axis(const input_player_t *state, input_axis_t axis) {
+	int32_t value = (int32_t) state->raw[axis] - INPUT_STICK_CENTER - state->offset[axis];
+
+	return MAX(-INPUT_ANALOG_MAX, MIN(INPUT_ANALOG_MAX, value));
+}
+
+static int32_t Input_Dot(const Input_Stick_t *stick, uint8_t direction) {
+	return (stick->x * INPUT_DIR_UNIT[direction][0] + stick->y * INPUT_DIR_UNIT[direction][1]) >> 15;
+}
+
+/*
+ * Closest of the 8 directions, the current one is kept while the stick stays within 30 degrees of it.
+ */
+static uint8_t Input_Direction(const Input_Stick_t *stick, uint8_t current) {
+	uint8_t best = INPUT_DIR_NONE;
+	int32_t best_dot = 0;
+
+	if (stick->magnitude < ((current != INPUT_DIR_NONE) ? INPUT_DIR_RELEASE : INPUT_DIR_PRESS)) {
+		return INPUT_DIR_NONE;
+	}
+	if (current != INPUT_DIR_NONE
+			&& Input_Dot(stick, current) >= (int32_t) (((uint32_t) stick->magnitude * INPUT_DIR_KEEP_COS) >> 15)) {
+		return current;
+	}
+	for (uint8_t direction = INPUT_DIR_UP; direction <= INPUT_DIR_UPLEFT; direction++) {
+		int32_t dot = Input_Dot(stick, direction);
+
+		if (dot > best_dot) {
+			best = direction;
+			best_dot = dot;
+		}
+	}
+	return best;
+}
+
+/*
+ * Radial deadzone, the magnitude between the deadzone and the saturation is rescaled to the full range
+ * and the vector keeps its angle, so diagonals are not squared off.
+ */
+static void Input_Stick_Update(Input_Stick_t *stick, int32_t x, int32_t y) {
+	uint32_t magnitude = Input_Sqrt((uint32_t) (x * x) + (uint32_t) (y * y));
+	uint32_t scaled;
+
+	if (magnitude <= INPUT_STICK_DEADZONE) {
+		memset(stick, 0, sizeof(Input_Stick_t));
+		return;
+	}
+	scaled = (magnitude - INPUT_STICK_DEADZONE) * INPUT_ANALOG_MAX / (INPUT_STICK_SATURATION - INPUT_STICK_DEADZONE);
+	scaled = MIN(scaled, INPUT_ANALOG_MAX);
+	stick->x = x * (int32_t) scaled / (int32_t) magnitude;
+	stick->y = y * (int32_t) scaled / (int32_t) magnitude;
+	stick->magnitude = scaled;
+	stick->direction = Input_Direction(stick, stick->direction);
+}
+
+static uint16_t Input_Trigger(uint16_t value) {
+	uint32_t normalized = (uint32_t) MIN(value, INPUT_TRIGGER_RAW_MAX) * INPUT_ANALOG_MAX / INPUT_TRIGGER_RAW_MAX;
+
+	if (normalized <= INPUT_TRIGGER_DEADZONE) {
+		return 0;
+	}
+	return (normalized - INPUT_TRIGGER_DEADZONE) * INPUT_ANALOG_MAX / (INPUT_ANALOG_MAX - INPUT_TRIGGER_DEADZONE);
+}
+
+/*
+ * Computed once per report, everything in fixed point. The Y axes of the report grow downwards.
+ */
+static void Input_Analog_Update(input_player_t *state, const HID_Report_t *report) {
+	state->raw[INPUT_AXIS_LX] = report->JOY_LeftAxisX;
+	state->raw[INPUT_AXIS_LY] = report->JOY_LeftAxisY;
+	state->raw[INPUT_AXIS_RX] = report->JOY_RightAxisX;
+	state->raw[INPUT_AXIS_RY] = report->JOY_RightAxisY;
+	Input_Stick_Update(&state->analog.left, Input_Axis(state, INPUT_AXIS_LX), -Input_Axis(state, INPUT_AXIS_LY));
+	Input_Stick_Update(&state->analog.right, Input_Axis(state, INPUT_AXIS_RX), -Input_Axis(state, INPUT_AXIS_RY));
+	state->analog.left_trigger = Input_Trigger(report->TRG_Left);
+	state->analog.right_trigger = Input_Trigger(report->TRG_Right);
+}
+
+static uint32_t Input_Keys_From_Report(const HID_Report_t *report, const Input_Analog_t *analog, uint32_t held) {
+	uint32_t keys = 0;
+
+#define INPUT_HELD(key) ((held & INPUT_MASK(key)) != 0)
+#define INPUT_STICK(key, value) \
+	if (Input_Threshold(value, INPUT_HELD(key), INPUT_STICK_PRESS, INPUT_STICK_RELEASE)) keys |= INPUT_MASK(key)
+
+	keys |= report->BTN_A ? INPUT_MASK(INPUT_KEY_A) : 0;
+	keys |= report->BTN_B ? INPUT_MASK(INPUT_KEY_B) : 0;
+	keys |= report->BTN_X ? INPUT_MASK(INPUT_KEY_X) : 0;
+	keys |= report->BTN_Y ? INPUT_MASK(INPUT_KEY_Y) : 0;
+	keys |= report->BTN_BackLeft ? INPUT_MASK(INPUT_KEY_LB) : 0;
+	keys |= report->BTN_BackRight ? INPUT_MASK(INPUT_KEY_RB) : 0;
+	keys |= report->BTN_View ? INPUT_MASK(INPUT_KEY_VIEW) : 0;
+	keys |= report->BTN_Menu ? INPUT_MASK(INPUT_KEY_MENU) : 0;
+	keys |= report->BTN_Xbox ? INPUT_MASK(INPUT_KEY_XBOX) : 0;
+	keys |= report->BTN_Profile ? INPUT_MASK(INPUT_KEY_PROFILE) : 0;
+	keys |= report->BTN_LeftJoystick ? INPUT_MASK(INPUT_KEY_LSTICK) : 0;
+	keys |= report->BTN_RightJoystick ? INPUT_MASK(INPUT_KEY_RSTICK) : 0;
+
+	// Diagonals press both directions
+	switch (report->HAT_Switch) {
+	case HATSWITCH_UP:
+		keys |= INPUT_MASK(INPUT_KEY_UP);
+		break;
+	case HATSWITCH_UPRIGHT:
+		keys |= INPUT_MASK(INPUT_KEY_UP) | INPUT_MASK(INPUT_KEY_RIGHT);
+		break;
+	case HATSWITCH_RIGHT:
+		keys |= INPUT_MASK(INPUT_KEY_RIGHT);
+		break;
+	case HATSWITCH_DOWNRIGHT:
+		keys |= INPUT_MASK(INPUT_KEY_DOWN) | INPUT_MASK(INPUT_KEY_RIGHT);
+		break;
+	case HATSWITCH_DOWN:
+		keys |= INPUT_MASK(INPUT_KEY_DOWN);
+		break;
+	case HATSWITCH_DOWNLEFT:
+		keys |= INPUT_MASK(INPUT_KEY_DOWN) | INPUT_MASK(INPUT_KEY_LEFT);
+		break;
+	case HATSWITCH_LEFT:
+		keys |= INPUT_MASK(INPUT_KEY_LEFT);
+		break;
+	case HATSWITCH_UPLEFT:
+		keys |= INPUT_MASK(INPUT_KEY_UP) | INPUT_MASK(INPUT_KEY_LEFT);
+		break;
+	default:
+		break;
+	}
+
+	INPUT_STICK(INPUT_KEY_LSTICK_UP, analog->left.y);
+	INPUT_STICK(INPUT_KEY_LSTICK_DOWN, -analog->left.y);
+	INPUT_STICK(INPUT_KEY_LSTICK_LEFT, -analog->left.x);
+	INPUT_STICK(INPUT_KEY_LSTICK_RIGHT, analog->left.x);
+	INPUT_STICK(INPUT_KEY_RSTICK_UP, analog->right.y);
+	INPUT_STICK(INPUT_KEY_RSTICK_DOWN, -analog->right.y);
+	INPUT_STICK(INPUT_KEY_RSTICK_LEFT, -analog->right.x);
+	INPUT_STICK(INPUT_KEY_RSTICK_RIGHT, analog->right.x);
+
+	if (Input_Threshold(analog->left_trigger, INPUT_HELD(INPUT_KEY_LT), INPUT_TRIGGER_PRESS, INPUT_TRIGGER_RELEASE)) {
+		keys |= INPUT_MASK(INPUT_KEY_LT);
+	}
+	if (Input_Threshold(analog->right_trigger, INPUT_HELD(INPUT_KEY_RT), INPUT_TRIGGER_PRESS, INPUT_TRIGGER_RELEASE)) {
+		keys |= INPUT_MASK(INPUT_KEY_RT);
+	}
+
+#undef INPUT_STICK
+#undef INPUT_HELD
+
+	return keys;
+}
+
+/*
+ * Called by the HID host on each report notification of a player, tick is the notification time.
+ * Every key that changed state since the previous report queues a press or release event.
+ * Return true if an event was queued.
+ */
+bool Input_Report(uint8_t player, const HID_Report_t *report, uint32_t tick, uint32_t stamp) {
+	input_player_t *state;
+	uint32_t keys, changed;
+	bool queued = false;
+
+	if (player >= HID_HOST_MAX_PLAYERS) {
+		return false;
+	}
+	state = &input.players[player];
+	Input_Analog_Update(state, report);
+	keys = Input_Keys_From_Report(report, &state->analog, state->held);
+	changed = keys ^ state->held;
+	for (uint8_t key = 0; changed != 0; key++, changed >>= 1) {
+		if (changed & 1) {
+			bool pressed = (keys & INPUT_MASK(key)) != 0;
+			queued |= Input_Push(player, key, pressed ? INPUT_PRESS : INPUT_RELEASE, tick, stamp);
+			state->repeat_tick[key] = tick + input.repeat_delay;
+		}
+	}
+	state->held = keys;
+	return queued;
+}
+
+/*
+ * Queue the auto-repeat events due at tick.
+ * Return the ms until the next one while a repeating key is held, the caller has to poll again then, else 0.
+ */
+uint32_t Input_Poll(uint32_t tick) {
+	uint32_t next = 0;
+
+	for (uint8_t player = 0; player < HID_HOST_MAX_PLAYERS; player++) {
+		input_player_t *state = &input.players[player];
+		uint32_t repeating = state->held & input.repeat_mask;
+
+		for (uint8_t key = 0; key < INPUT_KEY_COUNT; key++) {
+			uint32_t left;
+
+			if (!(repeating & INPUT_MASK(key))) {
+				continue;
+			}
+			if ((int32_t) (tick - state->repeat_tick[key]) >= 0) {
+				Input_Push(player, key, INPUT_REPEAT, tick, Latency_Now());
+				state->repeat_tick[key] = tick + input.repeat_period;
+			}
+			left = MAX(state->repeat_tick[key] - tick, 1);
+			next = next ? MIN(next, left) : left;
+		}
+	}
+	return next;
+}
+
+bool Input_Get_Player_Event(uint8_t player, Input_Event_t *event) {
+	input_player_t *queue;
+	uint8_t tail;
+
+	if (player >= HID_HOST_MAX_PLAYERS) {
+		return false;
+	}
+	queue = &input.players[player];
+	tail = queue->tail;
+	if (tail == queue->head) {
+		return false;
+	}
+	*event = queue->events[tail & (INPUT_QUEUE_SIZE - 1)];
+	queue->tail = tail + 1;
+	if (event->type != INPUT_REPEAT) {
+		Latency_Arm(event->stamp);
+	}
+	return true;
+}
+
+/*
+ * Oldest event of any player, for the stages that do not care who pressed.
+ */
+bool Input_Get_Event(Input_Event_t *event) {
+	uint8_t oldest = HID_HOST_MAX_PLAYERS;
+	uint32_t stamp = 0;
+
+	for (uint8_t player = 0; player < HID_HOST_MAX_PLAYERS; player++) {
+		const input_player_t *queue = &input.players[player];
+
+		if (queue->tail != queue->head) {
+			uint32_t head_stamp = queue->events[queue->tail & (INPUT_QUEUE_SIZE - 1)].stamp;
+
+			if (oldest == HID_HOST_MAX_PLAYERS || (int32_t) (head_stamp - stamp) < 0) {
+				oldest = player;
+				stamp = head_stamp;
+			}
+		}
+	}
+	return Input_Get_Player_Event(oldest, event);
+}
+
+void Input_Flush(void) {
+	for (uint8_t player = 0; player < HID_HOST_MAX_PLAYERS; player++) {
+		input.players[player].tail = input.players[player].head;
+	}
+}
+
+uint32_t Input_Get_Held(void) {
+	uint32_t held = 0;
+
+	for (uint8_t player = 0; player < HID_HOST_MAX_PLAYERS; player++) {
+		held |= input.players[player].held;
+	}
+	return held;
+}
+
+uint32_t Input_Get_Player_Held(uint8_t player) {
+	return (player < HID_HOST_MAX_PLAYERS) ? input.players[player].held : 0;
+}
+
+void Input_Set_Repeat(uint32_t mask, uint16_t delay_ms, uint16_t period_ms) {
+	input.repeat_mask = mask;
+	input.repeat_delay = delay_ms;
+	input.repeat_period = period_ms;
+}
+
+uint32_t Input_Get_Dropped(void) {
+	uint32_t dropped = 0;
+
+	for (uint8_t player = 0; player < HID_HOST_MAX_PLAYERS; player++) {
+		dropped += input.players[player].dropped;
+	}
+	return dropped;
+}
+
+/*
+ * Calibrated and normalized sticks and triggers of a player, as of its last report.
+ */
+bool Input_Get_Analog(uint8_t player, Input_Analog_t *analog) {
+	if (player >= HID_HOST_MAX_PLAYERS) {
+		return false;
+	}
+	*analog = input.players[player].analog;
+	return true;
+}
+
+/*
+ * Take the current stick positions as their centers, to be called while the sticks rest.
+ * Refused if a stick is too far from the nominal center, it is probably held.
+ */
+bool Input_Calibrate(uint8_t player) {
+	input_player_t *state;
+
+	if (player >= HID_HOST_MAX_PLAYERS) {
+		return false;
+	}
+	state = &input.players[player];
+	for (uint8_t axis = 0; axis < INPUT_AXIS_COUNT; axis++) {
+		int32_t offset = (int32_t) state->raw[axis] - INPUT_STICK_CENTER;
+
+		if (offset <= -INPUT_CALIBRATE_RANGE || offset >= INPUT_CALIBRATE_RANGE) {
+			return false;
+		}
+	}
+	for (uint8_t axis = 0; axis < INPUT_AXIS_COUNT; axis++) {
+		state->offset[axis] = (int32_t) state->raw[axis] - INPUT_STICK_CENTER;
+	}
+	return true;
+}
@@ -0,0 +1,111 @@
+#include <string.h>
+#include "latency.h"
+#include "main.h"
+#include "dbg_trace.h"
+
+typedef struct {
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint16_t buckets[LATENCY_BUCKETS + 1];	// Last one counts everything above the range
+} latency_histogram_t;
+
+typedef struct {
+	bool armed;
+	uint32_t stamp;
+	App_Stage_t stage;
+	latency_histogram_t histograms[STAGE_COUNT];
+} latency_t;
+
+static latency_t latency;
+
+static uint32_t Latency_Percentile(const latency_histogram_t *histogram, uint8_t percent) {
+	uint32_t target = (histogram->count * percent + 99) / 100;
+	uint32_t sum = 0;
+
+	for (uint8_t i = 0; i < LATENCY_BUCKETS; i++) {
+		sum += histogram->buckets[i];
+		if (sum >= target) {
+			// Upper bound of the bucket, never above what was really measured
+			return MIN((i + 1) * LATENCY_BUCKET_US, histogram->max);
+		}
+	}
+	return histogram->max;
+}
+
+/*
+ * Microsecond clock built from the HAL tick and the SysTick counter.
+ * Unlike the DWT cycle counter it keeps running while the core sleeps between frames.
+ */
+uint32_t Latency_Now(void) {
+	uint32_t tick, val;
+
+	do {
+		tick = HAL_GetTick();
+		val = SysTick->VAL;
+	} while (tick != HAL_GetTick());
+
+	return tick * 1000 + ((SysTick->LOAD - val) * 1000) / (SysTick->LOAD + 1);
+}
+
+/*
+ * Start a measurement from an input consumed by the stage, stamp being the notification time.
+ * The oldest pending input is kept when several are consumed in the same frame.
+ */
+void Latency_Arm(uint32_t stamp) {
+	if (!latency.armed) {
+		latency.armed = true;
+		latency.stamp = stamp;
+	}
+}
+
+/*
+ * Called by the display driver at the end of every transfer.
+ */
+void Latency_Photon(void) {
+	latency_histogram_t *histogram;
+	uint32_t elapsed;
+
+	if (!latency.armed) {
+		return;
+	}
+	latency.armed = false;
+
+	elapsed = Latency_Now() - latency.stamp;
+	histogram = &latency.histograms[latency.stage];
+	if (histogram->count == 0 || elapsed < histogram->min) {
+		histogram->min = elapsed;
+	}
+	if (elapsed > histogram->max) {
+		histogram->max = elapsed;
+	}
+	histogram->count++;
+	histogram->buckets[MIN(elapsed / LATENCY_BUCKET_US, LATENCY_BUCKETS)]++;
+}
+
+/*
+ * An input that did not change any pixel during its frame is not measured.
+ */
+void Latency_Frame_End(void) {
+	latency.armed = false;
+}
+
+void Latency_Set_Stage(App_Stage_t stage) {
+	latency.stage = stage;
+	latency.armed = false;
+}
+
+void Latency_Dump(App_Stage_t stage, const char *name) {
+	const latency_histogram_t *histogram = &latency.histograms[stage];
+
+	if (histogram->count == 0) {
+		return;
+	}
+	APP_DBG_MSG("Latency %s : n %lu, min %lu us, p50 %lu us, p99 %lu us, max %lu us\n", name, histogram->count,
+			histogram->min, Latency_Percentile(histogram, 50), Latency_Percentile(histogram, 99), histogram->max)
+}
+
+void Latency_Reset(void) {
+	memset(latency.histograms, 0, sizeof(latency.histograms));
+	latency.armed = false;
+}
@@ -0,0 +1,146 @@
+#include <string.h>
+#include "nvm.h"
+#include "main.h"
+#include "shci.h"
+#include "utilities_conf.h"
+#include "dbg_trace.h"
+
+#define NVM_MAGIC 0x4E564D31
+
+typedef struct {
+	uint32_t magic;
+	uint16_t size;
+	uint16_t crc;
+	uint8_t data[NVM_SLOT_SIZE];
+} nvm_slot_t;
+
+typedef struct {
+	nvm_slot_t slots[NVM_SLOT_COUNT];
+} nvm_page_t;
+
+_Static_assert(sizeof(nvm_page_t) <= FLASH_PAGE_SIZE, "NVM slots do not fit the flash page");
+_Static_assert(sizeof(nvm_slot_t) % 8 == 0, "NVM slots must be double word aligned");
+
+// Start of the NVM page, from the linker script
+extern const uint8_t _snvm[];
+#define NVM_PAGE ((const nvm_page_t*) _snvm)
+
+// The whole page is erased on each write, the other slots are kept here meanwhile
+static nvm_page_t nvm_image;
+
+static uint16_t Nvm_Crc(const uint8_t *data, uint16_t size) {
+	uint16_t crc = 0xFFFF;
+
+	for (uint16_t i = 0; i < size; i++) {
+		crc ^= (uint16_t) data[i] << 8;
+		for (uint8_t b = 0; b < 8; b++) {
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+		}
+	}
+	return crc;
+}
+
+static bool Nvm_Slot_Valid(const nvm_slot_t *slot) {
+	return slot->magic == NVM_MAGIC && slot->size <= NVM_SLOT_SIZE && slot->crc == Nvm_Crc(slot->data, slot->size);
+}
+
+/*
+ * Run one flash operation when CPU2 allows it, as described in AN5289.
+ * CPU2 holds the semaphore while it needs the flash for a radio event.
+ */
+static HAL_StatusTypeDef Nvm_Flash_Operation(uint32_t address, uint64_t data, bool erase) {
+	HAL_StatusTypeDef status = HAL_BUSY;
+
+	while (status == HAL_BUSY) {
+		while (LL_HSEM_IsSemaphoreLocked(HSEM, CFG_HW_BLOCK_FLASH_REQ_BY_CPU2_SEMID)) {
+		}
+		UTILS_ENTER_CRITICAL_SECTION();
+		if (!LL_HSEM_IsSemaphoreLocked(HSEM, CFG_HW_BLOCK_FLASH_REQ_BY_CPU2_SEMID)) {
+			if (erase) {
+				FLASH_EraseInitTypeDef erase_init = {
+					.TypeErase = FLASH_TYPEERASE_PAGES,
+					.Page = (address - FLASH_BASE) / FLASH_PAGE_SIZE,
+					.NbPages = 1,
+				};
+				uint32_t error;
+				status = HAL_FLASHEx_Erase(&erase_init, &error);
+			} else {
+				status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, address, data);
+			}
+		}
+		UTILS_EXIT_CRITICAL_SECTION();
+	}
+	return status;
+}
+
+static bool Nvm_Flush(void) {
+	uint32_t address = (uint32_t) _snvm;
+	const uint64_t *data = (const uint64_t*) &nvm_image;
+	HAL_StatusTypeDef status;
+
+	SHCI_C2_FLASH_EraseActivity(ERASE_ACTIVITY_ON);
+	HAL_FLASH_Unlock();
+	__HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+	while (LL_HSEM_1StepLock(HSEM, CFG_HW_FLASH_SEMID)) {
+	}
+
+	status = Nvm_Flash_Operation(address, 0, true);
+	for (uint16_t i = 0; status == HAL_OK && i < sizeof(nvm_page_t) / sizeof(uint64_t); i++) {
+		status = Nvm_Flash_Operation(address + i * sizeof(uint64_t), data[i], false);
+	}
+
+	LL_HSEM_ReleaseLock(HSEM, CFG_HW_FLASH_SEMID, 0);
+	HAL_FLASH_Lock();
+	SHCI_C2_FLASH_EraseActivity(ERASE_ACTIVITY_OFF);
+
+	if (status != HAL_OK) {
+		APP_DBG_MSG("-- NVM : write failed, status %d\n", status)
+	}
+	return status == HAL_OK;
+}
+
+/*
+ * Copy the slot into data, return false if it was never written or is corrupted.
+ */
+bool Nvm_Read(Nvm_Slot_t slot, void *data, uint16_t size) {
+	const nvm_slot_t *stored;
+
+	if (slot >= NVM_SLOT_COUNT) {
+		return false;
+	}
+	stored = &NVM_PAGE->slots[slot];
+	if (!Nvm_Slot_Valid(stored) || stored->size != size) {
+		return false;
+	}
+	memcpy(data, stored->data, size);
+	return true;
+}
+
+/*
+ * Erase the page and write it back with the slot replaced, which stalls the CPU for tens of ms.
+ * Nothing is written if the slot already holds the same data.
+ */
+bool Nvm_Write(Nvm_Slot_t slot, const void *data, uint16_t size) {
+	if (slot >= NVM_SLOT_COUNT || size > NVM_SLOT_SIZE) {
+		return false;
+	}
+	if (Nvm_Slot_Valid(&NVM_PAGE->slots[slot]) && NVM_PAGE->slots[slot].size == size
+			&& memcmp(NVM_PAGE->slots[slot].data, data, size) == 0) {
+		return true;
+	}
+
+	for (uint8_t i = 0; i < NVM_SLOT_COUNT; i++) {
+		if (Nvm_Slot_Valid(&NVM_PAGE->slots[i])) {
+			nvm_image.slots[i] = NVM_PAGE->slots[i];
+		} else {
+			memset(&nvm_image.slots[i], 0xFF, sizeof(nvm_slot_t));
+		}
+	}
+	nvm_image.slots[slot].magic = NVM_MAGIC;
+	nvm_image.slots[slot].size = size;
+	memset(nvm_image.slots[slot].data, 0xFF, NVM_SLOT_SIZE);
+	memcpy(nvm_image.slots[slot].data, data, size);
+	nvm_image.slots[slot].crc = Nvm_Crc(nvm_image.slots[slot].data, size);
+
+	return Nvm_Flush();
+}
@@ -0,0 +1,158 @@
+#include <string.h>
+#include "power.h"
+#include "main.h"
+#include "app_common.h"
+#include "hw_if.h"
+#include "stm32_lpm.h"
+#include "dbg_trace.h"
+#include "dbg_out.h"
+#include "latency.h"
+
+#define POWER_STOP_MIN_TICKS DIVR(POWER_STOP_MIN_US, CFG_TS_TICK_VAL)
+// Returned by HW_TS_RTC_ReadLeftTicksToCount when no timer runs
+#define POWER_NO_TIMER 0xFFFF
+// The subseconds count down at LSE / CFG_RTCCLK_DIV, a calendar second lasts CFG_RTC_SYNCH_PRESCALER + 1 of them
+#define POWER_RTC_SECOND (CFG_RTC_SYNCH_PRESCALER + 1UL)
+#define POWER_RTC_WRAP (3600UL * POWER_RTC_SECOND)
+
+typedef struct {
+	Power_State_t state;
+	uint32_t enter_us;
+	uint32_t enter_rtc;
+	uint32_t exit_us;
+	// Part of a ms spent in Stop2 not given back to the HAL tick yet
+	uint32_t tick_remainder_us;
+	Power_Stats_t stats;
+} power_t;
+
+static const char* const state_names[POWER_STATE_COUNT] = { "run", "sleep", "stop2" };
+static const char* const wake_names[POWER_WAKE_COUNT] = { "timer", "BLE", "UART", "hr timer", "tick", "other" };
+
+static power_t power;
+
+static uint8_t Power_Bcd(uint32_t value) {
+	return ((value >> 4) & 0x0F) * 10 + (value & 0x0F);
+}
+
+/*
+ * RTC subseconds since the start of the hour, the RTC is the only clock running in Stop2.
+ * The timer server sets BYPSHAD, both registers are read until stable.
+ */
+static uint32_t Power_Rtc_Now(void) {
+	uint32_t tr, ssr;
+
+	do {
+		tr = RTC->TR;
+		ssr = RTC->SSR & RTC_SSR_SS;
+	} while (tr != RTC->TR || ssr != (RTC->SSR & RTC_SSR_SS));
+
+	return (Power_Bcd((tr & (RTC_TR_MNT | RTC_TR_MNU)) >> RTC_TR_MNU_Pos) * 60
+			+ Power_Bcd(tr & (RTC_TR_ST | RTC_TR_SU))) * POWER_RTC_SECOND + (CFG_RTC_SYNCH_PRESCALER - ssr);
+}
+
+static Power_Wake_t Power_Wake_Source(void) {
+	if (NVIC_GetPendingIRQ(RTC_WKUP_IRQn)) {
+		return POWER_WAKE_TIMER;
+	}
+	if (NVIC_GetPendingIRQ(IPCC_C1_RX_IRQn) || NVIC_GetPendingIRQ(IPCC_C1_TX_IRQn) || NVIC_GetPendingIRQ(HSEM_IRQn)) {
+		return POWER_WAKE_BLE;
+	}
+	if (NVIC_GetPendingIRQ(DMA1_Channel1_IRQn) || NVIC_GetPendingIRQ(USART1_IRQn)) {
+		return POWER_WAKE_UART;
+	}
+	if (NVIC_GetPendingIRQ(TIM2_IRQn)) {
+		return POWER_WAKE_HR_TIMER;
+	}
+	if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) {
+		return POWER_WAKE_TICK;
+	}
+	return POWER_WAKE_OTHER;
+}
+
+void Power_Init(void) {
+	memset(&power, 0, sizeof(power));
+	power.exit_us = Latency_Now();
+}
+
+/*
+ * Called by the sequencer when no task is pending. The modules needing their clocks hold off
+ * Stop2 through UTIL_LPM, here it is also held off when the next timer is too close.
+ */
+void Power_Idle(void) {
+	uint16_t left = HW_TS_RTC_ReadLeftTicksToCount();
+	bool deadline = (left != POWER_NO_TIMER && left < POWER_STOP_MIN_TICKS);
+
+	if (deadline) {
+		power.stats.stop_deferred++;
+	} else {
+		// The UART stops with the clocks, the buffered traces go out first and Stop2 follows their DMA
+		Dbg_Out_Flush();
+	}
+	UTIL_LPM_SetStopMode(1 << CFG_LPM_APP_DEADLINE, deadline ? UTIL_LPM_DISABLE : UTIL_LPM_ENABLE);
+	UTIL_LPM_EnterLowPower();
+}
+
+/*
+ * Called by stm32_lpm_if.c in a critical section, before the clocks are changed.
+ */
+void Power_Enter(Power_State_t state) {
+	power.state = state;
+	power.enter_us = Latency_Now();
+	power.stats.residency_us[POWER_RUN] += power.enter_us - power.exit_us;
+	power.stats.entries[state]++;
+	if (state == POWER_STOP) {
+		power.enter_rtc = Power_Rtc_Now();
+	}
+}
+
+/*
+ * Called by stm32_lpm_if.c in a critical section once the clocks are back, the wake up interrupt is still pending.
+ * The tick runs while sleeping, in Stop2 the time is taken from the RTC and given back to the HAL tick.
+ */
+void Power_Exit(void) {
+	uint32_t elapsed_us;
+
+	power.stats.wakes[power.state][Power_Wake_Source()]++;
+	if (power.state == POWER_STOP) {
+		uint32_t ticks = (Power_Rtc_Now() + POWER_RTC_WRAP - power.enter_rtc) % POWER_RTC_WRAP;
+
+		elapsed_us = (uint32_t) ((uint64_t) ticks * 1000000UL * CFG_RTCCLK_DIV / LSE_VALUE);
+		power.tick_remainder_us += elapsed_us;
+		uwTick += power.tick_remainder_us / 1000;
+		power.tick_remainder_us %= 1000;
+		power.exit_us = Latency_Now();
+	} else {
+		power.exit_us = Latency_Now();
+		elapsed_us = power.exit_us - power.enter_us;
+	}
+	power.stats.residency_us[power.state] += elapsed_us;
+	power.state = POWER_RUN;
+}
+
+const Power_Stats_t* Power_Get_Stats(void) {
+	return &power.stats;
+}
+
+void Power_Dump(void) {
+	const Power_Stats_t *stats = &power.stats;
+	uint64_t total = 0;
+
+	for (uint8_t i = 0; i < POWER_STATE_COUNT; i++) {
+		total += stats->residency_us[i];
+	}
+	if (total == 0) {
+		return;
+	}
+	for (uint8_t i = 0; i < POWER_STATE_COUNT; i++) {
+		APP_DBG_MSG("Power %s : %lu ms (%lu %%), %lu entries\n", state_names[i], (uint32_t) (stats->residency_us[i] / 1000),
+				(uint32_t) (stats->residency_us[i] * 100 / total), stats->entries[i])
+	}
+	for (uint8_t i = POWER_SLEEP; i < POWER_STATE_COUNT; i++) {
+		for (uint8_t j = 0; j < POWER_WAKE_COUNT; j++) {
+			if (stats->wakes[i][j]) {
+				APP_DBG_MSG("Wake from %s by %s : %lu\n", state_names[i], wake_names[j], stats->wakes[i][j])
+			}
+		}
+	}
+	APP_DBG_MSG("Stop2 deferred by a close timer : %lu\n", stats->stop_deferred)
+}
@@ -0,0 +1,61 @@
+#include <string.h>
+#include "profile.h"
+#ifdef PROFILE_HOST
+#include <stdio.h>
+#define PROFILE_PRINT(...) printf(__VA_ARGS__);
+#else
+#include "app_common.h"
+#include "dbg_trace.h"
+#include "trace.h"
+#define PROFILE_PRINT(...) APP_DBG_MSG(__VA_ARGS__)
+#endif
+
+#define PROFILE_NAME(id, name) name,
+static const char* const zone_names[PROFILE_ZONE_COUNT] = {
+	PROFILE_ZONES(PROFILE_NAME)
+};
+#undef PROFILE_NAME
+
+static Profile_Zone_t zones[PROFILE_ZONE_COUNT];
+
+void Profile_Add(Profile_Zone_Id_t zone, uint32_t elapsed) {
+	Profile_Zone_t *stats = &zones[zone];
+
+	if (stats->count++ == 0 || elapsed < stats->min) {
+		stats->min = elapsed;
+	}
+	if (elapsed > stats->max) {
+		stats->max = elapsed;
+	}
+	stats->total += elapsed;
+}
+
+const Profile_Zone_t* Profile_Get_Zone(Profile_Zone_Id_t zone) {
+	return (zone < PROFILE_ZONE_COUNT) ? &zones[zone] : NULL;
+}
+
+void Profile_Reset(void) {
+	memset(zones, 0, sizeof(zones));
+}
+
+/*
+ * Table on the text traces and, on the target, one binary trace record per zone.
+ */
+void Profile_Dump(void) {
+	PROFILE_PRINT("%-20s %10s %10s %10s %10s %12s (%s)\n", "zone", "count", "min", "avg", "max", "total k", PROFILE_UNIT)
+	for (uint8_t i = 0; i < PROFILE_ZONE_COUNT; i++) {
+		const Profile_Zone_t *stats = &zones[i];
+		uint32_t avg;
+
+		if (stats->count == 0) {
+			continue;
+		}
+		avg = (uint32_t) (stats->total / stats->count);
+		PROFILE_PRINT("%-20s %10lu %10lu %10lu %10lu %12lu\n", zone_names[i], (unsigned long) stats->count,
+				(unsigned long) stats->min, (unsigned long) avg, (unsigned long) stats->max,
+				(unsigned long) (stats->total / 1000))
+#ifndef PROFILE_HOST
+		TRACE(TRACE_PROFILE_ZONE, i, stats->count, avg, stats->max);
+#endif
+	}
+}
@@ -1,34 +1,151 @@
 #include "screen.h"
 #include "st7735.h"
+#include "hud.h"
+
+#define SCREEN_BODY_HEIGHT (ST7735_HEIGHT - SCREEN_HEADER_HEIGHT)
+#define SCREEN_BATTERY_WIDTH 30
+#define SCREEN_MENU_ROW_HEIGHT 30
+
+typedef enum {
+	SCREEN_BODY_STATUS = 0, SCREEN_BODY_MENU, SCREEN_BODY_CANVAS,
+} screen_body_t;
+
+// Widget tree : root -> header (title, HUD, battery) / body (status, menu)
+static UI_Panel_t root;
+static UI_Panel_t header;
+static UI_Label_t title;
+static UI_Battery_t battery_level;
+static UI_Panel_t body;
+static UI_Panel_t status;
+static UI_Label_t status_title;
+static UI_Label_t status_text;
+static UI_Menu_t menu;
+static screen_body_t body_mode;
+// Body already cleared to the background color by a transition
+static bool body_clean;
+
+static void Screen_Set_Body(screen_body_t mode) {
+	if (body_mode == mode) {
+		return;
+	}
+	body_mode = mode;
+	Transition_Stop();
+	UI_Widget_Set_Visible(&status.widget, mode == SCREEN_BODY_STATUS);
+	UI_Widget_Set_Visible(&menu.widget, mode == SCREEN_BODY_MENU);
+	if (body_clean) {
+		// Only the newly visible widgets have to be painted
+		UI_Widget_Validate(&body.widget);
+		body_clean = false;
+	} else {
+		// Stages may have drawn anywhere on the body, clear it entirely
+		UI_Widget_Invalidate(&body.widget);
+	}
+}
 
 void Screen_Init(void) {
 	ST7735_Init();
-	Screen_Background_Draw();
-	Screen_Header_Draw("INIT", 0);
+
+	UI_Panel_Init(&root, (UI_Rect_t ) { 0, 0, ST7735_WIDTH, ST7735_HEIGHT }, SCREEN_BACKGROUND_COLOR);
+
+	UI_Panel_Init(&header, (UI_Rect_t ) { 0, 0, ST7735_WIDTH, SCREEN_HEADER_HEIGHT }, SCREEN_HEADER_COLOR);
+	UI_Label_Init(&title, (UI_Rect_t ) { SCREEN_BATTERY_WIDTH, 0, ST7735_WIDTH - 2 * SCREEN_BATTERY_WIDTH,
+			SCREEN_HEADER_HEIGHT }, &Font_7x10, ST7735_BLACK, SCREEN_HEADER_COLOR);
+	UI_Battery_Init(&battery_level, (UI_Rect_t ) { ST7735_WIDTH - SCREEN_BATTERY_WIDTH, 0, SCREEN_BATTERY_WIDTH,
+			SCREEN_HEADER_HEIGHT }, &Font_7x10, ST7735_BLACK, SCREEN_HEADER_COLOR);
+	Hud_Init(title.widget.bounds, ST7735_BLACK, SCREEN_HEADER_COLOR);
+	UI_Widget_Add(&header.widget, &title.widget);
+	UI_Widget_Add(&header.widget, Hud_Get_Widget());
+	UI_Widget_Set_Visible(Hud_Get_Widget(), false);
+	UI_Widget_Add(&header.widget, &battery_level.widget);
+
+	UI_Panel_Init(&body, (UI_Rect_t ) { 0, SCREEN_HEADER_HEIGHT, ST7735_WIDTH, SCREEN_BODY_HEIGHT },
+			SCREEN_BACKGROUND_COLOR);
+	UI_Panel_Init(&status, body.widget.bounds, SCREEN_BACKGROUND_COLOR);
+	UI_Label_Init(&status_title, (UI_Rect_t ) { 0, 4 * 10, ST7735_WIDTH, 18 }, &Font_11x18, SCREEN_TEXT_COLOR,
+			SCREEN_BACKGROUND_COLOR);
+	UI_Label_Init(&status_text, (UI_Rect_t ) { 0, 8 * 10, ST7735_WIDTH, 10 }, &Font_7x10, SCREEN_TEXT_COLOR,
+			SCREEN_BACKGROUND_COLOR);
+	UI_Widget_Add(&status.widget, &status_title.widget);
+	UI_Widget_Add(&status.widget, &status_text.widget);
+	UI_Menu_Init(&menu, (UI_Rect_t ) { 0, 3 * 10 - 6, ST7735_WIDTH, 3 * SCREEN_MENU_ROW_HEIGHT }, &Font_11x18,
+			SCREEN_TEXT_COLOR, SCREEN_BACKGROUND_COLOR, SCREEN_DISABLED_COLOR, SCREEN_MENU_ROW_HEIGHT);
+	UI_Widget_Add(&body.widget, &status.widget);
+	UI_Widget_Add(&body.widget, &menu.widget);
+
+	UI_Widget_Add(&root.widget, &header.widget);
+	UI_Widget_Add(&root.widget, &body.widget);
+
+	body_mode = SCREEN_BODY_CANVAS;
+	Screen_Set_Body(SCREEN_BODY_STATUS);
+	Screen_Set_Title("INIT");
+	Screen_Update();
 }
 
-void Screen_Header_Draw(const char *title, uint8_t battery) {
-	ST7735_FillRectangle(0, 0, ST7735_WIDTH, SCREEN_HEADER_HEIGHT, SCREEN_HEADER_COLOR);
-	ST7735_WriteString(ST7735_CENTERED, (SCREEN_HEADER_HEIGHT-7)/2, title, Font_7x10, ST7735_BLACK, SCREEN_HEADER_COLOR);
-	if (battery > 0) {
-		char battery_str[6];
-		snprintf(battery_str, 6, "%02u%%", battery);
-		ST7735_WriteString(130, (SCREEN_HEADER_HEIGHT-7)/2, battery_str, Font_7x10, ST7735_BLACK, SCREEN_HEADER_COLOR);
+void Screen_Update(void) {
+	if (Transition_Is_Running() && !Transition_Step()) {
+		body_clean = true;
 	}
+	UI_Paint(&root.widget);
 }
 
-void Screen_Background_Draw(void) {
-	ST7735_FillRectangle(0, SCREEN_HEADER_HEIGHT, ST7735_WIDTH, ST7735_HEIGHT - SCREEN_HEADER_HEIGHT,
-			SCREEN_BACKGROUND_COLOR);
+void Screen_Set_Title(const char *text) {
+	UI_Label_Set_Text(&title, text);
+}
+
+void Screen_Set_Battery(uint8_t battery) {
+	UI_Battery_Set_Level(&battery_level, battery);
+}
+
+void Screen_Show_Status(const char *title, const char *text) {
+	Screen_Set_Body(SCREEN_BODY_STATUS);
+	UI_Label_Set_Text(&status_title, title);
+	UI_Label_Set_Text(&status_text, text);
+}
+
+void Screen_Show_Menu(const UI_Menu_Item_t *items, uint8_t count) {
+	Screen_Set_Body(SCREEN_BODY_MENU);
+	UI_Menu_Set_Items(&menu, items, count);
+}
+
+void Screen_Menu_Select(uint8_t selected) {
+	UI_Menu_Set_Selected(&menu, selected);
+}
+
+bool Screen_Menu_Move(int8_t step) {
+	return UI_Menu_Move(&menu, step);
 }
 
-void Screen_Status_Draw(const char *title, const char *text) {
-	static const char *drawed_string = NULL;
-	if (drawed_string == NULL || strcmp(title, drawed_string) != 0) {
-		Screen_Background_Draw();
-		Screen_Header_Draw("INIT", 0);
-		ST7735_WriteString(ST7735_CENTERED, 4 * 10, title, Font_11x18, SCREEN_TEXT_COLOR, SCREEN_BACKGROUND_COLOR);
-		ST7735_WriteString(ST7735_CENTERED, 8 * 10, text, Font_7x10, SCREEN_TEXT_COLOR, SCREEN_BACKGROUND_COLOR);
-		drawed_string = title;
+const UI_Menu_Item_t* Screen_Menu_Get_Selected(void) {
+	return UI_Menu_Get_Selected(&menu);
+}
+
+void Screen_Show_Canvas(void) {
+	if (body_mode == SCREEN_BODY_CANVAS && body_clean) {
+		body_clean = false;
+		return;
 	}
+	Screen_Set_Body(SCREEN_BODY_CANVAS);
+	UI_Widget_Invalidate(&body.widget);
+	// Stages draw directly on the display right after, the body must be cleared now
+	Screen_Update();
+}
+
+/*
+ * Clear the body progressively over the next frames instead of in one blocking burst.
+ * The next Screen_Show_* call then starts from a clean body.
+ */
+void Screen_Transition_Start(Transition_Type_t type) {
+	Screen_Set_Body(SCREEN_BODY_CANVAS);
+	UI_Widget_Validate(&body.widget);
+	body_clean = false;
+	Transition_Start(type, body.widget.bounds, SCREEN_BACKGROUND_COLOR, TRANSITION_DURATION_MS);
+}
+
+void Screen_Set_Hud(bool visible) {
+	UI_Widget_Set_Visible(&title.widget, !visible);
+	UI_Widget_Set_Visible(Hud_Get_Widget(), visible);
+}
+
+bool Screen_Transition_Is_Running(void) {
+	return Transition_Is_Running();
 }
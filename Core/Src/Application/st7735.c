@@ -1,10 +1,12 @@
 #include "st7735.h"
 #include "malloc.h"
 #include "string.h"
+#include "latency.h"
+#include "profile.h"
 
 #define DELAY 0x80
 #define ST7735_SELECT() 	HAL_GPIO_WritePin(ST7735_CS_GPIO_Port, ST7735_CS_Pin, GPIO_PIN_RESET)
-#define ST7735_UNSELECT() 	HAL_GPIO_WritePin(ST7735_CS_GPIO_Port, ST7735_CS_Pin, GPIO_PIN_SET)
+#define ST7735_UNSELECT() 	do { HAL_GPIO_WritePin(ST7735_CS_GPIO_Port, ST7735_CS_Pin, GPIO_PIN_SET); Latency_Photon(); } while (0)
 
 extern SPI_HandleTypeDef ST7735_SPI_PORT;
 
@@ -13,6 +15,9 @@ const uint8_t colorModeInit = ST7735_COLMOD_16BIT;
 const uint8_t columnAddressInit[4] = {0x00, 0x00, /* XSTART */ 0x00, ST7735_WIDTH /* XEND */};
 const uint8_t rowAddressInit[4] = {0x00, 0x00, /* YSTART */ 0x00, ST7735_HEIGHT /* YEND */};
 
+// Bytes sent on the SPI bus since boot, wraps around
+static uint32_t transferred_bytes;
+
 static void ST7735_Reset() {
     HAL_GPIO_WritePin(ST7735_RES_GPIO_Port, ST7735_RES_Pin, GPIO_PIN_RESET);
     HAL_Delay(5);
@@ -22,11 +27,13 @@ static void ST7735_Reset() {
 static void ST7735_WriteCommand(uint8_t cmd) {
     HAL_GPIO_WritePin(ST7735_DC_GPIO_Port, ST7735_DC_Pin, GPIO_PIN_RESET);
     HAL_SPI_Transmit(&ST7735_SPI_PORT, &cmd, sizeof(cmd), HAL_MAX_DELAY);
+    transferred_bytes += sizeof(cmd);
 }
 
 static void ST7735_WriteData(uint8_t* buff, size_t buff_size) {
     HAL_GPIO_WritePin(ST7735_DC_GPIO_Port, ST7735_DC_Pin, GPIO_PIN_SET);
     HAL_SPI_Transmit(&ST7735_SPI_PORT, buff, buff_size, HAL_MAX_DELAY);
+    transferred_bytes += buff_size;
 }
 
 static void ST7735_ExecuteCommand(uint8_t cmd, const uint8_t *args,  size_t numArgs) {
@@ -72,6 +79,7 @@ void ST7735_DrawPixel(uint16_t x, uint16_t y, uint16_t color) {
     if((x >= ST7735_WIDTH) || (y >= ST7735_HEIGHT))
         return;
 
+    PROFILE_BEGIN(LCD_PIXEL);
     ST7735_SELECT();
 
     ST7735_SetAddressWindow(x, y, x+1, y+1);
@@ -79,6 +87,7 @@ void ST7735_DrawPixel(uint16_t x, uint16_t y, uint16_t color) {
     ST7735_WriteData(data, sizeof(data));
 
     ST7735_UNSELECT();
+    PROFILE_END(LCD_PIXEL);
 }
 
 static void ST7735_WriteChar(uint16_t x, uint16_t y, char ch, FontDef font, uint16_t color, uint16_t bgcolor) {
@@ -102,6 +111,7 @@ static void ST7735_WriteChar(uint16_t x, uint16_t y, char ch, FontDef font, uint
 
 void ST7735_WriteString(uint16_t x, uint16_t y, const char* str, FontDef font, uint16_t color, uint16_t bgcolor) {
 	size_t str_len = strlen(str);
+	PROFILE_BEGIN(LCD_STRING);
 
 	ST7735_SELECT();
 
@@ -133,6 +143,7 @@ void ST7735_WriteString(uint16_t x, uint16_t y, const char* str, FontDef font, u
     }
 
     ST7735_UNSELECT();
+    PROFILE_END(LCD_STRING);
 }
 
 void ST7735_FillRectangle(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color)
@@ -144,6 +155,7 @@ void ST7735_FillRectangle(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16
 	if((x + w - 1) >= ST7735_WIDTH) w = ST7735_WIDTH - x;
 	if((y + h - 1) >= ST7735_HEIGHT) h = ST7735_HEIGHT - y;
 
+	PROFILE_BEGIN(LCD_FILL);
 	ST7735_SELECT();
 	ST7735_SetAddressWindow(x, y, x+w-1, y+h-1);
 
@@ -153,8 +165,10 @@ void ST7735_FillRectangle(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16
 	HAL_GPIO_WritePin(ST7735_DC_GPIO_Port, ST7735_DC_Pin, GPIO_PIN_SET);
 	for(y = h; y > 0; y--)
 		HAL_SPI_Transmit(&ST7735_SPI_PORT, (uint8_t*) line, w * sizeof(pixel), HAL_MAX_DELAY);
+	transferred_bytes += (uint32_t) w * h * sizeof(pixel);
 
 	ST7735_UNSELECT();
+	PROFILE_END(LCD_FILL);
 }
 
 void ST7735_FillScreen(uint16_t color) {
@@ -174,10 +188,12 @@ void ST7735_DrawImage(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint
     if((x + w - 1) >= ST7735_WIDTH) return;
     if((y + h - 1) >= ST7735_HEIGHT) return;
 
+    PROFILE_BEGIN(LCD_IMAGE);
     ST7735_SELECT();
     ST7735_SetAddressWindow(x, y, x+w-1, y+h-1);
     ST7735_WriteData((uint8_t*)data, sizeof(uint16_t)*w*h);
     ST7735_UNSELECT();
+    PROFILE_END(LCD_IMAGE);
 }
 
 void ST7735_InvertColors(bool invert) {
@@ -193,5 +209,6 @@ void ST7735_SetGamma(GammaDef gamma)
 	ST7735_UNSELECT();
 }
 
-
-
+uint32_t ST7735_GetTransferredBytes(void) {
+	return transferred_bytes;
+}
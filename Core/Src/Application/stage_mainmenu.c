@@ -2,114 +2,58 @@
 #include "screen.h"
 #include "hid_host_app.h"
 #include "st7735.h"
-
-#define STAGE_TITLE "MENU"
-
-typedef enum {
-	STATE_IDLE = 0, STATE_UP_PRESSED, STATE_DOWN_PRESSED, STATE_ENTER_PRESSED,
-} mainmenu_state_t;
-
-typedef enum {
-	MAINMENU_SNAKE = 0, MAINMENU_TEST, MAINMENU_EXIT, MAINMENU_MAX,
-} mainmenu_item_t;
-
-static mainmenu_item_t selected = MAINMENU_SNAKE;
-static mainmenu_state_t state = STATE_IDLE;
-
-static void Screen_MainMenu_Select(mainmenu_item_t selection) {
-	switch (selection) {
-	case MAINMENU_SNAKE:
-		ST7735_WriteString(ST7735_CENTERED, 3 * 10, "PLAY", Font_11x18, SCREEN_BACKGROUND_COLOR, SCREEN_TEXT_COLOR);
-		ST7735_WriteString(ST7735_CENTERED, 6 * 10, "TEST", Font_11x18, SCREEN_TEXT_COLOR, SCREEN_BACKGROUND_COLOR);
-		ST7735_WriteString(ST7735_CENTERED, 9 * 10, "RESET", Font_11x18, SCREEN_TEXT_COLOR, SCREEN_BACKGROUND_COLOR);
-		break;
-
-	case MAINMENU_TEST:
-		ST7735_WriteString(ST7735_CENTERED, 3 * 10, "PLAY", Font_11x18, SCREEN_TEXT_COLOR, SCREEN_BACKGROUND_COLOR);
-		ST7735_WriteString(ST7735_CENTERED, 6 * 10, "TEST", Font_11x18, SCREEN_BACKGROUND_COLOR, SCREEN_TEXT_COLOR);
-		ST7735_WriteString(ST7735_CENTERED, 9 * 10, "RESET", Font_11x18, SCREEN_TEXT_COLOR, SCREEN_BACKGROUND_COLOR);
-		break;
-
-	case MAINMENU_EXIT:
-		ST7735_WriteString(ST7735_CENTERED, 3 * 10, "PLAY", Font_11x18, SCREEN_TEXT_COLOR, SCREEN_BACKGROUND_COLOR);
-		ST7735_WriteString(ST7735_CENTERED, 6 * 10, "TEST", Font_11x18, SCREEN_TEXT_COLOR, SCREEN_BACKGROUND_COLOR);
-		ST7735_WriteString(ST7735_CENTERED, 9 * 10, "RESET", Font_11x18, SCREEN_BACKGROUND_COLOR, SCREEN_TEXT_COLOR);
-		break;
-
-	default:
-		ST7735_WriteString(ST7735_CENTERED, 3 * 10, "PLAY", Font_11x18, SCREEN_TEXT_COLOR, SCREEN_BACKGROUND_COLOR);
-		ST7735_WriteString(ST7735_CENTERED, 6 * 10, "TEST", Font_11x18, SCREEN_TEXT_COLOR, SCREEN_BACKGROUND_COLOR);
-		ST7735_WriteString(ST7735_CENTERED, 9 * 10, "RESET", Font_11x18, SCREEN_TEXT_COLOR, SCREEN_BACKGROUND_COLOR);
-		break;
-	}
+#include "buzzer.h"
+#include "stage.h"
+#include "input.h"
+
+// New games plug in by adding an entry here
+static const UI_Menu_Item_t mainmenu_items[] = {
+	{ "PLAY", STAGE_SNAKE, true },
+	{ "TEST", STAGE_TEST, true },
+	{ "RESET", STAGE_RESET, true },
+};
+
+#define MAINMENU_COUNT (sizeof(mainmenu_items) / sizeof(mainmenu_items[0]))
+
+#define MAINMENU_UP_KEYS (INPUT_MASK(INPUT_KEY_UP) | INPUT_MASK(INPUT_KEY_LSTICK_UP))
+#define MAINMENU_DOWN_KEYS (INPUT_MASK(INPUT_KEY_DOWN) | INPUT_MASK(INPUT_KEY_LSTICK_DOWN))
+
+static void Stage_MainMenu_Enter(void *scratch) {
+	Input_Set_Repeat(MAINMENU_UP_KEYS | MAINMENU_DOWN_KEYS, INPUT_REPEAT_DELAY_MS, INPUT_REPEAT_PERIOD_MS);
+	Screen_Show_Menu(mainmenu_items, MAINMENU_COUNT);
+	Screen_Menu_Select(0);
 }
 
-void Stage_MainMenu_Enter_Handle(HID_Report_t *report, uint8_t battery) {
-	selected = MAINMENU_SNAKE;
-	state = STATE_IDLE;
-	Screen_Background_Draw();
-	Screen_Header_Draw(STAGE_TITLE, battery);
-	Screen_MainMenu_Select(selected);
-	App_Set_Stage(STAGE_MAINMENU);
-}
+static void Stage_MainMenu_Update(HID_Report_t *report, uint8_t battery) {
+	const UI_Menu_Item_t *item;
+	Input_Event_t event;
 
-void Stage_MainMenu_Handle(HID_Report_t *report, uint8_t battery) {
+	while (Input_Get_Event(&event)) {
+		if (event.type == INPUT_RELEASE) {
+			continue;
+		}
 
-	switch (state) {
-	case STATE_IDLE:
-		if (report->BTN_A) {
-			state = STATE_ENTER_PRESSED;
-		} else if (report->HAT_Switch == HATSWITCH_DOWN) {
+		if (INPUT_MASK(event.key) & MAINMENU_UP_KEYS) {
 			Buzzer_Play_Menu_Move();
-			if (selected < MAINMENU_MAX - 1) {
-				selected++;
-				Screen_MainMenu_Select(selected);
-			}
-			state = STATE_DOWN_PRESSED;
-		} else if (report->HAT_Switch == HATSWITCH_UP) {
+			Screen_Menu_Move(-1);
+		} else if (INPUT_MASK(event.key) & MAINMENU_DOWN_KEYS) {
 			Buzzer_Play_Menu_Move();
-			if (selected > 0) {
-				selected--;
-				Screen_MainMenu_Select(selected);
+			Screen_Menu_Move(1);
+		} else if (event.key == INPUT_KEY_A && event.type == INPUT_PRESS) {
+			item = Screen_Menu_Get_Selected();
+			if (item != NULL && item->enabled) {
+				App_Set_Stage((App_Stage_t) item->action);
+				return;
 			}
-			state = STATE_UP_PRESSED;
-		}
-		break;
-
-	case STATE_UP_PRESSED:
-		if (report->HAT_Switch != HATSWITCH_UP) {
-			state = STATE_IDLE;
 		}
-		break;
-
-	case STATE_DOWN_PRESSED:
-		if (report->HAT_Switch != HATSWITCH_DOWN) {
-			state = STATE_IDLE;
-		}
-		break;
-
-	case STATE_ENTER_PRESSED:
-		state = STATE_IDLE;
-		App_Set_Stage(STAGE_MAINMENU_EXIT);
-		break;
 	}
 }
 
-void Stage_MainMenu_Exit_Handle(HID_Report_t *report, uint8_t battery) {
-	switch (selected) {
-	case MAINMENU_SNAKE:
-		App_Set_Stage(STAGE_SNAKE_ENTER);
-		break;
-
-	case MAINMENU_TEST:
-		App_Set_Stage(STAGE_TEST_ENTER);
-		break;
-
-	case MAINMENU_EXIT:
-		App_Set_Stage(STAGE_RESET);
-		break;
-
-	default:
-		break;
-	}
-}
+const Stage_Desc_t Stage_MainMenu = {
+	.name = "MENU",
+	.render = STAGE_RENDER_UI,
+	.transition = TRANSITION_BLINDS,
+	.frame_rate = 30,
+	.enter = Stage_MainMenu_Enter,
+	.update = Stage_MainMenu_Update,
+};
@@ -4,10 +4,14 @@
 #include "st7735.h"
 #include "icons.h"
 #include "buzzer.h"
-
-#define STAGE_TITLE "SNAKE"
+#include "stage.h"
+#include "frame.h"
+#include "input.h"
+#include "hid_output.h"
 
 #define BASE_TICK_TIME 150
+#define SNAKE_FRAME_RATE 60
+#define SNAKE_MOVE_UPDATES (BASE_TICK_TIME * SNAKE_FRAME_RATE / 1000)
 
 #define SCREEN_BORDER_SIZE 4
 #define SCREEN_CELL_SIZE 5
@@ -28,6 +32,9 @@
 #define DIR_LEFT DIRS[2]
 #define DIR_RIGHT DIRS[3]
 
+static const HID_Rumble_t RUMBLE_FOOD = { .weak = 40, .duration_ms = 80 };
+static const HID_Rumble_t RUMBLE_GAME_OVER = { .strong = 80, .weak = 40, .duration_ms = 400 };
+
 typedef enum cell {
 	CELL_SNAKE_MIN = 0, CELL_SNAKE_MAX = GRID_WIDTH * GRID_HEIGHT, CELL_FOOD, CELL_EMPTY
 } cell_t;
@@ -37,25 +44,32 @@ typedef struct coord {
 	uint8_t y;
 } coord_t;
 
+typedef struct {
+	cell_t grid[GRID_HEIGHT][GRID_WIDTH];
+	bool round_running;
+	uint32_t tick_count;
+	coord_t head;
+	coord_t tail;
+	uint32_t body_length;
+	uint8_t move_updates;
+} snake_scratch_t;
+
+_Static_assert(sizeof(snake_scratch_t) <= STAGE_ARENA_SIZE, "Snake state does not fit in the stage arena");
+
 static const coord_t DIRS[4] = { { 0, -1 }, { 0, 1 }, { -1, 0 }, { 1, 0 } };
-static cell_t grid[GRID_HEIGHT][GRID_WIDTH];
-static bool round_running;
-static uint32_t tick_count;
-static coord_t head;
-static coord_t tail;
-static uint32_t body_length;
+static snake_scratch_t *snake;
 
 static cell_t get_cell(coord_t *coord) {
-	return grid[coord->y][coord->x];
+	return snake->grid[coord->y][coord->x];
 }
 
 static void set_cell(coord_t *coord, cell_t value) {
-	grid[coord->y][coord->x] = value;
+	snake->grid[coord->y][coord->x] = value;
 }
 
 static coord_t spawn_food(void) {
 	coord_t spawn_candidate = { GRID_WIDTH / 2 + 2, GRID_HEIGHT / 2 };
-	if (body_length < GRID_WIDTH * GRID_HEIGHT) {
+	if (snake->body_length < GRID_WIDTH * GRID_HEIGHT) {
 		do {
 			spawn_candidate = (coord_t ) { rand() % GRID_WIDTH, rand() % GRID_HEIGHT };
 		} while (get_cell(&spawn_candidate) != CELL_EMPTY);
@@ -79,6 +93,11 @@ static bool is_body_collided(coord_t *new_head) {
 static coord_t get_direction(HID_Report_t *report) {
 	static const coord_t *cur_dir = &DIR_RIGHT;
 	const coord_t* new_dir = cur_dir;
+	Input_Analog_t analog;
+
+	if (!(App_Get_Changes() & (HID_CHANGE_BUTTONS | HID_CHANGE_STICKS))) {
+		return *cur_dir;
+	}
 
 	// Handle HAT switch
 	switch (report->HAT_Switch) {
@@ -107,15 +126,19 @@ static coord_t get_direction(HID_Report_t *report) {
 		new_dir = &DIR_UP;
 	}
 
-	// Also handles both joysticks
-	if (report->JOY_LeftAxisY < 0x007F || report->JOY_RightAxisY < 0x007F) {
-		new_dir = &DIR_UP;
-	} else if (report->JOY_LeftAxisY > 0xCFFF || report->JOY_RightAxisY > 0xCFFF) {
-		new_dir = &DIR_DOWN;
-	} else if (report->JOY_LeftAxisX < 0x007F || report->JOY_RightAxisX < 0x007F) {
-		new_dir = &DIR_LEFT;
-	} else if (report->JOY_LeftAxisX > 0xCFFF || report->JOY_RightAxisX > 0xCFFF) {
-		new_dir = &DIR_RIGHT;
+	// Also handles both joysticks, diagonals keep the direction
+	if (Input_Get_Analog(App_Get_Player(), &analog)) {
+		uint8_t stick_dir = analog.left.direction ? analog.left.direction : analog.right.direction;
+
+		if (stick_dir == INPUT_DIR_UP) {
+			new_dir = &DIR_UP;
+		} else if (stick_dir == INPUT_DIR_DOWN) {
+			new_dir = &DIR_DOWN;
+		} else if (stick_dir == INPUT_DIR_LEFT) {
+			new_dir = &DIR_LEFT;
+		} else if (stick_dir == INPUT_DIR_RIGHT) {
+			new_dir = &DIR_RIGHT;
+		}
 	}
 
 	// Prevent going to opposite direction
@@ -129,42 +152,43 @@ static coord_t get_direction(HID_Report_t *report) {
 }
 
 static void move_snake(coord_t *new_head) {
-	uint32_t old_tail_id = get_cell(&tail);
+	uint32_t old_tail_id = get_cell(&snake->tail);
 
 	// If food is not eaten, tail is removed
 	if (get_cell(new_head) != CELL_FOOD) {
-		set_cell(&tail, CELL_EMPTY);
-		ST7735_FillRectangle(GRID_OFFSET_X(tail.x), GRID_OFFSET_Y(tail.y), SCREEN_CELL_SIZE, SCREEN_CELL_SIZE,
+		set_cell(&snake->tail, CELL_EMPTY);
+		ST7735_FillRectangle(GRID_OFFSET_X(snake->tail.x), GRID_OFFSET_Y(snake->tail.y), SCREEN_CELL_SIZE, SCREEN_CELL_SIZE,
 		ST7735_BLACK);
-		if (body_length == 1) {
-			tail = *new_head;
+		if (snake->body_length == 1) {
+			snake->tail = *new_head;
 		} else {
 			// Find new tail based on tick count marker
 			for (int i = 0; i < 4; i++) {
-				coord_t new_tail = { tail.x + DIRS[i].x, tail.y + DIRS[i].y };
+				coord_t new_tail = { snake->tail.x + DIRS[i].x, snake->tail.y + DIRS[i].y };
 				if (new_tail.x < 0 || new_tail.x >= GRID_WIDTH || new_tail.y < 0 || new_tail.y >= GRID_HEIGHT) {
 					// Out of bound
 					continue;
 				}
 				if (get_cell(&new_tail) == ((old_tail_id + 1))) {
 					// New tail found
-					tail = new_tail;
+					snake->tail = new_tail;
 					break;
 				}
 			}
 		}
 	} else {
 		Buzzer_Play_Snake_Food();
-		body_length++;
+		HID_Output_Rumble(App_Get_Player(), &RUMBLE_FOOD);
+		snake->body_length++;
 		coord_t food = spawn_food();
 		ST7735_FillRectangle(GRID_OFFSET_X(food.x), GRID_OFFSET_Y(food.y), SCREEN_CELL_SIZE, SCREEN_CELL_SIZE,
 		ST7735_GREEN);
 	}
 
 	// Update head to new cell
-	head = *new_head;
-	set_cell(&head, tick_count++);
-	ST7735_FillRectangle(GRID_OFFSET_X(head.x), GRID_OFFSET_Y(head.y), SCREEN_CELL_SIZE, SCREEN_CELL_SIZE,
+	snake->head = *new_head;
+	set_cell(&snake->head, snake->tick_count++);
+	ST7735_FillRectangle(GRID_OFFSET_X(snake->head.x), GRID_OFFSET_Y(snake->head.y), SCREEN_CELL_SIZE, SCREEN_CELL_SIZE,
 	ST7735_WHITE);
 }
 
@@ -193,17 +217,17 @@ static void start_round(void) {
 	// Initialize empty grid
 	for (int i = 0; i < GRID_WIDTH; i++)
 		for (int j = 0; j < GRID_HEIGHT; j++)
-			grid[j][i] = CELL_EMPTY;
+			snake->grid[j][i] = CELL_EMPTY;
 
-	body_length = 1;
-	tick_count = 0;
-	round_running = true;
+	snake->body_length = 1;
+	snake->tick_count = 0;
+	snake->round_running = true;
 
 	// Set snake in the middle
-	head.x = GRID_WIDTH / 2;
-	head.y = GRID_HEIGHT / 2;
-	set_cell(&head, CELL_SNAKE_MIN);
-	tail = head;
+	snake->head.x = GRID_WIDTH / 2;
+	snake->head.y = GRID_HEIGHT / 2;
+	set_cell(&snake->head, CELL_SNAKE_MIN);
+	snake->tail = snake->head;
 
 	spawn_food();
 	update_screen();
@@ -212,18 +236,18 @@ static void start_round(void) {
 static void end_round(void) {
 	char score[20];
 	Buzzer_Play_Game_Over();
-	snprintf(score, 20, "Score : %lu", body_length);
+	HID_Output_Rumble(App_Get_Player(), &RUMBLE_GAME_OVER);
+	snprintf(score, 20, "Score : %lu", snake->body_length);
 	ST7735_WriteString(ST7735_CENTERED, (ST7735_HEIGHT - 7) / 2 - 10, "GAME OVER", Font_11x18, ST7735_WHITE,
 	ST7735_RED);
 	ST7735_WriteString(ST7735_CENTERED, (ST7735_HEIGHT - 7) / 2 + 10, score, Font_7x10, ST7735_WHITE, ST7735_RED);
 	ST7735_WriteString(ST7735_CENTERED, (ST7735_HEIGHT - 7) / 2 + 30, "Press B to restart", Font_7x10, ST7735_WHITE,
 	ST7735_BLACK);
-	round_running = false;
+	snake->round_running = false;
 }
 
-void Stage_Snake_Enter_Handle(HID_Report_t *report, uint8_t battery) {
-	Screen_Header_Draw(STAGE_TITLE, battery);
-	Screen_Background_Draw();
+static void Stage_Snake_Enter(void *scratch) {
+	snake = scratch;
 	ST7735_FillRectangle((ST7735_WIDTH - (SCREEN_WIDTH + SCREEN_BORDER_SIZE)) / 2,
 			((ST7735_HEIGHT + SCREEN_HEADER_HEIGHT) - (SCREEN_HEIGHT + SCREEN_BORDER_SIZE)) / 2,
 			SCREEN_WIDTH + SCREEN_BORDER_SIZE, SCREEN_HEIGHT + SCREEN_BORDER_SIZE, ST7735_WHITE);
@@ -231,27 +255,32 @@ void Stage_Snake_Enter_Handle(HID_Report_t *report, uint8_t battery) {
 	SCREEN_WIDTH, SCREEN_HEIGHT, ST7735_BLACK);
 	ST7735_WriteString(ST7735_CENTERED, (ST7735_HEIGHT + SCREEN_HEADER_HEIGHT) / 2, "Press B to start", Font_7x10, ST7735_WHITE,
 	ST7735_BLACK);
-	App_Set_Stage(STAGE_SNAKE);
 }
 
-void Stage_Snake_Handle(HID_Report_t *report, uint8_t battery) {
-	if (report->BTN_B && !round_running) {
-		start_round();
-	}
+static void Stage_Snake_Update(HID_Report_t *report, uint8_t battery) {
+	Input_Event_t event;
 
-	if (report->BTN_Xbox) {
-		round_running = false;
-		App_Set_Stage(STAGE_SNAKE_EXIT);
+	while (Input_Get_Event(&event)) {
+		if (event.type != INPUT_PRESS) {
+			continue;
+		}
+		if (event.key == INPUT_KEY_B && !snake->round_running) {
+			start_round();
+		} else if (event.key == INPUT_KEY_XBOX) {
+			snake->round_running = false;
+			App_Set_Stage(STAGE_MAINMENU);
+			return;
+		}
 	}
 
-	if (round_running) {
-		static long long last_tick = 0;
-		long long cur_tick = HAL_GetTick();
+	if (snake->round_running) {
 		coord_t dir = get_direction(report);
 
-		if (cur_tick - last_tick > BASE_TICK_TIME) {
-			last_tick = cur_tick;
-			coord_t new_head = { head.x + dir.x, head.y + dir.y };
+		Frame_Request();
+		// Updates run at a fixed rate, the snake speed is counted in updates
+		if (++snake->move_updates >= SNAKE_MOVE_UPDATES) {
+			snake->move_updates = 0;
+			coord_t new_head = { snake->head.x + dir.x, snake->head.y + dir.y };
 			// Check for collision
 			if (is_wall_collided(&new_head) || is_body_collided(&new_head)) {
 				end_round();
@@ -262,7 +291,23 @@ void Stage_Snake_Handle(HID_Report_t *report, uint8_t battery) {
 	}
 }
 
-void Stage_Snake_Exit_Handle(HID_Report_t *report, uint8_t battery) {
+static void Stage_Snake_Exit(void) {
 	Buzzer_Play_Menu_Back();
-	App_Set_Stage(STAGE_MAINMENU_ENTER);
 }
+
+static void Stage_Snake_Suspend(void) {
+	snake->round_running = false;
+}
+
+const Stage_Desc_t Stage_Snake = {
+	.name = "SNAKE",
+	.render = STAGE_RENDER_CANVAS,
+	.transition = TRANSITION_WIPE_DOWN,
+	.low_latency = true,
+	.frame_rate = SNAKE_FRAME_RATE,
+	.scratch_size = sizeof(snake_scratch_t),
+	.enter = Stage_Snake_Enter,
+	.update = Stage_Snake_Update,
+	.exit = Stage_Snake_Exit,
+	.suspend = Stage_Snake_Suspend,
+};
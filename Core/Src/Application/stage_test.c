@@ -1,44 +1,100 @@
+#include <string.h>
 #include "app.h"
 #include "screen.h"
 #include "hid_host_app.h"
 #include "st7735.h"
 #include "icons.h"
 #include "buzzer.h"
+#include "stage.h"
+#include "input.h"
+#include "hid_output.h"
+#include "frame.h"
+#include "main.h"
 
-#define STAGE_TITLE "TEST"
+#define TEST_BUTTON_KEYS (INPUT_MASK(INPUT_KEY_A) | INPUT_MASK(INPUT_KEY_B) | INPUT_MASK(INPUT_KEY_X) | INPUT_MASK(INPUT_KEY_Y))
+// Sent again at half its duration while a trigger is held
+#define TEST_RUMBLE_MS 200
 
-static HID_Report_t report_old;
+static HID_Rumble_t test_rumble;
+static uint32_t test_rumble_tick;
 
-void Stage_Test_Enter_Handle(HID_Report_t *report, uint8_t battery) {
-	Screen_Header_Draw(STAGE_TITLE, battery);
-	Screen_Background_Draw();
+static void Stage_Test_Enter(void *scratch) {
 	ST7735_FillRectangle(ST7735_WIDTH / 2 - 40, ST7735_HEIGHT / 2 - 40, 80, 80, ST7735_WHITE);
 	ST7735_FillRectangle(ST7735_WIDTH / 2 - 38, ST7735_HEIGHT / 2 - 38, 76, 76, ST7735_BLACK);
 	ST7735_WriteString(ST7735_CENTERED, ST7735_HEIGHT - 15, "Press X/Y/A/B to test", Font_7x10, SCREEN_TEXT_COLOR,
 	SCREEN_BACKGROUND_COLOR);
-	App_Set_Stage(STAGE_TEST);
+	memset(&test_rumble, 0, sizeof(test_rumble));
 }
 
-void Stage_Test_Handle(HID_Report_t *report, uint8_t battery) {
-	if (memcmp(report, &report_old, sizeof(HID_Report_t)) != 0) {
-		if (report->BTN_A) {
-			ST7735_DrawImage(ST7735_WIDTH / 2 - 32, ST7735_HEIGHT / 2 - 32, 64, 64, xbox_button_a);
-		} else if (report->BTN_B) {
-			ST7735_DrawImage(ST7735_WIDTH / 2 - 32, ST7735_HEIGHT / 2 - 32, 64, 64, xbox_button_b);
-		} else if (report->BTN_X) {
-			ST7735_DrawImage(ST7735_WIDTH / 2 - 32, ST7735_HEIGHT / 2 - 32, 64, 64, xbox_button_x);
-		} else if (report->BTN_Y) {
-			ST7735_DrawImage(ST7735_WIDTH / 2 - 32, ST7735_HEIGHT / 2 - 32, 64, 64, xbox_button_y);
-		} else if (report->BTN_Xbox) {
-			App_Set_Stage(STAGE_TEST_EXIT);
-		} else {
+/*
+ * Each trigger drives its own motor, a command is queued when a value changes or the last one runs out.
+ */
+static void Stage_Test_Rumble(const HID_Report_t *report) {
+	uint8_t left = report->TRG_Left * 100 / 1023;
+	uint8_t right = report->TRG_Right * 100 / 1023;
+	uint32_t tick = HAL_GetTick();
+
+	if (left || right) {
+		// The controller only reports changes, keep updating to renew the rumble
+		Frame_Request();
+	} else if (!(App_Get_Changes() & HID_CHANGE_TRIGGERS)) {
+		return;
+	}
+	if (left == test_rumble.left_trigger && right == test_rumble.right_trigger
+			&& (!test_rumble.duration_ms || tick - test_rumble_tick < TEST_RUMBLE_MS / 2)) {
+		return;
+	}
+	test_rumble.left_trigger = left;
+	test_rumble.right_trigger = right;
+	test_rumble.duration_ms = (left || right) ? TEST_RUMBLE_MS : 0;
+	test_rumble_tick = tick;
+	HID_Output_Rumble(App_Get_Player(), &test_rumble);
+}
+
+static void Stage_Test_Update(HID_Report_t *report, uint8_t battery) {
+	Input_Event_t event;
+
+	Stage_Test_Rumble(report);
+	while (Input_Get_Event(&event)) {
+		if (event.type == INPUT_PRESS) {
+			switch (event.key) {
+			case INPUT_KEY_A:
+				ST7735_DrawImage(ST7735_WIDTH / 2 - 32, ST7735_HEIGHT / 2 - 32, 64, 64, xbox_button_a);
+				break;
+			case INPUT_KEY_B:
+				ST7735_DrawImage(ST7735_WIDTH / 2 - 32, ST7735_HEIGHT / 2 - 32, 64, 64, xbox_button_b);
+				break;
+			case INPUT_KEY_X:
+				ST7735_DrawImage(ST7735_WIDTH / 2 - 32, ST7735_HEIGHT / 2 - 32, 64, 64, xbox_button_x);
+				break;
+			case INPUT_KEY_Y:
+				ST7735_DrawImage(ST7735_WIDTH / 2 - 32, ST7735_HEIGHT / 2 - 32, 64, 64, xbox_button_y);
+				break;
+			case INPUT_KEY_XBOX:
+				App_Set_Stage(STAGE_MAINMENU);
+				return;
+			default:
+				break;
+			}
+		} else if (event.type == INPUT_RELEASE && (INPUT_MASK(event.key) & TEST_BUTTON_KEYS)
+				&& !(Input_Get_Held() & TEST_BUTTON_KEYS)) {
 			ST7735_FillRectangle(ST7735_WIDTH / 2 - 38, ST7735_HEIGHT / 2 - 38, 76, 76, ST7735_BLACK);
 		}
-		memcpy(&report_old, report, sizeof(HID_Report_t));
 	}
 }
 
-void Stage_Test_Exit_Handle(HID_Report_t *report, uint8_t battery) {
+static void Stage_Test_Exit(void) {
+	HID_Output_Stop(App_Get_Player());
 	Buzzer_Play_Menu_Back();
-	App_Set_Stage(STAGE_MAINMENU_ENTER);
 }
+
+const Stage_Desc_t Stage_Test = {
+	.name = "TEST",
+	.render = STAGE_RENDER_CANVAS,
+	.transition = TRANSITION_WIPE_DOWN,
+	.low_latency = true,
+	.frame_rate = 30,
+	.enter = Stage_Test_Enter,
+	.update = Stage_Test_Update,
+	.exit = Stage_Test_Exit,
+};
@@ -0,0 +1,121 @@
+#include <string.h>
+#include "trace.h"
+#include "main.h"
+#include "app_common.h"
+#include "stm32_seq.h"
+#include "dbg_out.h"
+#include "latency.h"
+#include "utilities_conf.h"
+#include "profile.h"
+
+typedef struct {
+	Trace_Record_t ring[TRACE_RING_SIZE];
+	// Reserved by the writers, head - tail records are in use
+	volatile uint32_t head;
+	volatile uint32_t tail;
+	volatile uint32_t dropped;
+} trace_t;
+
+_Static_assert((TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)) == 0, "Trace ring size must be a power of two");
+_Static_assert(sizeof(Trace_Record_t) == 8 + 4 * TRACE_ARGS, "Trace records must not be padded");
+
+static trace_t trace;
+
+static void Trace_Task(void);
+static void Trace_Add_Dropped(uint32_t count);
+
+void Trace_Init(void) {
+	memset(&trace, 0, sizeof(trace));
+#if (CFG_TRACE_ENABLED != 0) && (CFG_DEBUG_TRACE == 0)
+	// Without the text traces nobody else starts the UART
+	MX_USART1_UART_Init();
+#endif
+	Dbg_Out_Init();
+	UTIL_SEQ_RegTask(1 << CFG_TASK_TRACE_ID, UTIL_SEQ_RFU, Trace_Task);
+}
+
+/*
+ * Lock-free, callable from interrupts. A slot is reserved by an exclusive increment of head
+ * and committed by writing its sync byte last, the drain stops at the first uncommitted slot.
+ */
+void Trace_Write(Trace_Id_t id, uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3) {
+	Trace_Record_t *record;
+	uint32_t head;
+
+	do {
+		head = __LDREXW((volatile uint32_t*) &trace.head);
+		if (head - trace.tail >= TRACE_RING_SIZE) {
+			__CLREX();
+			Trace_Add_Dropped(1);
+			return;
+		}
+	} while (__STREXW(head + 1, (volatile uint32_t*) &trace.head));
+
+	record = &trace.ring[head & (TRACE_RING_SIZE - 1)];
+	record->id = id;
+	record->seq = (uint16_t) head;
+	record->stamp = Latency_Now();
+	record->args[0] = arg0;
+	record->args[1] = arg1;
+	record->args[2] = arg2;
+	record->args[3] = arg3;
+	__DMB();
+	record->sync = TRACE_SYNC;
+	UTIL_SEQ_SetTask(1 << CFG_TASK_TRACE_ID, CFG_SCH_PRIO_0);
+}
+
+static void Trace_Add_Dropped(uint32_t count) {
+	uint32_t dropped;
+
+	do {
+		dropped = __LDREXW((volatile uint32_t*) &trace.dropped);
+	} while (__STREXW(dropped + count, (volatile uint32_t*) &trace.dropped));
+}
+
+/* Committed records from the tail, contiguous in the ring */
+static uint16_t Trace_Committed(void) {
+	uint32_t tail = trace.tail;
+	uint16_t count = 0;
+
+	while (tail + count != trace.head && count < TRACE_RING_SIZE - (tail & (TRACE_RING_SIZE - 1))
+			&& trace.ring[(tail + count) & (TRACE_RING_SIZE - 1)].sync == TRACE_SYNC) {
+		count++;
+	}
+	return count;
+}
+
+static void Trace_Release(uint16_t count) {
+	for (uint16_t i = 0; i < count; i++) {
+		trace.ring[(trace.tail + i) & (TRACE_RING_SIZE - 1)].sync = 0;
+	}
+	__DMB();
+	trace.tail += count;
+}
+
+/*
+ * Runs at low priority, out of the event handlers. The records are copied into the
+ * dbg_out buffers along with the text traces, so the slots are freed at once.
+ * Records the output has no room for are counted as dropped, as if the ring was full.
+ */
+static void Trace_Task(void) {
+	uint32_t dropped;
+	uint16_t count;
+	PROFILE_BEGIN(TASK_TRACE);
+
+	dropped = trace.dropped;
+	if (dropped && trace.head - trace.tail < TRACE_RING_SIZE) {
+		UTILS_ENTER_CRITICAL_SECTION();
+		trace.dropped -= dropped;
+		UTILS_EXIT_CRITICAL_SECTION();
+		Trace_Write(TRACE_DROPPED, dropped, 0, 0, 0);
+	}
+	while ((count = Trace_Committed()) != 0) {
+		// Lost records show as a sequence gap in the capture
+		if (!Dbg_Out_Write((const uint8_t*) &trace.ring[trace.tail & (TRACE_RING_SIZE - 1)],
+				count * sizeof(Trace_Record_t))) {
+			Trace_Add_Dropped(count);
+		}
+		Trace_Release(count);
+	}
+	PROFILE_END(TASK_TRACE);
+}
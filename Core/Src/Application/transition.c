@@ -0,0 +1,163 @@
+#include "transition.h"
+#include "st7735.h"
+#include "main.h"
+
+#define EASING_STEPS 16
+#define EASING_ONE (1UL << 15)
+
+#define BLINDS_BAND_HEIGHT 8
+
+#define TRANSITION_BUDGET_PIXELS ((TRANSITION_FRAME_BUDGET_US * TRANSITION_SPI_BYTES_PER_US) / sizeof(uint16_t))
+
+// A step paints at least one full line, which must fit the budget
+_Static_assert(ST7735_WIDTH <= TRANSITION_BUDGET_PIXELS, "A screen line exceeds the transition budget");
+
+typedef struct {
+	Transition_Type_t type;
+	UI_Rect_t area;
+	uint16_t color;
+	uint32_t start;
+	uint16_t duration;
+	const uint16_t *easing;
+	uint16_t done;
+	uint16_t total;
+	uint16_t unit_pixels;
+} transition_t;
+
+// Q15 smoothstep (3t^2 - 2t^3), sampled on EASING_STEPS segments
+static const uint16_t ease_in_out[EASING_STEPS + 1] = { 0, 368, 1408, 3024, 5120, 7600, 10368, 13328, 16384, 19440,
+		22400, 25168, 27648, 29744, 31360, 32400, 32768 };
+
+// Q15 cubic ease out (1 - (1 - t)^3)
+static const uint16_t ease_out[EASING_STEPS + 1] = { 0, 5768, 10816, 15192, 18944, 22120, 24768, 26936, 28672, 30024,
+		31040, 31768, 32256, 32552, 32704, 32760, 32768 };
+
+static transition_t transition;
+
+static uint32_t Transition_Ease(const uint16_t *table, uint32_t elapsed, uint32_t duration) {
+	uint32_t pos = elapsed * EASING_STEPS;
+	uint32_t index = pos / duration;
+	uint32_t frac = pos % duration;
+
+	if (index >= EASING_STEPS) {
+		return EASING_ONE;
+	}
+	return table[index] + ((table[index + 1] - table[index]) * frac) / duration;
+}
+
+static void Transition_Paint(uint16_t from, uint16_t to) {
+	UI_Rect_t *area = &transition.area;
+
+	switch (transition.type) {
+	case TRANSITION_WIPE_DOWN:
+		ST7735_FillRectangle(area->x, area->y + from, area->w, to - from, transition.color);
+		break;
+
+	case TRANSITION_WIPE_RIGHT:
+		ST7735_FillRectangle(area->x + from, area->y, to - from, area->h, transition.color);
+		break;
+
+	case TRANSITION_BLINDS: {
+		// Grow every band at once, which reads as a fade on such a small screen.
+		// A unit is one line of one band, so a frame may stop in the middle of a row of lines.
+		uint16_t bands = DIVC(area->h, BLINDS_BAND_HEIGHT);
+
+		for (uint16_t unit = from; unit < to; unit++) {
+			uint16_t y = (unit % bands) * BLINDS_BAND_HEIGHT + unit / bands;
+
+			if (y < area->h) {
+				ST7735_FillRectangle(area->x, area->y + y, area->w, 1, transition.color);
+			}
+		}
+	}
+		break;
+
+	default:
+		break;
+	}
+}
+
+/*
+ * Spread the repaint of an area over the next frames, following an easing curve.
+ * Each call to Transition_Step only paints what the frame budget allows.
+ */
+void Transition_Start(Transition_Type_t type, UI_Rect_t area, uint16_t color, uint16_t duration_ms) {
+	transition.type = type;
+	transition.area = area;
+	transition.color = color;
+	transition.start = HAL_GetTick();
+	transition.duration = (duration_ms > 0) ? duration_ms : 1;
+	transition.done = 0;
+
+	switch (type) {
+	case TRANSITION_WIPE_DOWN:
+		transition.total = area.h;
+		transition.unit_pixels = area.w;
+		transition.easing = ease_in_out;
+		break;
+
+	case TRANSITION_WIPE_RIGHT:
+		transition.total = area.w;
+		transition.unit_pixels = area.h;
+		transition.easing = ease_in_out;
+		break;
+
+	case TRANSITION_BLINDS:
+		transition.total = BLINDS_BAND_HEIGHT * DIVC(area.h, BLINDS_BAND_HEIGHT);
+		transition.unit_pixels = area.w;
+		transition.easing = ease_out;
+		break;
+
+	default:
+		transition.type = TRANSITION_NONE;
+		break;
+	}
+
+	if (transition.total == 0 || transition.unit_pixels == 0) {
+		transition.type = TRANSITION_NONE;
+	}
+}
+
+/*
+ * Paint the next part of the running transition.
+ * Return false once the whole area has been painted.
+ */
+bool Transition_Step(void) {
+	uint32_t elapsed, target, max_units;
+
+	if (transition.type == TRANSITION_NONE) {
+		return false;
+	}
+
+	elapsed = HAL_GetTick() - transition.start;
+	if (elapsed >= transition.duration) {
+		target = transition.total;
+	} else {
+		target = (transition.total * Transition_Ease(transition.easing, elapsed, transition.duration)) >> 15;
+	}
+
+	// Stay within the frame budget, the transition lags behind the curve rather than stalling the loop
+	max_units = MAX(TRANSITION_BUDGET_PIXELS / transition.unit_pixels, 1);
+	if (target > transition.done + max_units) {
+		target = transition.done + max_units;
+	}
+
+	if (target > transition.done) {
+		Transition_Paint(transition.done, target);
+		transition.done = target;
+	}
+
+	if (transition.done >= transition.total) {
+		transition.type = TRANSITION_NONE;
+		return false;
+	}
+	return true;
+}
+
+void Transition_Stop(void) {
+	transition.type = TRANSITION_NONE;
+}
+
+bool Transition_Is_Running(void) {
+	return transition.type != TRANSITION_NONE;
+}
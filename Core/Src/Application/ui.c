@@ -0,0 +1,353 @@
+#include "ui.h"
+#include "st7735.h"
+#include <stdio.h>
+#include <string.h>
+
+static void UI_Fill(uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint16_t color) {
+	if (w > 0 && h > 0) {
+		ST7735_FillRectangle(x, y, w, h, color);
+	}
+}
+
+/*
+ * Compute where a text centered in the given area lands, truncated to what fits in it.
+ */
+static UI_Rect_t UI_Text_Layout(const UI_Rect_t *area, const char *str, const FontDef *font, size_t *len) {
+	UI_Rect_t text;
+	size_t max_len = area->w / font->width;
+
+	*len = strlen(str);
+	if (*len > max_len) {
+		*len = max_len;
+	}
+	if (*len > UI_LABEL_TEXT_SIZE - 1) {
+		*len = UI_LABEL_TEXT_SIZE - 1;
+	}
+
+	text.w = *len * font->width;
+	text.h = (font->height < area->h) ? font->height : area->h;
+	text.x = area->x + (area->w - text.w) / 2;
+	text.y = area->y + (area->h - text.h) / 2;
+	return text;
+}
+
+/*
+ * Fill only the pixels of the area not covered by the glyphs, so a repaint never clears the whole area first.
+ */
+static void UI_Fill_Around(const UI_Rect_t *area, const UI_Rect_t *text, uint16_t color) {
+	UI_Fill(area->x, area->y, area->w, text->y - area->y, color);
+	UI_Fill(area->x, text->y + text->h, area->w, (area->y + area->h) - (text->y + text->h), color);
+	UI_Fill(area->x, text->y, text->x - area->x, text->h, color);
+	UI_Fill(text->x + text->w, text->y, (area->x + area->w) - (text->x + text->w), text->h, color);
+}
+
+static void UI_Draw_Glyphs(const UI_Rect_t *text, const char *str, size_t len, const FontDef *font, uint16_t color,
+		uint16_t bgcolor) {
+	char buf[UI_LABEL_TEXT_SIZE];
+
+	if (len > 0) {
+		memcpy(buf, str, len);
+		buf[len] = '\0';
+		ST7735_WriteString(text->x, text->y, buf, *font, color, bgcolor);
+	}
+}
+
+static void UI_Draw_Text(const UI_Rect_t *area, const char *str, const FontDef *font, uint16_t color,
+		uint16_t bgcolor) {
+	size_t len;
+	UI_Rect_t text = UI_Text_Layout(area, str, font, &len);
+
+	UI_Fill_Around(area, &text, bgcolor);
+	UI_Draw_Glyphs(&text, str, len, font, color, bgcolor);
+}
+
+static void UI_Panel_Paint(UI_Widget_t *widget, bool full) {
+	UI_Panel_t *panel = (UI_Panel_t*) widget;
+	UI_Fill(widget->bounds.x, widget->bounds.y, widget->bounds.w, widget->bounds.h, panel->color);
+}
+
+static void UI_Label_Paint(UI_Widget_t *widget, bool full) {
+	UI_Label_t *label = (UI_Label_t*) widget;
+	UI_Draw_Text(&widget->bounds, label->text, label->font, label->color, label->bgcolor);
+}
+
+static void UI_Battery_Paint(UI_Widget_t *widget, bool full) {
+	UI_Battery_t *battery = (UI_Battery_t*) widget;
+	char battery_str[6] = { 0 };
+
+	if (battery->level > 0) {
+		snprintf(battery_str, sizeof(battery_str), "%02u%%", battery->level);
+	}
+	UI_Draw_Text(&widget->bounds, battery_str, battery->font, battery->color, battery->bgcolor);
+}
+
+/*
+ * Only the glyph cells of a row are highlighted, so a selection change repaints the glyphs of the
+ * two affected rows and nothing around them.
+ */
+static void UI_Menu_Paint_Row(UI_Menu_t *menu, uint8_t row, bool full) {
+	const UI_Menu_Item_t *item = &menu->items[menu->first + row];
+	UI_Rect_t area = { menu->widget.bounds.x, menu->widget.bounds.y + row * menu->row_height, menu->widget.bounds.w,
+			menu->row_height };
+	uint16_t color = item->enabled ? menu->color : menu->disabled_color;
+	size_t len;
+	UI_Rect_t text = UI_Text_Layout(&area, item->label, menu->font, &len);
+
+	if (full) {
+		UI_Fill_Around(&area, &text, menu->bgcolor);
+	}
+	if (menu->first + row == menu->selected) {
+		UI_Draw_Glyphs(&text, item->label, len, menu->font, menu->bgcolor, color);
+	} else {
+		UI_Draw_Glyphs(&text, item->label, len, menu->font, color, menu->bgcolor);
+	}
+}
+
+static void UI_Menu_Paint(UI_Widget_t *widget, bool full) {
+	UI_Menu_t *menu = (UI_Menu_t*) widget;
+	uint8_t shown = menu->count - menu->first;
+
+	if (shown > menu->rows) {
+		shown = menu->rows;
+	}
+
+	for (uint8_t row = 0; row < shown; row++) {
+		if (full || (menu->dirty_rows & (1UL << row))) {
+			UI_Menu_Paint_Row(menu, row, full);
+		}
+	}
+
+	if (full) {
+		uint8_t y = widget->bounds.y + shown * menu->row_height;
+		UI_Fill(widget->bounds.x, y, widget->bounds.w, (widget->bounds.y + widget->bounds.h) - y, menu->bgcolor);
+	}
+	menu->dirty_rows = 0;
+}
+
+void UI_Widget_Init(UI_Widget_t *widget, UI_Rect_t bounds, void (*paint)(UI_Widget_t *widget, bool full)) {
+	memset(widget, 0, sizeof(UI_Widget_t));
+	widget->bounds = bounds;
+	widget->paint = paint;
+	widget->flags = UI_FLAG_VISIBLE | UI_FLAG_DIRTY;
+}
+
+static void UI_Paint_Widget(UI_Widget_t *widget, bool force) {
+	if (!(widget->flags & UI_FLAG_VISIBLE)) {
+		widget->flags &= ~(UI_FLAG_DIRTY | UI_FLAG_CHILD_DIRTY | UI_FLAG_PARTIAL);
+		return;
+	}
+
+	// A repainted widget covers its children, they must be painted again on top of it
+	if (force || (widget->flags & UI_FLAG_DIRTY)) {
+		bool full = force || !(widget->flags & UI_FLAG_PARTIAL);
+		widget->paint(widget, full);
+		force = full;
+	}
+
+	if (force || (widget->flags & UI_FLAG_CHILD_DIRTY)) {
+		for (UI_Widget_t *child = widget->child; child != NULL; child = child->next) {
+			UI_Paint_Widget(child, force);
+		}
+	}
+
+	widget->flags &= ~(UI_FLAG_DIRTY | UI_FLAG_CHILD_DIRTY | UI_FLAG_PARTIAL);
+}
+
+static void UI_Widget_Mark_Parents(UI_Widget_t *widget) {
+	for (UI_Widget_t *parent = widget->parent; parent != NULL; parent = parent->parent) {
+		if (parent->flags & UI_FLAG_CHILD_DIRTY) {
+			break;
+		}
+		parent->flags |= UI_FLAG_CHILD_DIRTY;
+	}
+}
+
+void UI_Widget_Add(UI_Widget_t *parent, UI_Widget_t *child) {
+	UI_Widget_t **last = &parent->child;
+
+	while (*last != NULL) {
+		last = &(*last)->next;
+	}
+	*last = child;
+	child->parent = parent;
+	child->next = NULL;
+	UI_Widget_Invalidate(child);
+}
+
+void UI_Widget_Invalidate(UI_Widget_t *widget) {
+	widget->flags = (widget->flags & ~UI_FLAG_PARTIAL) | UI_FLAG_DIRTY;
+	UI_Widget_Mark_Parents(widget);
+}
+
+void UI_Widget_Invalidate_Partial(UI_Widget_t *widget) {
+	// A pending full repaint already covers the partial one
+	if (!(widget->flags & UI_FLAG_DIRTY)) {
+		widget->flags |= UI_FLAG_DIRTY | UI_FLAG_PARTIAL;
+	}
+	UI_Widget_Mark_Parents(widget);
+}
+
+/*
+ * Mark a widget as up to date when its area has been painted by other means.
+ */
+void UI_Widget_Validate(UI_Widget_t *widget) {
+	widget->flags &= ~(UI_FLAG_DIRTY | UI_FLAG_PARTIAL);
+}
+
+void UI_Widget_Set_Visible(UI_Widget_t *widget, bool visible) {
+	if (visible == UI_Widget_Is_Visible(widget)) {
+		return;
+	}
+
+	if (visible) {
+		widget->flags |= UI_FLAG_VISIBLE;
+		UI_Widget_Invalidate(widget);
+	} else {
+		// The parent has to cover the area left by the hidden widget
+		widget->flags &= ~UI_FLAG_VISIBLE;
+		if (widget->parent != NULL) {
+			UI_Widget_Invalidate(widget->parent);
+		}
+	}
+}
+
+bool UI_Widget_Is_Visible(UI_Widget_t *widget) {
+	return (widget->flags & UI_FLAG_VISIBLE) != 0;
+}
+
+void UI_Panel_Init(UI_Panel_t *panel, UI_Rect_t bounds, uint16_t color) {
+	UI_Widget_Init(&panel->widget, bounds, UI_Panel_Paint);
+	panel->color = color;
+}
+
+void UI_Label_Init(UI_Label_t *label, UI_Rect_t bounds, const FontDef *font, uint16_t color, uint16_t bgcolor) {
+	UI_Widget_Init(&label->widget, bounds, UI_Label_Paint);
+	label->font = font;
+	label->color = color;
+	label->bgcolor = bgcolor;
+	label->text[0] = '\0';
+}
+
+void UI_Label_Set_Text(UI_Label_t *label, const char *text) {
+	if (strncmp(label->text, text, UI_LABEL_TEXT_SIZE - 1) == 0) {
+		return;
+	}
+	strncpy(label->text, text, UI_LABEL_TEXT_SIZE - 1);
+	label->text[UI_LABEL_TEXT_SIZE - 1] = '\0';
+	UI_Widget_Invalidate(&label->widget);
+}
+
+void UI_Battery_Init(UI_Battery_t *battery, UI_Rect_t bounds, const FontDef *font, uint16_t color, uint16_t bgcolor) {
+	UI_Widget_Init(&battery->widget, bounds, UI_Battery_Paint);
+	battery->font = font;
+	battery->color = color;
+	battery->bgcolor = bgcolor;
+	battery->level = 0;
+}
+
+void UI_Battery_Set_Level(UI_Battery_t *battery, uint8_t level) {
+	if (battery->level != level) {
+		battery->level = level;
+		UI_Widget_Invalidate(&battery->widget);
+	}
+}
+
+void UI_Menu_Init(UI_Menu_t *menu, UI_Rect_t bounds, const FontDef *font, uint16_t color, uint16_t bgcolor,
+		uint16_t disabled_color, uint8_t row_height) {
+	UI_Widget_Init(&menu->widget, bounds, UI_Menu_Paint);
+	menu->font = font;
+	menu->color = color;
+	menu->bgcolor = bgcolor;
+	menu->disabled_color = disabled_color;
+	menu->row_height = row_height;
+	menu->rows = bounds.h / row_height;
+	if (menu->rows > 32) {
+		menu->rows = 32;
+	}
+	menu->items = NULL;
+	menu->count = 0;
+	menu->selected = 0;
+	menu->first = 0;
+	menu->dirty_rows = 0;
+}
+
+/* First enabled item from index on, count if there is none */
+static uint8_t UI_Menu_Next_Enabled(UI_Menu_t *menu, uint8_t index) {
+	while (index < menu->count && !menu->items[index].enabled) {
+		index++;
+	}
+	return index;
+}
+
+void UI_Menu_Set_Items(UI_Menu_t *menu, const UI_Menu_Item_t *items, uint8_t count) {
+	if (menu->items != items || menu->count != count) {
+		menu->items = items;
+		menu->count = count;
+		menu->selected = UI_Menu_Next_Enabled(menu, 0);
+		if (menu->selected >= count) {
+			menu->selected = 0;
+		}
+		menu->first = (menu->selected >= menu->rows) ? menu->selected - menu->rows + 1 : 0;
+		UI_Widget_Invalidate(&menu->widget);
+	}
+}
+
+/*
+ * Select an item, or the first enabled one after it if it is disabled.
+ */
+void UI_Menu_Set_Selected(UI_Menu_t *menu, uint8_t selected) {
+	selected = UI_Menu_Next_Enabled(menu, selected);
+	if (selected >= menu->count || selected == menu->selected) {
+		return;
+	}
+
+	if (selected < menu->first) {
+		// Scroll up, every visible row changes
+		menu->first = selected;
+		UI_Widget_Invalidate(&menu->widget);
+	} else if (selected >= menu->first + menu->rows) {
+		// Scroll down
+		menu->first = selected - menu->rows + 1;
+		UI_Widget_Invalidate(&menu->widget);
+	} else {
+		menu->dirty_rows |= (1UL << (menu->selected - menu->first)) | (1UL << (selected - menu->first));
+		UI_Widget_Invalidate_Partial(&menu->widget);
+	}
+	menu->selected = selected;
+}
+
+/*
+ * Move the selection by step items, skipping disabled ones.
+ * Return false if no enabled item exists in that direction.
+ */
+bool UI_Menu_Move(UI_Menu_t *menu, int8_t step) {
+	int16_t index = menu->selected;
+
+	if (step == 0) {
+		return false;
+	}
+
+	do {
+		index += (step > 0) ? 1 : -1;
+		if (index < 0 || index >= menu->count) {
+			return false;
+		}
+		if (menu->items[index].enabled) {
+			step += (step > 0) ? -1 : 1;
+		}
+	} while (step != 0);
+
+	UI_Menu_Set_Selected(menu, index);
+	return true;
+}
+
+const UI_Menu_Item_t* UI_Menu_Get_Selected(UI_Menu_t *menu) {
+	if (menu->selected >= menu->count) {
+		return NULL;
+	}
+	return &menu->items[menu->selected];
+}
+
+void UI_Paint(UI_Widget_t *root) {
+	UI_Paint_Widget(root, false);
+}
@@ -27,6 +27,7 @@
 #include "shci.h"
 #include "tl.h"
 #include "dbg_trace.h"
+#include "dbg_out.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -393,6 +394,7 @@ else if (CFG_DEBUG_TRACE_UART == hw_uart1)
 #endif
 }
 #endif
+Dbg_Out_Init();
 
 /* USER CODE END DbgOutputInit */
   return;
@@ -401,7 +403,9 @@ else if (CFG_DEBUG_TRACE_UART == hw_uart1)
 void DbgOutputTraces(  uint8_t *p_data, uint16_t size, void (*cb)(void) )
 {
 /* USER CODE END DbgOutputTraces */
-  HW_UART_Transmit_DMA(CFG_DEBUG_TRACE_UART, p_data, size, cb);
+  /* Buffered, the DMA sends it later */
+  Dbg_Out_Write(p_data, size);
+  cb();
 
 /* USER CODE END DbgOutputTraces */
   return;
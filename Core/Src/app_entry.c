@@ -32,6 +32,8 @@
 #include "dbg_trace.h"
 #include "shci.h"
 #include "otp.h"
+#include "trace.h"
+#include "power.h"
 
 /* Private includes -----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
@@ -128,6 +130,7 @@ void MX_APPE_Init(void)
    */
 /* USER CODE BEGIN APPE_Init_2 */
 	APPD_Init();
+	Trace_Init();
 
 /* USER CODE END APPE_Init_2 */
 
@@ -557,7 +560,11 @@ void MX_APPE_Process(void)
 void UTIL_SEQ_Idle(void)
 {
 #if (CFG_LPM_SUPPORTED == 1)
-  UTIL_LPM_EnterLowPower();
+  Power_Idle();
+#else
+  /* Sleep until the next interrupt (frame timer, IPCC, SysTick), the tick keeps running */
+  LL_LPM_EnableSleep();
+  __WFI();
 #endif /* CFG_LPM_SUPPORTED == 1 */
   return;
 }
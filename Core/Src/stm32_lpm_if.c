@@ -23,7 +23,8 @@
 #include "stm32_lpm.h"
 #include "app_conf.h"
 /* USER CODE BEGIN include */
-
+#include "power.h"
+#include "clock.h"
 /* USER CODE END include */
 
 /* Exported variables --------------------------------------------------------*/
@@ -139,7 +140,9 @@ void PWR_ExitOffMode(void)
 void PWR_EnterStopMode(void)
 {
 /* USER CODE BEGIN PWR_EnterStopMode_1 */
-
+  /* The PLL stops in Stop2, the wake up restores the HSE with the default prescalers */
+  Clock_Set(CLOCK_HSE_32MHZ);
+  Power_Enter(POWER_STOP);
 /* USER CODE END PWR_EnterStopMode_1 */
   /**
    * When HAL_DBGMCU_EnableDBGStopMode() is called to keep the debugger active in Stop Mode,
@@ -196,7 +199,7 @@ void PWR_ExitStopMode(void)
 
   HAL_ResumeTick();
 /* USER CODE BEGIN PWR_ExitStopMode_2 */
-
+  Power_Exit();
 /* USER CODE END PWR_ExitStopMode_2 */
   return;
 }
@@ -210,11 +213,10 @@ void PWR_ExitStopMode(void)
 void PWR_EnterSleepMode(void)
 {
 /* USER CODE BEGIN PWR_EnterSleepMode_1 */
-
+  /* The tick keeps running in sleep so that HAL_GetTick stays exact, it wakes the core each ms */
+  Power_Enter(POWER_SLEEP);
 /* USER CODE END PWR_EnterSleepMode_1 */
 
-  HAL_SuspendTick();
-
   /************************************************************************************
    * ENTER SLEEP MODE
    ***********************************************************************************/
@@ -245,9 +247,8 @@ void PWR_ExitSleepMode(void)
 /* USER CODE BEGIN PWR_ExitSleepMode_1 */
 
 /* USER CODE END PWR_ExitSleepMode_1 */
-  HAL_ResumeTick();
 /* USER CODE BEGIN PWR_ExitSleepMode_2 */
-
+  Power_Exit();
 /* USER CODE END PWR_ExitSleepMode_2 */
   return;
 }
@@ -309,7 +310,12 @@ static void ExitLowPower(void)
   {
 /* Restore the clock configuration of the application in this user section */
 /* USER CODE BEGIN ExitLowPower_1 */
-
+    /* Back on the HSE at 32 MHz, as set by SystemClock_Config */
+    LL_RCC_HSE_Enable();
+    __HAL_FLASH_SET_LATENCY(FLASH_LATENCY_1);
+    while (!LL_RCC_HSE_IsReady());
+    LL_RCC_SetSysClkSource(LL_RCC_SYS_CLKSOURCE_HSE);
+    while (LL_RCC_GetSysClkSource() != LL_RCC_SYS_CLKSOURCE_STATUS_HSE);
 /* USER CODE END ExitLowPower_1 */
   }
   else
@@ -1,3 +1,4 @@
+#include <stdbool.h>
 #include "main.h"
 
 #include "app_common.h"
@@ -14,6 +15,8 @@
 #include "otp.h"
 
 #include "hid_host_app.h"
+#include "conn_policy.h"
+#include "profile.h"
 
 /**
  * security parameters structure
@@ -116,14 +119,43 @@ typedef struct _tBLEProfileGlobalContext {
 	uint8_t advtServUUID[100];
 } BleGlobalContext_t;
 
+/* One connected controller */
+typedef struct {
+	uint16_t ConnectionHandle;
+	APP_BLE_ConnStatus_t Status;
+	uint8_t PeerAddressType;
+	tBDAddr PeerAddress;
+	uint8_t ForceRebond;
+	uint32_t PhaseStart;
+	APP_BLE_Link_Times_t Times;
+} BleLink_t;
+
 typedef struct {
 	BleGlobalContext_t BleApplicationContext_legacy;
-	APP_BLE_ConnStatus_t Device_Connection_Status;
+	BleLink_t Links[CFG_BLE_NUM_LINK];
+	// Only one GAP procedure runs at a time, a free link is searched once the others are paired
+	uint8_t Scanning;
+	uint8_t Connecting;
 	uint8_t SwitchOffGPIO_timer_Id;
 	uint8_t DeviceServerFound;
+	uint8_t Reconnect_timer_Id;
+	// Auto connection to the bonded controllers running, and whether it timed out
+	uint8_t Reconnecting;
+	volatile uint8_t ReconnectTimeout;
+	// Next scan is a general discovery, to pair an unknown controller
+	uint8_t SkipReconnect;
+	// Search for the next controller, before it has a link: start of the current phase and scan duration
+	uint32_t PhaseStart;
+	uint32_t ScanMs;
+	// Wait before the next search while a controller is connected, longer after each empty discovery
+	uint8_t Backoff_timer_Id;
+	volatile uint8_t BackingOff;
+	uint32_t BackoffMs;
 } BleApplicationContext_t;
 
 #define APPBLE_GAP_DEVICE_NAME_LENGTH 8
+#define RECONNECT_TIMER_TICKS DIVR(RECONNECT_TIMEOUT_MS * 1000, CFG_TS_TICK_VAL)
+#define SCAN_BACKOFF_TICKS(ms) DIVR((ms) * 1000, CFG_TS_TICK_VAL)
 #define BD_ADDR_SIZE_LOCAL    6
 
 PLACE_IN_SECTION("MB_MEM1") ALIGN(4) static TL_CmdPacket_t BleCmdBuffer;
@@ -163,6 +195,18 @@ static const uint8_t* BleGetBdAddress(void);
 static void Scan_Request(void);
 static void Connect_Request(void);
 static void Pairing_Request(void);
+static bool Reconnect_Request(void);
+static void Reconnect_Timeout(void);
+static void Backoff_Start(void);
+static void Backoff_Timeout(void);
+static void Backoff_Reset(void);
+static void Phase_End(BleLink_t *link, APP_BLE_Phase_t phase);
+static void Pairing_Done(BleLink_t *link);
+static BleLink_t* Link_Find(uint16_t handle);
+static void Hci_Event_Task(void);
+static BleLink_t* Link_Free(void);
+static uint8_t Link_Count(void);
+static bool Search_Needed(void);
 
 void APP_BLE_Init(void) {
 	SHCI_CmdStatus_t status;
@@ -208,7 +252,7 @@ void APP_BLE_Init(void) {
 	/**
 	 * Register the hci transport layer to handle BLE User Asynchronous Events
 	 */
-	UTIL_SEQ_RegTask(1 << CFG_TASK_HCI_ASYNCH_EVT_ID, UTIL_SEQ_RFU, hci_user_evt_proc);
+	UTIL_SEQ_RegTask(1 << CFG_TASK_HCI_ASYNCH_EVT_ID, UTIL_SEQ_RFU, Hci_Event_Task);
 
 	/**
 	 * Starts the BLE Stack on CPU2
@@ -233,6 +277,7 @@ void APP_BLE_Init(void) {
 	SVCCTL_Init();
 
 	HID_Host_Init();
+	Conn_Policy_Init();
 
 	/**
 	 * From here, all initialization are BLE application specific
@@ -244,7 +289,11 @@ void APP_BLE_Init(void) {
 	/**
 	 * Initialization of the BLE App Context
 	 */
-	BleApplicationContext.Device_Connection_Status = APP_BLE_IDLE;
+	memset(BleApplicationContext.Links, 0, sizeof(BleApplicationContext.Links));
+	BleApplicationContext.PhaseStart = HAL_GetTick();
+	HW_TS_Create(CFG_TIM_PROC_ID_ISR, &BleApplicationContext.Reconnect_timer_Id, hw_ts_SingleShot, Reconnect_Timeout);
+	HW_TS_Create(CFG_TIM_PROC_ID_ISR, &BleApplicationContext.Backoff_timer_Id, hw_ts_SingleShot, Backoff_Timeout);
+	BleApplicationContext.BackoffMs = SCAN_BACKOFF_MIN_MS;
 
 	/**
 	 * Start scanning
@@ -265,6 +314,7 @@ SVCCTL_UserEvtFlowStatus_t SVCCTL_App_Notification(void *pckt) {
 	uint8_t event_type, event_data_size;
 	int k;
 	uint8_t adtype, adlength;
+	uint32_t now;
 
 	switch (event_pckt->evt) {
 	case HCI_VENDOR_SPECIFIC_DEBUG_EVT_CODE: {
@@ -274,34 +324,60 @@ SVCCTL_UserEvtFlowStatus_t SVCCTL_App_Notification(void *pckt) {
 		case ACI_GAP_PROC_COMPLETE_VSEVT_CODE: {
 			aci_gap_proc_complete_event_rp0 *gap_evt_proc_complete = (void*) blecore_evt->data;
 			/* CHECK GAP GENERAL DISCOVERY PROCEDURE COMPLETED & SUCCEED */
+			if (gap_evt_proc_complete->Procedure_Code == GAP_GENERAL_DISCOVERY_PROC) {
+				BleApplicationContext.Scanning = 0;
+			}
 			if (gap_evt_proc_complete->Procedure_Code == GAP_GENERAL_DISCOVERY_PROC
 					&& gap_evt_proc_complete->Status == 0x00) {
 				APP_DBG_MSG("-- GAP GENERAL DISCOVERY PROCEDURE_COMPLETED\n\r")
 
-				if (BleApplicationContext.DeviceServerFound == 0x01
-						&& BleApplicationContext.Device_Connection_Status != APP_BLE_CONNECTED) {
+				if (BleApplicationContext.DeviceServerFound == 0x01 && Search_Needed()) {
 					// if a device found, connect to it
 					UTIL_SEQ_SetTask(1 << CFG_TASK_CONN_DEV_ID, CFG_SCH_PRIO_0);
+				} else if (Link_Count() > 0) {
+					// Leave the radio to the connected controllers for a while
+					Backoff_Start();
 				} else {
 					// else restart new scan
 					UTIL_SEQ_SetTask(1 << CFG_TASK_START_SCAN_ID, CFG_SCH_PRIO_0);
 				}
 			}
+			/* AUTO CONNECTION TO THE BONDED CONTROLLERS STOPPED, WITHOUT CONNECTING IF TIMED OUT */
+			if (gap_evt_proc_complete->Procedure_Code == GAP_AUTO_CONNECTION_ESTABLISHMENT_PROC) {
+				BleApplicationContext.Reconnecting = 0;
+				if (BleApplicationContext.ReconnectTimeout || gap_evt_proc_complete->Status != 0x00) {
+					APP_DBG_MSG("-- GAP AUTO CONNECTION TIMED OUT, FALLING BACK TO DISCOVERY\n\r")
+					BleApplicationContext.ReconnectTimeout = 0;
+					BleApplicationContext.SkipReconnect = 1;
+					UTIL_SEQ_SetTask(1 << CFG_TASK_START_SCAN_ID, CFG_SCH_PRIO_0);
+				}
+			}
 		}
 			break;
 
 		case ACI_GAP_PAIRING_COMPLETE_VSEVT_CODE: {
-			p_pairing_complete = (aci_gap_pairing_complete_event_rp0*) event_pckt->data;
+			p_pairing_complete = (aci_gap_pairing_complete_event_rp0*) blecore_evt->data;
+			BleLink_t *link = Link_Find(p_pairing_complete->Connection_Handle);
 
 			APP_DBG_MSG(">>== ACI_GAP_PAIRING_COMPLETE_VSEVT_CODE\n")
+			if (!link) {
+				break;
+			}
 			if (p_pairing_complete->Status != 0) {
 				APP_DBG_MSG("     - Pairing KO \n     - Status: 0x%x\n     - Reason: 0x%x\n", p_pairing_complete->Status, p_pairing_complete->Reason)
+				// The controller lost the bond, pair again from scratch
+				if (!link->ForceRebond
+						&& aci_gap_is_device_bonded(link->PeerAddressType, link->PeerAddress) == BLE_STATUS_SUCCESS) {
+					aci_gap_remove_bonded_device(link->PeerAddressType, link->PeerAddress);
+					link->ForceRebond = 1;
+					link->Status = APP_BLE_CONNECTED;
+					UTIL_SEQ_SetTask(1 << CFG_TASK_PAIR_DEV_ID, CFG_SCH_PRIO_0);
+					break;
+				}
 			} else {
 				APP_DBG_MSG("     - Pairing Success\n")
 			}
-			handleNotification.HID_Evt_Opcode = PEER_PAIR_HANDLE_EVT;
-			handleNotification.ConnectionHandle = BleApplicationContext.BleApplicationContext_legacy.connectionHandle;
-			HID_Host_Notification(&handleNotification);
+			Pairing_Done(link);
 		}
 			break;
 
@@ -312,12 +388,17 @@ SVCCTL_UserEvtFlowStatus_t SVCCTL_App_Notification(void *pckt) {
 		break;
 
 	case HCI_DISCONNECTION_COMPLETE_EVT_CODE: {
-		if (cc->Connection_Handle == BleApplicationContext.BleApplicationContext_legacy.connectionHandle) {
-			BleApplicationContext.BleApplicationContext_legacy.connectionHandle = 0;
-			BleApplicationContext.Device_Connection_Status = APP_BLE_IDLE;
+		BleLink_t *link = Link_Find(cc->Connection_Handle);
+
+		if (link) {
+			memset(link, 0, sizeof(BleLink_t));
+			BleApplicationContext.PhaseStart = HAL_GetTick();
+			// A player is missing, search for it at once
+			Backoff_Reset();
+			Conn_Policy_Disconnected(cc->Connection_Handle);
 			APP_DBG_MSG("\r\n\r** DISCONNECTION EVENT WITH SERVER \n\r")
 			handleNotification.HID_Evt_Opcode = PEER_DISCON_HANDLE_EVT;
-			handleNotification.ConnectionHandle = BleApplicationContext.BleApplicationContext_legacy.connectionHandle;
+			handleNotification.ConnectionHandle = cc->Connection_Handle;
 			HID_Host_Notification(&handleNotification);
 			// Restart scan
 			UTIL_SEQ_SetTask(1 << CFG_TASK_START_SCAN_ID, CFG_SCH_PRIO_0);
@@ -325,6 +406,19 @@ SVCCTL_UserEvtFlowStatus_t SVCCTL_App_Notification(void *pckt) {
 	}
 		break; /* HCI_DISCONNECTION_COMPLETE_EVT_CODE */
 
+	case HCI_ENCRYPTION_CHANGE_EVT_CODE: {
+		hci_encryption_change_event_rp0 *ec = (void*) event_pckt->data;
+		BleLink_t *link = Link_Find(ec->Connection_Handle);
+
+		// A bonded controller is encrypted with the stored keys, no pairing complete may follow
+		if (link && ec->Status == 0x00 && ec->Encryption_Enabled
+				&& aci_gap_is_device_bonded(link->PeerAddressType, link->PeerAddress) == BLE_STATUS_SUCCESS) {
+			APP_DBG_MSG(">>== HCI_ENCRYPTION_CHANGE_EVT_CODE with bonded controller\n")
+			Pairing_Done(link);
+		}
+	}
+		break; /* HCI_ENCRYPTION_CHANGE_EVT_CODE */
+
 	case HCI_LE_META_EVT_CODE: {
 		meta_evt = (evt_le_meta_event*) event_pckt->data;
 
@@ -335,19 +429,68 @@ SVCCTL_UserEvtFlowStatus_t SVCCTL_App_Notification(void *pckt) {
 			 * The connection is done,
 			 */
 			connection_complete_event = (hci_le_connection_complete_event_rp0*) meta_evt->data;
-			BleApplicationContext.BleApplicationContext_legacy.connectionHandle =
-					connection_complete_event->Connection_Handle;
-			BleApplicationContext.Device_Connection_Status = APP_BLE_CONNECTED;
+			BleLink_t *link = Link_Free();
+
+			BleApplicationContext.Connecting = 0;
+			HW_TS_Stop(BleApplicationContext.Reconnect_timer_Id);
+			if (connection_complete_event->Status != 0x00 || !link) {
+				APP_DBG_MSG("-- CONNECTION FAILED, status: 0x%x\n\r", connection_complete_event->Status)
+				BleApplicationContext.Reconnecting = 0;
+				UTIL_SEQ_SetTask(1 << CFG_TASK_START_SCAN_ID, CFG_SCH_PRIO_0);
+				break;
+			}
+			link->ConnectionHandle = connection_complete_event->Connection_Handle;
+			link->Status = APP_BLE_CONNECTED;
+			link->PeerAddressType = connection_complete_event->Peer_Address_Type;
+			memcpy(link->PeerAddress, connection_complete_event->Peer_Address, sizeof(tBDAddr));
+			// The search phases move to the link, the search for the next controller starts from here
+			now = HAL_GetTick();
+			link->Times.Reconnect = BleApplicationContext.Reconnecting;
+			if (BleApplicationContext.Reconnecting) {
+				// The auto connection connects as soon as it sees the controller, there is no connect phase
+				link->Times.PhaseMs[APP_BLE_PHASE_SCAN] = now - BleApplicationContext.PhaseStart;
+				link->Times.PhaseMs[APP_BLE_PHASE_CONNECT] = 0;
+				BleApplicationContext.Reconnecting = 0;
+			} else {
+				link->Times.PhaseMs[APP_BLE_PHASE_SCAN] = BleApplicationContext.ScanMs;
+				link->Times.PhaseMs[APP_BLE_PHASE_CONNECT] = now - BleApplicationContext.PhaseStart;
+			}
+			link->PhaseStart = now;
+			BleApplicationContext.PhaseStart = now;
+			Backoff_Reset();
+			Conn_Policy_Connected(connection_complete_event->Connection_Handle, connection_complete_event->Conn_Interval,
+					connection_complete_event->Conn_Latency, connection_complete_event->Supervision_Timeout);
 
 			APP_DBG_MSG("\r\n\r**  CONNECTION COMPLETE EVENT\n\r")
 			handleNotification.HID_Evt_Opcode = PEER_CONN_HANDLE_EVT;
-			handleNotification.ConnectionHandle = BleApplicationContext.BleApplicationContext_legacy.connectionHandle;
+			handleNotification.ConnectionHandle = link->ConnectionHandle;
 			HID_Host_Notification(&handleNotification);
 			// Start pairing
 			UTIL_SEQ_SetTask(1 << CFG_TASK_PAIR_DEV_ID, CFG_SCH_PRIO_0);
 		}
 		break; /* HCI_LE_CONNECTION_COMPLETE_SUBEVT_CODE */
 
+		case HCI_LE_CONNECTION_UPDATE_COMPLETE_SUBEVT_CODE: {
+			hci_le_connection_update_complete_event_rp0 *cu = (void*) meta_evt->data;
+
+			Conn_Policy_Updated(cu->Connection_Handle, cu->Status, cu->Conn_Interval, cu->Conn_Latency, cu->Supervision_Timeout);
+		}
+			break; /* HCI_LE_CONNECTION_UPDATE_COMPLETE_SUBEVT_CODE */
+
+		case HCI_LE_PHY_UPDATE_COMPLETE_SUBEVT_CODE: {
+			hci_le_phy_update_complete_event_rp0 *pu = (void*) meta_evt->data;
+
+			Conn_Policy_Phy_Updated(pu->Connection_Handle, pu->Status, pu->TX_PHY, pu->RX_PHY);
+		}
+			break; /* HCI_LE_PHY_UPDATE_COMPLETE_SUBEVT_CODE */
+
+		case HCI_LE_DATA_LENGTH_CHANGE_SUBEVT_CODE: {
+			hci_le_data_length_change_event_rp0 *dl = (void*) meta_evt->data;
+
+			Conn_Policy_Data_Length_Changed(dl->Connection_Handle, dl->MaxTxOctets, dl->MaxRxOctets);
+		}
+			break; /* HCI_LE_DATA_LENGTH_CHANGE_SUBEVT_CODE */
+
 		case HCI_LE_ADVERTISING_REPORT_SUBEVT_CODE: {
 			uint8_t *adv_report_data;
 			le_advertising_event = (hci_le_advertising_report_event_rp0*) meta_evt->data;
@@ -373,7 +516,8 @@ SVCCTL_UserEvtFlowStatus_t SVCCTL_App_Notification(void *pckt) {
 						break;
 
 					case AD_TYPE_COMPLETE_LOCAL_NAME:
-						if (adlength == 25 && memcmp(&adv_report_data[k + 2], completeLocalName, 24) == 0) {
+						if (adlength == 25 && memcmp(&adv_report_data[k + 2], completeLocalName, 24) == 0
+								&& !BleApplicationContext.DeviceServerFound) {
 							APP_DBG_MSG("-- XBOX CONTROLLER DETECTED -- VIA COMPLETE LOCAL NAME\n\r")
 							BleApplicationContext.DeviceServerFound = 0x01;
 							SERVER_REMOTE_ADDR_TYPE = le_advertising_event->Advertising_Report[0].Address_Type;
@@ -386,6 +530,9 @@ SVCCTL_UserEvtFlowStatus_t SVCCTL_App_Notification(void *pckt) {
 
 							// Immediatly stop advertising since we found the device
 							aci_gap_terminate_gap_proc(GAP_GENERAL_DISCOVERY_PROC);
+							now = HAL_GetTick();
+							BleApplicationContext.ScanMs = now - BleApplicationContext.PhaseStart;
+							BleApplicationContext.PhaseStart = now;
 						}
 						break;
 
@@ -422,10 +569,26 @@ SVCCTL_UserEvtFlowStatus_t SVCCTL_App_Notification(void *pckt) {
 }
 
 APP_BLE_ConnStatus_t APP_BLE_Get_Client_Connection_Status(uint16_t Connection_Handle) {
-	if (BleApplicationContext.BleApplicationContext_legacy.connectionHandle == Connection_Handle) {
-		return BleApplicationContext.Device_Connection_Status;
+	BleLink_t *link = Link_Find(Connection_Handle);
+
+	return link ? link->Status : APP_BLE_IDLE;
+}
+
+/**
+ * @brief  Address of a connected controller
+ * @param  Connection_Handle: Handle of the connection
+ * @param  type: Filled with the address type
+ * @retval Address, 6 bytes, of the last controller found by the scan if the handle is unknown
+ */
+const uint8_t* APP_BLE_Get_Peer_Address(uint16_t Connection_Handle, uint8_t *type) {
+	BleLink_t *link = Link_Find(Connection_Handle);
+
+	if (!link) {
+		*type = SERVER_REMOTE_ADDR_TYPE;
+		return SERVER_REMOTE_BDADDR;
 	}
-	return APP_BLE_IDLE;
+	*type = link->PeerAddressType;
+	return link->PeerAddress;
 }
 
 /*************************************************************
@@ -638,9 +801,25 @@ static void Ble_Hci_Gap_Gatt_Init(void) {
 
 static void Scan_Request(void) {
 	tBleStatus result;
-	if (BleApplicationContext.Device_Connection_Status != APP_BLE_CONNECTED) {
-		result = aci_gap_start_general_discovery_proc(SCAN_P, SCAN_L, CFG_BLE_ADDRESS_TYPE, 1);
+	if (Search_Needed() && !BleApplicationContext.Scanning && !BleApplicationContext.Connecting
+			&& !BleApplicationContext.BackingOff) {
+		if (BleApplicationContext.Reconnecting) {
+			if (BleApplicationContext.ReconnectTimeout) {
+				// The procedure complete event starts the general discovery
+				aci_gap_terminate_gap_proc(GAP_AUTO_CONNECTION_ESTABLISHMENT_PROC);
+			}
+			return;
+		}
+		if (!BleApplicationContext.SkipReconnect && Reconnect_Request()) {
+			return;
+		}
+		BleApplicationContext.SkipReconnect = 0;
+		BleApplicationContext.DeviceServerFound = 0;
+		// Scanning next to a connected controller leaves it most of the radio time
+		result = aci_gap_start_general_discovery_proc(SCAN_P, (Link_Count() > 0) ? SCAN_L_CONNECTED : SCAN_L,
+				CFG_BLE_ADDRESS_TYPE, 1);
 		if (result == BLE_STATUS_SUCCESS) {
+			BleApplicationContext.Scanning = 1;
 			APP_DBG_MSG(" \r\n\r** START GENERAL DISCOVERY (SCAN) **  \r\n\r")
 		} else {
 			APP_DBG_MSG("-- BLE_App_Start_Limited_Disc_Req, Failed \r\n\r")
@@ -652,7 +831,7 @@ static void Scan_Request(void) {
 static void Connect_Request(void) {
 	tBleStatus result;
 
-	if (BleApplicationContext.Device_Connection_Status != APP_BLE_CONNECTED) {
+	if (Search_Needed() && !BleApplicationContext.Connecting) {
 		APP_DBG_MSG("\r\n\r** CREATE CONNECTION TO SERVER **  \r\n\r")
 		result = aci_gap_create_connection(SCAN_P,
 		SCAN_L, SERVER_REMOTE_ADDR_TYPE, SERVER_REMOTE_BDADDR,
@@ -664,29 +843,184 @@ static void Connect_Request(void) {
 		CONN_L2);
 
 		if (result == BLE_STATUS_SUCCESS) {
-			BleApplicationContext.Device_Connection_Status = APP_BLE_CONNECTING;
-
+			BleApplicationContext.Connecting = 1;
 		} else {
-			BleApplicationContext.Device_Connection_Status = APP_BLE_IDLE;
-
+			UTIL_SEQ_SetTask(1 << CFG_TASK_START_SCAN_ID, CFG_SCH_PRIO_0);
 		}
 	}
 	return;
 }
 
-static void Pairing_Request(void) {
+/**
+ * @brief  Connect to the first bonded controller that advertises, without discovery scan
+ * @param  None
+ * @retval True if the auto connection procedure started
+ */
+static bool Reconnect_Request(void) {
+	static Bonded_Device_Entry_t bonded[(BLE_EVT_MAX_PARAM_LEN - 3) / sizeof(Bonded_Device_Entry_t)];
+	Peer_Entry_t peers[RECONNECT_MAX_PEERS];
+	uint8_t count = 0, peer_count = 0;
 	tBleStatus result;
 
-	if (BleApplicationContext.Device_Connection_Status != APP_BLE_PAIRED) {
-		APP_DBG_MSG("\r\n\r** SENDING PAIRING REQUEST TO SERVER **  \r\n\r")
-		result = aci_gap_send_pairing_req(BleApplicationContext.BleApplicationContext_legacy.connectionHandle, 0x01);
+	if (aci_gap_get_bonded_devices(&count, bonded) != BLE_STATUS_SUCCESS || count == 0) {
+		return false;
+	}
+	for (uint8_t i = 0; i < count && peer_count < RECONNECT_MAX_PEERS; i++) {
+		bool connected = false;
 
-		if (result == BLE_STATUS_SUCCESS) {
-			BleApplicationContext.Device_Connection_Status = APP_BLE_PAIRING;
+		for (uint8_t l = 0; l < CFG_BLE_NUM_LINK; l++) {
+			const BleLink_t *link = &BleApplicationContext.Links[l];
 
-		} else {
-			BleApplicationContext.Device_Connection_Status = APP_BLE_IDLE;
+			connected |= link->Status != APP_BLE_IDLE && link->PeerAddressType == bonded[i].Address_Type
+					&& memcmp(link->PeerAddress, bonded[i].Address, sizeof(tBDAddr)) == 0;
+		}
+		if (!connected) {
+			peers[peer_count].Peer_Address_Type = bonded[i].Address_Type;
+			memcpy(peers[peer_count].Peer_Address, bonded[i].Address, sizeof(tBDAddr));
+			peer_count++;
+		}
+	}
+	if (peer_count == 0) {
+		return false;
+	}
+	count = peer_count;
+
+	result = aci_gap_start_auto_connection_establish_proc(SCAN_P, (Link_Count() > 0) ? SCAN_L_CONNECTED : SCAN_L, CFG_BLE_ADDRESS_TYPE, CONN_P1, CONN_P2, 0,
+			SUPERV_TIMEOUT, CONN_L1, CONN_L2, count, peers);
+	if (result != BLE_STATUS_SUCCESS) {
+		APP_DBG_MSG("-- Auto connection to %d bonded controllers failed, result: 0x%x\n\r", count, result)
+		return false;
+	}
+	APP_DBG_MSG(" \r\n\r** START AUTO CONNECTION TO %d BONDED CONTROLLERS **  \r\n\r", count)
+	BleApplicationContext.Reconnecting = 1;
+	BleApplicationContext.ReconnectTimeout = 0;
+	HW_TS_Start(BleApplicationContext.Reconnect_timer_Id, RECONNECT_TIMER_TICKS);
+	return true;
+}
 
+/* Timer server interrupt */
+static void Reconnect_Timeout(void) {
+	BleApplicationContext.ReconnectTimeout = 1;
+	UTIL_SEQ_SetTask(1 << CFG_TASK_START_SCAN_ID, CFG_SCH_PRIO_0);
+}
+
+static void Backoff_Start(void) {
+	APP_DBG_MSG("-- NO CONTROLLER FOUND, NEXT SCAN IN %lu ms\n\r", BleApplicationContext.BackoffMs)
+	BleApplicationContext.BackingOff = 1;
+	HW_TS_Start(BleApplicationContext.Backoff_timer_Id, SCAN_BACKOFF_TICKS(BleApplicationContext.BackoffMs));
+	BleApplicationContext.BackoffMs = MIN(BleApplicationContext.BackoffMs * 2, SCAN_BACKOFF_MAX_MS);
+}
+
+/* Timer server interrupt */
+static void Backoff_Timeout(void) {
+	BleApplicationContext.BackingOff = 0;
+	UTIL_SEQ_SetTask(1 << CFG_TASK_START_SCAN_ID, CFG_SCH_PRIO_0);
+}
+
+static void Backoff_Reset(void) {
+	HW_TS_Stop(BleApplicationContext.Backoff_timer_Id);
+	BleApplicationContext.BackingOff = 0;
+	BleApplicationContext.BackoffMs = SCAN_BACKOFF_MIN_MS;
+}
+
+static void Phase_End(BleLink_t *link, APP_BLE_Phase_t phase) {
+	uint32_t now = HAL_GetTick();
+
+	link->Times.PhaseMs[phase] = now - link->PhaseStart;
+	link->PhaseStart = now;
+}
+
+/**
+ * @brief  Link encrypted, with a new pairing or the keys of the bond, the HID host can start
+ * @param  None
+ * @retval None
+ */
+static void Pairing_Done(BleLink_t *link) {
+	if (link->Status == APP_BLE_PAIRED) {
+		return;
+	}
+	link->Status = APP_BLE_PAIRED;
+	Phase_End(link, APP_BLE_PHASE_ENCRYPT);
+	handleNotification.HID_Evt_Opcode = PEER_PAIR_HANDLE_EVT;
+	handleNotification.ConnectionHandle = link->ConnectionHandle;
+	HID_Host_Notification(&handleNotification);
+	// Look for the next player
+	UTIL_SEQ_SetTask(1 << CFG_TASK_START_SCAN_ID, CFG_SCH_PRIO_0);
+}
+
+static BleLink_t* Link_Find(uint16_t handle) {
+	for (uint8_t i = 0; i < CFG_BLE_NUM_LINK; i++) {
+		if (BleApplicationContext.Links[i].Status != APP_BLE_IDLE
+				&& BleApplicationContext.Links[i].ConnectionHandle == handle) {
+			return &BleApplicationContext.Links[i];
+		}
+	}
+	return NULL;
+}
+
+static BleLink_t* Link_Free(void) {
+	for (uint8_t i = 0; i < CFG_BLE_NUM_LINK; i++) {
+		if (BleApplicationContext.Links[i].Status == APP_BLE_IDLE) {
+			return &BleApplicationContext.Links[i];
+		}
+	}
+	return NULL;
+}
+
+static uint8_t Link_Count(void) {
+	uint8_t count = 0;
+
+	for (uint8_t i = 0; i < CFG_BLE_NUM_LINK; i++) {
+		count += (BleApplicationContext.Links[i].Status != APP_BLE_IDLE);
+	}
+	return count;
+}
+
+/* A link is free for one more player */
+static bool Search_Needed(void) {
+	return Link_Free() && Link_Count() < HID_HOST_MAX_PLAYERS;
+}
+
+/**
+ * @brief  Called by the HID host once the reports are notified, ends the phase timing of the link
+ * @param  Connection_Handle: Handle of the connection
+ * @retval None
+ */
+void APP_BLE_Link_Ready(uint16_t Connection_Handle) {
+	BleLink_t *link = Link_Find(Connection_Handle);
+	const uint32_t *ms;
+
+	if (!link) {
+		return;
+	}
+	ms = link->Times.PhaseMs;
+	Phase_End(link, APP_BLE_PHASE_READY);
+	APP_DBG_MSG("-- LINK 0x%x %s : scan %lu ms, connect %lu ms, encrypt %lu ms, ready %lu ms, total %lu ms\n\r",
+			Connection_Handle, link->Times.Reconnect ? "RECONNECTED" : "PAIRED", ms[APP_BLE_PHASE_SCAN],
+			ms[APP_BLE_PHASE_CONNECT], ms[APP_BLE_PHASE_ENCRYPT], ms[APP_BLE_PHASE_READY],
+			ms[APP_BLE_PHASE_SCAN] + ms[APP_BLE_PHASE_CONNECT] + ms[APP_BLE_PHASE_ENCRYPT] + ms[APP_BLE_PHASE_READY])
+}
+
+const APP_BLE_Link_Times_t* APP_BLE_Get_Link_Times(uint16_t Connection_Handle) {
+	BleLink_t *link = Link_Find(Connection_Handle);
+
+	return link ? &link->Times : NULL;
+}
+
+static void Pairing_Request(void) {
+	tBleStatus result;
+
+	for (uint8_t i = 0; i < CFG_BLE_NUM_LINK; i++) {
+		BleLink_t *link = &BleApplicationContext.Links[i];
+
+		if (link->Status != APP_BLE_CONNECTED) {
+			continue;
+		}
+		APP_DBG_MSG("\r\n\r** SENDING PAIRING REQUEST TO SERVER **  \r\n\r")
+		// A bonded controller is only encrypted with the stored keys
+		result = aci_gap_send_pairing_req(link->ConnectionHandle, link->ForceRebond);
+		if (result == BLE_STATUS_SUCCESS) {
+			link->Status = APP_BLE_PAIRING;
 		}
 	}
 }
@@ -752,6 +1086,12 @@ void hci_cmd_resp_wait(uint32_t timeout) {
 	return;
 }
 
+static void Hci_Event_Task(void) {
+	PROFILE_BEGIN(TASK_HCI_EVENT);
+	hci_user_evt_proc();
+	PROFILE_END(TASK_HCI_EVENT);
+}
+
 static void BLE_UserEvtRx(void *pPayload) {
 	SVCCTL_UserEvtFlowStatus_t svctl_return_status;
 	tHCI_UserEvtRxParam *pParam;
@@ -54,6 +54,21 @@ typedef enum
 } APP_BLE_ConnStatus_t;
 
 /* USER CODE BEGIN ET */
+typedef enum
+{
+  APP_BLE_PHASE_SCAN,
+  APP_BLE_PHASE_CONNECT,
+  APP_BLE_PHASE_ENCRYPT,
+  APP_BLE_PHASE_READY,
+  APP_BLE_PHASE_COUNT
+} APP_BLE_Phase_t;
+
+/* Duration of each phase of a connection, from the end of the previous search, disconnection or boot */
+typedef struct
+{
+  uint8_t  Reconnect;                 /* Bonded controller, reconnected without discovery scan */
+  uint32_t PhaseMs[APP_BLE_PHASE_COUNT];
+} APP_BLE_Link_Times_t;
 
 /* USER CODE END ET */
 
@@ -75,6 +90,9 @@ typedef enum
 /* Exported functions ---------------------------------------------*/
 void APP_BLE_Init(void);
 APP_BLE_ConnStatus_t APP_BLE_Get_Client_Connection_Status(uint16_t Connection_Handle);
+const uint8_t* APP_BLE_Get_Peer_Address(uint16_t Connection_Handle, uint8_t *type);
+void APP_BLE_Link_Ready(uint16_t Connection_Handle);
+const APP_BLE_Link_Times_t* APP_BLE_Get_Link_Times(uint16_t Connection_Handle);
 
 /* USER CODE BEGIN EF */
 
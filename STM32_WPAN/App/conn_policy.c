@@ -0,0 +1,277 @@
+#include <string.h>
+#include "conn_policy.h"
+#include "main.h"
+#include "app_common.h"
+#include "ble.h"
+#include "stm32_seq.h"
+#include "dbg_trace.h"
+#include "profile.h"
+
+#define CONN_PHY_1M 0x01
+#define CONN_PHY_2M 0x02
+
+typedef struct {
+	uint16_t interval_min;
+	uint16_t interval_max;
+	uint16_t latency;
+	uint16_t ce_length;
+} conn_params_t;
+
+typedef struct {
+	bool connected;
+	uint16_t handle;
+	// Requests still to send, the HCI commands are only sent from the policy task
+	bool phy_pending;
+	bool dle_pending;
+	// A connection update is running until its complete event, only one at a time per link
+	bool updating;
+	Conn_Profile_t applied;
+	uint32_t last_report;
+	Conn_Policy_Stats_t stats;
+} conn_link_t;
+
+typedef struct {
+	Conn_Profile_t wanted;
+	conn_link_t links[CFG_BLE_NUM_LINK];
+} conn_policy_t;
+
+static const conn_params_t profiles[CONN_PROFILE_COUNT] = {
+	[CONN_PROFILE_RELAXED] = { CONN_MENU_P1, CONN_MENU_P2, CONN_MENU_LATENCY, CONN_MENU_L },
+	[CONN_PROFILE_LOW_LATENCY] = { CONN_GAME_P, CONN_GAME_P, CONN_GAME_LATENCY, CONN_GAME_L },
+};
+
+static conn_policy_t policy;
+
+static void Conn_Policy_Task(void);
+
+static conn_link_t* Conn_Policy_Find(uint16_t handle) {
+	for (uint8_t i = 0; i < CFG_BLE_NUM_LINK; i++) {
+		if (policy.links[i].connected && policy.links[i].handle == handle) {
+			return &policy.links[i];
+		}
+	}
+	return NULL;
+}
+
+static void Conn_Policy_Reset_Gaps(conn_link_t *link) {
+	link->stats.reports = 0;
+	link->stats.gap_min_us = UINT32_MAX;
+	link->stats.gap_max_us = 0;
+	link->stats.gap_avg_us = 0;
+}
+
+void Conn_Policy_Init(void) {
+	memset(&policy, 0, sizeof(policy));
+	policy.wanted = CONN_PROFILE_RELAXED;
+	UTIL_SEQ_RegTask(1 << CFG_TASK_CONN_UPDATE_ID, UTIL_SEQ_RFU, Conn_Policy_Task);
+}
+
+/*
+ * Send the next pending request of a link, return false when it has none.
+ */
+static bool Conn_Policy_Link_Step(conn_link_t *link) {
+	const conn_params_t *params;
+	tBleStatus result;
+
+	if (link->phy_pending) {
+		link->phy_pending = false;
+		result = hci_le_set_phy(link->handle, 0, CONN_PHY_2M, CONN_PHY_2M, 0);
+		if (result != BLE_STATUS_SUCCESS) {
+			APP_DBG_MSG("-- CONN : LE 2M PHY request failed, result: 0x%x\n", result)
+		}
+		return true;
+	}
+
+	if (link->dle_pending) {
+		link->dle_pending = false;
+		result = hci_le_set_data_length(link->handle, CONN_DLE_OCTETS, CONN_DLE_TIME);
+		if (result != BLE_STATUS_SUCCESS) {
+			APP_DBG_MSG("-- CONN : data length extension failed, result: 0x%x\n", result)
+		}
+		return true;
+	}
+
+	if (link->updating || link->applied == policy.wanted) {
+		return false;
+	}
+	params = &profiles[policy.wanted];
+	result = aci_gap_start_connection_update(link->handle, params->interval_min, params->interval_max,
+			params->latency, SUPERV_TIMEOUT, 0, params->ce_length);
+	link->applied = policy.wanted;
+	if (result != BLE_STATUS_SUCCESS) {
+		// Like a rejection, the profile is requested again on the next change only, rescheduling would spin
+		APP_DBG_MSG("-- CONN : connection update failed, result: 0x%x\n", result)
+		link->stats.rejected++;
+		return false;
+	}
+	link->updating = true;
+	APP_DBG_MSG("-- CONN : requesting %s profile on 0x%x\n", (policy.wanted == CONN_PROFILE_LOW_LATENCY) ? "low latency" : "relaxed", link->handle)
+	return true;
+}
+
+/*
+ * Send one pending request, each one waits for a command status, and run again while some are left.
+ */
+static void Conn_Policy_Task(void) {
+	PROFILE_BEGIN(TASK_CONN_POLICY);
+
+	for (uint8_t i = 0; i < CFG_BLE_NUM_LINK; i++) {
+		if (policy.links[i].connected && Conn_Policy_Link_Step(&policy.links[i])) {
+			UTIL_SEQ_SetTask(1 << CFG_TASK_CONN_UPDATE_ID, CFG_SCH_PRIO_0);
+			break;
+		}
+	}
+	PROFILE_END(TASK_CONN_POLICY);
+}
+
+/*
+ * Called by the application on each stage change, the parameters are only renegotiated if the profile changes.
+ */
+void Conn_Policy_Set_Profile(Conn_Profile_t profile) {
+	if (profile >= CONN_PROFILE_COUNT || profile == policy.wanted) {
+		return;
+	}
+	policy.wanted = profile;
+	for (uint8_t i = 0; i < CFG_BLE_NUM_LINK; i++) {
+		policy.links[i].stats.profile = profile;
+	}
+	UTIL_SEQ_SetTask(1 << CFG_TASK_CONN_UPDATE_ID, CFG_SCH_PRIO_0);
+}
+
+void Conn_Policy_Connected(uint16_t handle, uint16_t interval, uint16_t latency, uint16_t timeout) {
+	conn_link_t *link = NULL;
+
+	for (uint8_t i = 0; i < CFG_BLE_NUM_LINK && !link; i++) {
+		if (!policy.links[i].connected) {
+			link = &policy.links[i];
+		}
+	}
+	if (!link) {
+		return;
+	}
+	memset(link, 0, sizeof(conn_link_t));
+	link->connected = true;
+	link->handle = handle;
+	link->phy_pending = true;
+	link->dle_pending = true;
+	link->applied = CONN_PROFILE_COUNT;
+	link->stats.profile = policy.wanted;
+	link->stats.interval = interval;
+	link->stats.latency = latency;
+	link->stats.timeout = timeout;
+	link->stats.tx_phy = CONN_PHY_1M;
+	link->stats.rx_phy = CONN_PHY_1M;
+	link->stats.max_tx_octets = 27;
+	link->stats.max_rx_octets = 27;
+	Conn_Policy_Reset_Gaps(link);
+	UTIL_SEQ_SetTask(1 << CFG_TASK_CONN_UPDATE_ID, CFG_SCH_PRIO_0);
+}
+
+void Conn_Policy_Disconnected(uint16_t handle) {
+	conn_link_t *link = Conn_Policy_Find(handle);
+
+	if (link) {
+		link->connected = false;
+	}
+}
+
+void Conn_Policy_Updated(uint16_t handle, uint8_t status, uint16_t interval, uint16_t latency, uint16_t timeout) {
+	conn_link_t *link = Conn_Policy_Find(handle);
+
+	if (!link) {
+		return;
+	}
+	link->updating = false;
+	if (status != 0x00) {
+		// The controller refused, the profile is requested again on the next change only
+		APP_DBG_MSG("-- CONN : connection update rejected, status: 0x%x\n", status)
+		link->stats.rejected++;
+	} else {
+		APP_DBG_MSG("-- CONN : interval %d x 1.25 ms, latency %d, timeout %d x 10 ms\n", interval, latency, timeout)
+		link->stats.interval = interval;
+		link->stats.latency = latency;
+		link->stats.timeout = timeout;
+		link->stats.updates++;
+		Conn_Policy_Reset_Gaps(link);
+	}
+	if (link->applied != policy.wanted) {
+		UTIL_SEQ_SetTask(1 << CFG_TASK_CONN_UPDATE_ID, CFG_SCH_PRIO_0);
+	}
+}
+
+void Conn_Policy_Phy_Updated(uint16_t handle, uint8_t status, uint8_t tx_phy, uint8_t rx_phy) {
+	conn_link_t *link = Conn_Policy_Find(handle);
+
+	if (!link) {
+		return;
+	}
+	if (status != 0x00) {
+		APP_DBG_MSG("-- CONN : PHY update failed, status: 0x%x\n", status)
+		return;
+	}
+	APP_DBG_MSG("-- CONN : PHY tx %d rx %d\n", tx_phy, rx_phy)
+	link->stats.tx_phy = tx_phy;
+	link->stats.rx_phy = rx_phy;
+}
+
+void Conn_Policy_Data_Length_Changed(uint16_t handle, uint16_t max_tx_octets, uint16_t max_rx_octets) {
+	conn_link_t *link = Conn_Policy_Find(handle);
+
+	if (!link) {
+		return;
+	}
+	APP_DBG_MSG("-- CONN : data length tx %d rx %d\n", max_tx_octets, max_rx_octets)
+	link->stats.max_tx_octets = max_tx_octets;
+	link->stats.max_rx_octets = max_rx_octets;
+}
+
+/*
+ * Called on each report notification with its Latency_Now stamp.
+ */
+void Conn_Policy_Report(uint16_t handle, uint32_t stamp) {
+	conn_link_t *link = Conn_Policy_Find(handle);
+	uint32_t gap;
+
+	if (!link) {
+		return;
+	}
+	if (link->stats.reports++ == 0) {
+		link->last_report = stamp;
+		return;
+	}
+	gap = stamp - link->last_report;
+	link->last_report = stamp;
+	link->stats.gap_min_us = MIN(link->stats.gap_min_us, gap);
+	link->stats.gap_max_us = MAX(link->stats.gap_max_us, gap);
+	if (link->stats.reports == 2) {
+		link->stats.gap_avg_us = gap;
+	} else {
+		link->stats.gap_avg_us = link->stats.gap_avg_us - link->stats.gap_avg_us / 8 + gap / 8;
+	}
+}
+
+/*
+ * Stats of a connection, NULL if it is not connected.
+ */
+const Conn_Policy_Stats_t* Conn_Policy_Get_Stats(uint16_t handle) {
+	conn_link_t *link = Conn_Policy_Find(handle);
+
+	return link ? &link->stats : NULL;
+}
+
+void Conn_Policy_Dump(void) {
+	for (uint8_t i = 0; i < CFG_BLE_NUM_LINK; i++) {
+		const Conn_Policy_Stats_t *stats = &policy.links[i].stats;
+
+		if (!policy.links[i].connected) {
+			continue;
+		}
+		APP_DBG_MSG("Connection 0x%x : interval %u x 1.25 ms, latency %u, PHY %u/%u, data length %u/%u, %lu updates, %lu rejected\n",
+				policy.links[i].handle, stats->interval, stats->latency, stats->tx_phy, stats->rx_phy,
+				stats->max_tx_octets, stats->max_rx_octets, stats->updates, stats->rejected)
+		if (stats->reports > 1) {
+			APP_DBG_MSG("Reports : %lu, inter-arrival min %lu us, avg %lu us, max %lu us\n", stats->reports,
+					stats->gap_min_us, stats->gap_avg_us, stats->gap_max_us)
+		}
+	}
+}
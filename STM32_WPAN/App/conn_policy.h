@@ -0,0 +1,42 @@
+#ifndef __CONN_POLICY_H__
+#define __CONN_POLICY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+	CONN_PROFILE_RELAXED = 0,	// Menus, longer interval and peripheral latency to save power
+	CONN_PROFILE_LOW_LATENCY,	// Game stages, minimum interval and no peripheral latency
+	CONN_PROFILE_COUNT,
+} Conn_Profile_t;
+
+typedef struct {
+	Conn_Profile_t profile;
+	uint16_t interval;			// Negotiated, unit 1.25 ms
+	uint16_t latency;
+	uint16_t timeout;			// Unit 10 ms
+	uint8_t tx_phy;				// 1 for LE 1M, 2 for LE 2M
+	uint8_t rx_phy;
+	uint16_t max_tx_octets;
+	uint16_t max_rx_octets;
+	uint32_t updates;
+	uint32_t rejected;
+	// Report inter-arrival, since the last parameter change
+	uint32_t reports;
+	uint32_t gap_min_us;
+	uint32_t gap_max_us;
+	uint32_t gap_avg_us;		// Moving average over the last 8 reports or so
+} Conn_Policy_Stats_t;
+
+void Conn_Policy_Init(void);
+void Conn_Policy_Set_Profile(Conn_Profile_t profile);
+void Conn_Policy_Connected(uint16_t handle, uint16_t interval, uint16_t latency, uint16_t timeout);
+void Conn_Policy_Disconnected(uint16_t handle);
+void Conn_Policy_Updated(uint16_t handle, uint8_t status, uint16_t interval, uint16_t latency, uint16_t timeout);
+void Conn_Policy_Phy_Updated(uint16_t handle, uint8_t status, uint8_t tx_phy, uint8_t rx_phy);
+void Conn_Policy_Data_Length_Changed(uint16_t handle, uint16_t max_tx_octets, uint16_t max_rx_octets);
+void Conn_Policy_Report(uint16_t handle, uint32_t stamp);
+const Conn_Policy_Stats_t* Conn_Policy_Get_Stats(uint16_t handle);
+void Conn_Policy_Dump(void);
+
+#endif /* __CONN_POLICY_H__ */
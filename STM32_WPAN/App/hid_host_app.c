@@ -27,8 +27,25 @@
 #include "ble.h"
 #include "stm32_seq.h"
 #include "app_ble.h"
+#include "input.h"
+#include "latency.h"
+#include "hid_parser.h"
+#include "hid_attribute.h"
+#include "nvm.h"
+#include "conn_policy.h"
+#include "hid_output.h"
+#include "utilities_conf.h"
+#include "seqlock.h"
+#include "trace.h"
+#include "profile.h"
 
 /* Private typedef -----------------------------------------------------------*/
+#define HID_CACHE_PEERS 2
+#define HID_DATABASE_HASH_SIZE 16
+// Longest report compared against the previous one to drop duplicates
+#define HID_REPORT_PAYLOAD_SIZE 64
+#define HID_CHANGE_AXES (HID_CHANGE_COUNT - HID_CHANGE_LEFT_X)
+
 typedef struct {
 	/**
 	 * state of the P2P Client
@@ -37,21 +54,70 @@ typedef struct {
 	HID_HOST_Status_t state;
 	uint16_t connHandle;
 	// HID Service
-	uint16_t HIDServiceHandle;
-	uint16_t HIDServiceEndHandle;
 	uint16_t HIDReadInformationCharHandle;
+	uint16_t HIDReportMapCharHandle;
 	uint16_t HIDReport1CharHandle;
 	uint16_t HIDReport2CharHandle;
 	uint16_t HIDReportReferenceDescHandle;
 	uint16_t HIDReportReferenceDesc2Handle;
 	uint16_t HIDClientCharDescHandle;
+	uint16_t HIDOutputReportCharHandle;
 	// Battery Service
-	uint16_t BatteryServiceHandle;
-	uint16_t BatteryServiceEndHandle;
 	uint16_t BatteryLevelCharHandle;
 	uint16_t BatteryLevelCharDescHandle;
+	// GATT Service
+	uint16_t ServiceChangedCharHandle;
+	uint16_t ServiceChangedCharDescHandle;
 } HID_ClientContext_t;
 
+/* Handles and report plan of a controller, to skip the discovery when it connects again */
+typedef struct {
+	uint8_t Address[6];
+	uint8_t AddressType;
+	uint8_t HashValid;
+	uint8_t Hash[HID_DATABASE_HASH_SIZE];
+	uint32_t Stamp;
+	HID_ClientContext_t Context;
+	HID_Plan_t Plan;
+} HID_CacheEntry_t;
+
+typedef struct {
+	uint32_t Stamp;
+	HID_CacheEntry_t Entries[HID_CACHE_PEERS];
+} HID_Cache_t;
+
+/* Everything known about one connected controller, the player index is its slot */
+typedef struct {
+	HID_ClientContext_t Context;
+	uint8_t Player;
+	// A discovery step is due, the task runs the steps of every player
+	bool Pending;
+	HID_Report_t Report;
+	// Odd while Report is being written, incremented twice per report
+	Seqlock_t ReportSeq;
+	uint8_t BatteryLevel;
+	uint32_t ReportTick;
+	// Fields changed since the application last took them, against the values of the last change
+	uint32_t Changes;
+	uint32_t ChangeButtons;
+	uint16_t ChangeAxes[HID_CHANGE_AXES];
+	uint8_t Payload[HID_REPORT_PAYLOAD_SIZE];
+	uint8_t PayloadLength;
+	// Report map of the peer, compiled once per connection into the plan decoding each report
+	uint8_t ReportMap[HID_PARSER_MAP_SIZE];
+	uint16_t ReportMapLength;
+	HID_Plan_t ReportPlan;
+	// Handles restored from the cache, with the hash they were stored with
+	bool Cached;
+	uint8_t CachedHashValid;
+	uint8_t CachedHash[HID_DATABASE_HASH_SIZE];
+	uint8_t DatabaseHash[HID_DATABASE_HASH_SIZE];
+	uint8_t DatabaseHashLength;
+	HID_Attribute_Table_t Attributes;
+	uint8_t DiscoveryProcedures;
+	uint8_t DiscoveryResponses;
+} HID_Host_t;
+
 /* Private defines ------------------------------------------------------------*/
 
 /* Private macros -------------------------------------------------------------*/
@@ -60,14 +126,33 @@ typedef struct {
         (uint16_t)((((uint16_t)(*((uint8_t *)ptr + 1))) << 8))
 
 /* Private variables ---------------------------------------------------------*/
-static HID_ClientContext_t HIDHostContext;
-static HID_Report_t HIDReport;
-static uint8_t BatteryLevel = 0;
+static HID_Host_t HIDHosts[HID_HOST_MAX_PLAYERS];
+// Shared by the players, read again from the NVM by each load, store or forget
+static HID_Cache_t HIDCache;
+
+_Static_assert(sizeof(HID_Cache_t) <= NVM_SLOT_SIZE, "GATT cache does not fit its NVM slot");
+_Static_assert(HID_HOST_MAX_PLAYERS <= CFG_BLE_NUM_LINK, "More players than BLE links");
 
 /* Private function prototypes -----------------------------------------------*/
-static void HID_Report_Notification(uint8_t *payload, size_t length);
+static void HID_Report_Notification(HID_Host_t *host, uint8_t *payload, size_t length, uint32_t stamp);
 static SVCCTL_EvtAckStatus_t Event_Handler(void *Event);
 static void Update_Discovery();
+static void HID_Host_Step(HID_Host_t *host);
+static void HID_Host_Discover(HID_Host_t *host);
+static HID_Host_t* HID_Host_Find(uint16_t connHandle);
+static HID_Host_t* HID_Host_Attach(uint16_t connHandle);
+static void HID_Report_Map_Data(HID_Host_t *host, const uint8_t *data, uint8_t length);
+static void HID_Report_Plan_Reset(HID_Host_t *host);
+static uint32_t HID_Report_Changes(HID_Host_t *host, const HID_Report_t *report);
+static uint32_t HID_Payload_Word(const uint8_t *payload, size_t length, uint8_t offset);
+static int8_t HID_Cache_Read(HID_Host_t *host);
+static bool HID_Cache_Load(HID_Host_t *host);
+static bool HID_Cache_Check(HID_Host_t *host);
+static void HID_Cache_Store(HID_Host_t *host);
+static void HID_Cache_Forget(HID_Host_t *host);
+static void HID_Host_Rediscover(HID_Host_t *host);
+static void HID_Host_Abort(HID_Host_t *host);
+static bool HID_Host_Resolve(HID_Host_t *host);
 
 /* Functions Definition ------------------------------------------------------*/
 /**
@@ -76,8 +161,13 @@ static void Update_Discovery();
  * @retval None
  */
 void HID_Host_Init(void) {
-	memset(&HIDHostContext, 0, sizeof(HID_ClientContext_t));
+	memset(HIDHosts, 0, sizeof(HIDHosts));
+	for (uint8_t i = 0; i < HID_HOST_MAX_PLAYERS; i++) {
+		HIDHosts[i].Player = i;
+		HID_Report_Plan_Reset(&HIDHosts[i]);
+	}
 	UTIL_SEQ_RegTask(1 << CFG_TASK_SEARCH_SERVICE_ID, UTIL_SEQ_RFU, Update_Discovery);
+	HID_Output_Init();
 
 	/**
 	 *  Register the event handler to the BLE controller
@@ -88,19 +178,44 @@ void HID_Host_Init(void) {
 }
 
 void HID_Host_Notification(HID_APP_ConnHandle_Not_evt_t *pNotification) {
+	HID_Host_t *host;
+
 	switch (pNotification->HID_Evt_Opcode) {
 	case PEER_CONN_HANDLE_EVT:
-		HIDHostContext.state = HID_HOST_CONNECTED;
+		host = HID_Host_Attach(pNotification->ConnectionHandle);
+		if (host) {
+			APP_DBG_MSG("-- HID HOST : player %d connected\n", host->Player)
+			host->Context.state = HID_HOST_CONNECTED;
+			UTIL_SEQ_SetTask(1 << CFG_TASK_APP_LINK_ID, CFG_SCH_PRIO_0);
+		} else {
+			// Every player is taken, the link would hold a BLE link slot for nothing
+			APP_DBG_MSG("-- HID HOST : no free player, connection 0x%x refused\n", pNotification->ConnectionHandle)
+			aci_gap_terminate(pNotification->ConnectionHandle, HCI_REMOTE_USER_TERMINATED_CONNECTION_ERR_CODE);
+		}
 		break;
 
 	case PEER_PAIR_HANDLE_EVT:
-		HIDHostContext.state = HID_HOST_DISCOVER_SERVICES;
-		HIDHostContext.connHandle = pNotification->ConnectionHandle;
-		UTIL_SEQ_SetTask(1 << CFG_TASK_SEARCH_SERVICE_ID, CFG_SCH_PRIO_0); // TODO maybe remove
+		host = HID_Host_Find(pNotification->ConnectionHandle);
+		if (host) {
+			// A known controller only needs its database hash checked
+			host->Context.state = HID_Cache_Load(host) ? HID_HOST_READ_DATABASE_HASH : HID_HOST_EXCHANGE_MTU;
+			HID_Host_Step(host);
+		}
 		break;
 
 	case PEER_DISCON_HANDLE_EVT:
-		memset(&HIDHostContext, 0, sizeof(HID_ClientContext_t));
+		host = HID_Host_Find(pNotification->ConnectionHandle);
+		if (host) {
+			HID_Output_Detach(host->Player);
+			memset(&host->Context, 0, sizeof(HID_ClientContext_t));
+			host->Pending = false;
+			host->BatteryLevel = 0;
+			host->Cached = false;
+			HID_Report_Plan_Reset(host);
+			// Release the keys still held by the lost controller
+			Input_Report(host->Player, &host->Report, HAL_GetTick(), Latency_Now());
+			UTIL_SEQ_SetTask(1 << CFG_TASK_APP_LINK_ID, CFG_SCH_PRIO_0);
+		}
 		break;
 
 	default:
@@ -109,16 +224,62 @@ void HID_Host_Notification(HID_APP_ConnHandle_Not_evt_t *pNotification) {
 	return;
 }
 
-HID_HOST_Status_t HID_Host_Get_State(void) {
-	return HIDHostContext.state;
+HID_HOST_Status_t HID_Host_Get_State(uint8_t player) {
+	return (player < HID_HOST_MAX_PLAYERS) ? HIDHosts[player].Context.state : HID_HOST_IDLE;
+}
+
+/**
+ * @brief  Copy the latest report of a player, retrying if a notification updated it meanwhile
+ * @param  player: Index of the controller
+ * @param  report: Destination of the snapshot, the neutral report for an unknown player
+ * @retval Number of reports received so far
+ */
+uint32_t HID_Host_Read_Report(uint8_t player, HID_Report_t *report) {
+	if (player >= HID_HOST_MAX_PLAYERS) {
+		HID_Parser_Neutral(report);
+		return 0;
+	}
+	return Seqlock_Read(&HIDHosts[player].ReportSeq, report, &HIDHosts[player].Report, sizeof(HID_Report_t));
 }
 
-HID_Report_t* HID_Host_Get_Report(void) {
-	return &HIDReport;
+uint8_t HID_Host_Get_Battery_Level(uint8_t player) {
+	return (player < HID_HOST_MAX_PLAYERS) ? HIDHosts[player].BatteryLevel : 0;
+}
+
+uint32_t HID_Host_Get_Report_Tick(uint8_t player) {
+	return (player < HID_HOST_MAX_PLAYERS) ? HIDHosts[player].ReportTick : 0;
+}
+
+/**
+ * @brief  Fields of the report of a player that changed since the previous call
+ * @param  player: Index of the controller
+ * @retval Mask of HID_CHANGE_MASK bits
+ */
+uint32_t HID_Host_Take_Changes(uint8_t player) {
+	uint32_t changes;
+
+	if (player >= HID_HOST_MAX_PLAYERS) {
+		return 0;
+	}
+	UTILS_ENTER_CRITICAL_SECTION();
+	changes = HIDHosts[player].Changes;
+	HIDHosts[player].Changes = 0;
+	UTILS_EXIT_CRITICAL_SECTION();
+	return changes;
 }
 
-uint8_t HID_Host_Get_Battery_Level(void) {
-	return BatteryLevel;
+/**
+ * @brief  Number of controllers ready to play
+ * @param  None
+ * @retval Count of players in the HID_HOST_DONE state
+ */
+uint8_t HID_Host_Get_Player_Count(void) {
+	uint8_t count = 0;
+
+	for (uint8_t i = 0; i < HID_HOST_MAX_PLAYERS; i++) {
+		count += (HIDHosts[i].Context.state == HID_HOST_DONE);
+	}
+	return count;
 }
 
 /*************************************************************
@@ -136,6 +297,8 @@ static SVCCTL_EvtAckStatus_t Event_Handler(void *Event) {
 	SVCCTL_EvtAckStatus_t return_value;
 	hci_event_pckt *event_pckt;
 	evt_blecore_aci *blecore_evt;
+	HID_Host_t *host;
+	PROFILE_BEGIN(HID_EVENT);
 
 	return_value = SVCCTL_EvtNotAck;
 	event_pckt = (hci_event_pckt*) (((hci_uart_pckt*) Event)->data);
@@ -143,186 +306,107 @@ static SVCCTL_EvtAckStatus_t Event_Handler(void *Event) {
 	switch (event_pckt->evt) {
 	case HCI_VENDOR_SPECIFIC_DEBUG_EVT_CODE: {
 		blecore_evt = (evt_blecore_aci*) event_pckt->data;
+		// Every event handled here starts with the connection handle
+		host = HID_Host_Find(UNPACK_2_BYTE_PARAMETER(blecore_evt->data));
 		switch (blecore_evt->ecode) {
 
-		case ACI_ATT_READ_BY_GROUP_TYPE_RESP_VSEVT_CODE: {
-			aci_att_read_by_group_type_resp_event_rp0 *pr = (void*) blecore_evt->data;
-			uint8_t numberService, i, idx;
-			uint16_t uuid, handle;
-
-			handle = pr->Connection_Handle;
-			if (HIDHostContext.state != HID_HOST_IDLE) {
-				APP_BLE_ConnStatus_t status;
-
-				status = APP_BLE_Get_Client_Connection_Status(HIDHostContext.connHandle);
+		case ACI_ATT_READ_BY_TYPE_RESP_VSEVT_CODE: {
+			aci_att_read_by_type_resp_event_rp0 *pr = (void*) blecore_evt->data;
 
-				if ((HIDHostContext.state == HID_HOST_DONE) && (status == APP_BLE_IDLE)) {
-					HIDHostContext.state = HID_HOST_IDLE;
-					HIDHostContext.connHandle = 0xFFFF;
-					break;
-				}
+			if (host && host->Context.state == HID_HOST_DISCOVERING_CHARACS) {
+				host->DiscoveryResponses++;
+				HID_Attribute_Characs(&host->Attributes, pr->Handle_Value_Pair_Data, pr->Data_Length, pr->Handle_Value_Pair_Length);
 			}
+		}
+			break; /*ACI_ATT_READ_BY_TYPE_RESP_VSEVT_CODE*/
+
+		case ACI_ATT_FIND_INFO_RESP_VSEVT_CODE: {
+			aci_att_find_info_resp_event_rp0 *pr = (void*) blecore_evt->data;
 
-			HIDHostContext.connHandle = handle;
-			numberService = (pr->Data_Length) / pr->Attribute_Data_Length;
-			/* the event data will be
-			 * 2bytes start handle
-			 * 2bytes end handle
-			 * 2 or 16 bytes data
-			 * we are interested only if the UUID is 2 bit.
-			 * So check if the data length is 6
-			 */
-			idx = 0;
-			if (pr->Attribute_Data_Length == 6) {
-				for (i = 0; i < numberService; i++) {
-					uuid = UNPACK_2_BYTE_PARAMETER(&pr->Attribute_Data_List[idx + 4]);
-					switch (uuid) {
-					case HUMAN_INTERFACE_DEVICE_SERVICE_UUID:
-						APP_DBG_MSG("-- GATT : HID SERVICE FOUND - connection handle 0x%x\n", handle)
-						HIDHostContext.HIDServiceHandle = UNPACK_2_BYTE_PARAMETER(&pr->Attribute_Data_List[idx]);
-						HIDHostContext.HIDServiceEndHandle = UNPACK_2_BYTE_PARAMETER(&pr->Attribute_Data_List[idx + 2]);
-						HIDHostContext.state = HID_HOST_DISCOVER_HID_CHARACS;
-						break;
-					case BATTERY_SERVICE_UUID:
-						APP_DBG_MSG("-- GATT : BATTERY SERVICE FOUND - connection handle 0x%x\n", handle)
-						HIDHostContext.BatteryServiceHandle = UNPACK_2_BYTE_PARAMETER(&pr->Attribute_Data_List[idx]);
-						HIDHostContext.BatteryServiceEndHandle = UNPACK_2_BYTE_PARAMETER(
-								&pr->Attribute_Data_List[idx + 2]);
-						break;
-					}
-					idx += 6;
+			/* we are interested only in 16 bit UUIDs */
+			if (host && host->Context.state == HID_HOST_DISCOVERING_DESCS) {
+				host->DiscoveryResponses++;
+				if (pr->Format == UUID_TYPE_16) {
+					HID_Attribute_Descs(&host->Attributes, pr->Handle_UUID_Pair, pr->Event_Data_Length);
 				}
 			}
 		}
-			break;
+			break; /*ACI_ATT_FIND_INFO_RESP_VSEVT_CODE*/
 
-		case ACI_ATT_READ_BY_TYPE_RESP_VSEVT_CODE: {
+		case ACI_ATT_READ_RESP_VSEVT_CODE: {
+			aci_att_read_resp_event_rp0 *pr = (void*) blecore_evt->data;
 
-			aci_att_read_by_type_resp_event_rp0 *pr = (void*) blecore_evt->data;
-			uint8_t idx;
-			uint16_t uuid, handle;
-
-			/* the event data will be
-			 * 2 bytes start handle
-			 * 1 byte char properties
-			 * 2 bytes handle
-			 * 2 or 16 bytes data
-			 */
-
-			if (HIDHostContext.connHandle == pr->Connection_Handle) {
-				/* we are interested in only 2 bit UUIDs */
-				idx = 0;
-				if (pr->Handle_Value_Pair_Length == 7) {
-					pr->Data_Length -= 1;
-					while (pr->Data_Length > 0) {
-						uuid = UNPACK_2_BYTE_PARAMETER(&pr->Handle_Value_Pair_Data[idx + 5]);
-						handle = UNPACK_2_BYTE_PARAMETER(&pr->Handle_Value_Pair_Data[idx + 3]);
-						switch (uuid) {
-						case HID_INFORMATION_CHAR_UUID:
-							APP_DBG_MSG("-- GATT : HID_INFORMATION_CHAR_UUID FOUND - connection handle 0x%x\n", handle)
-							HIDHostContext.HIDReadInformationCharHandle = handle;
-							break;
-						case REPORT_CHAR_UUID:
-							APP_DBG_MSG("-- GATT : REPORT_CHAR_UUID FOUND  - connection handle 0x%x\n", handle)
-							HIDHostContext.state = HID_HOST_DISCOVER_REPORT_1_DESC;
-							if (HIDHostContext.HIDReport1CharHandle == 0) {
-								HIDHostContext.HIDReport1CharHandle = handle;
-							} else {
-								HIDHostContext.HIDReport2CharHandle = handle;
-							}
-							break;
-						case REPORT_MAP_CHAR_UUID:
-							APP_DBG_MSG("-- GATT : REPORT_MAP_CHAR_UUID FOUND - connection handle 0x%x\n", handle)
-							break;
-						case HID_CONTROL_POINT_CHAR_UUID:
-							APP_DBG_MSG("-- GATT : HID_CONTROL_POINT_CHAR_UUID FOUND - connection handle 0x%x\n", handle)
-							break;
-						case BATTERY_LEVEL_CHAR_UUID:
-							APP_DBG_MSG("-- GATT : BATTERY_LEVEL_CHAR_UUID FOUND - connection handle 0x%x\n", handle)
-							HIDHostContext.BatteryLevelCharHandle = handle;
-							HIDHostContext.state = HID_HOST_DISCOVER_LEVEL_DESC;
-							break;
-
-						default:
-							break;
-						}
-						pr->Data_Length -= 7;
-						idx += 7;
-					}
-				}
+			if (host) {
+				HID_Report_Map_Data(host, pr->Attribute_Value, pr->Event_Data_Length);
 			}
 		}
-			break;
+			break; /*ACI_ATT_READ_RESP_VSEVT_CODE*/
 
-		case ACI_ATT_FIND_INFO_RESP_VSEVT_CODE: {
-			aci_att_find_info_resp_event_rp0 *pr = (void*) blecore_evt->data;
+		case ACI_ATT_READ_BLOB_RESP_VSEVT_CODE: {
+			aci_att_read_blob_resp_event_rp0 *pr = (void*) blecore_evt->data;
 
-			uint8_t numDesc, idx, i;
-			uint16_t uuid, handle;
-
-			/*
-			 * event data will be of the format
-			 * 2 bytes handle
-			 * 2 bytes UUID
-			 */
-			if (HIDHostContext.connHandle == pr->Connection_Handle) {
-				numDesc = (pr->Event_Data_Length) / 4;
-				/* we are interested only in 16 bit UUIDs */
-				idx = 0;
-				if (pr->Format == UUID_TYPE_16) {
-					for (i = 0; i < numDesc; i++) {
-						handle = UNPACK_2_BYTE_PARAMETER(&pr->Handle_UUID_Pair[idx]);
-						uuid = UNPACK_2_BYTE_PARAMETER(&pr->Handle_UUID_Pair[idx + 2]);
-
-						if (uuid == CLIENT_CHAR_CONFIG_DESCRIPTOR_UUID) {
-							APP_DBG_MSG("-- GATT : CLIENT_CHAR_CONFIG_DESCRIPTOR_UUID- connection handle 0x%x\n", handle)
-							if (HIDHostContext.state == HID_HOST_DISCOVERING_REPORT_1_DESC) {
-								HIDHostContext.HIDClientCharDescHandle = handle;
-							} else if (HIDHostContext.state == HID_HOST_DISCOVERING_LEVEL_DESC) {
-								HIDHostContext.BatteryLevelCharDescHandle = handle;
-								HIDHostContext.state = HID_HOST_ENABLE_ALL_NOTIFICATION_DESC;
-							}
-						} else if (uuid == REPORT_REFERENCE_DESCRIPTOR_UUID) {
-							APP_DBG_MSG("-- GATT : REPORT_REFERENCE_DESCRIPTOR_UUID- connection handle 0x%x\n", handle)
-							if (HIDHostContext.state == HID_HOST_DISCOVERING_REPORT_1_DESC) {
-								HIDHostContext.HIDReportReferenceDescHandle = handle;
-								HIDHostContext.state = HID_HOST_DISCOVER_REPORT_2_DESC;
-							} else if (HIDHostContext.state == HID_HOST_DISCOVERING_REPORT_2_DESC) {
-								HIDHostContext.HIDReportReferenceDesc2Handle = handle;
-								HIDHostContext.state = HID_HOST_DISCOVER_LEVEL_CHARACS;
-							}
-						}
-						idx += 4;
-					}
-				}
+			if (host) {
+				HID_Report_Map_Data(host, pr->Attribute_Value, pr->Event_Data_Length);
 			}
 		}
-			break; /*ACI_ATT_FIND_INFO_RESP_VSEVT_CODE*/
+			break; /*ACI_ATT_READ_BLOB_RESP_VSEVT_CODE*/
 
 		case ACI_GATT_NOTIFICATION_VSEVT_CODE: {
 			aci_gatt_notification_event_rp0 *pr = (void*) blecore_evt->data;
-			if (HIDHostContext.connHandle == pr->Connection_Handle) {
-				if ((pr->Attribute_Handle == HIDHostContext.HIDReport1CharHandle)) {
-					APP_DBG_MSG("-- GATT : ACI_GATT_NOTIFICATION_VSEVT_CODE for HID Report\n")
-					HID_Report_Notification(&pr->Attribute_Value[0], pr->Attribute_Value_Length);
-				} else if ((pr->Attribute_Handle == HIDHostContext.BatteryLevelCharHandle)) {
-					APP_DBG_MSG("-- GATT : ACI_GATT_NOTIFICATION_VSEVT_CODE for Battery Level : %d\n", pr->Attribute_Value[0])
-					BatteryLevel = pr->Attribute_Value[0];
+			// Start of the input to display latency measurement
+			uint32_t stamp = Latency_Now();
+			if (host) {
+				if ((pr->Attribute_Handle == host->Context.HIDReport1CharHandle)) {
+					Conn_Policy_Report(pr->Connection_Handle, stamp);
+					HID_Report_Notification(host, &pr->Attribute_Value[0], pr->Attribute_Value_Length, stamp);
+				} else if ((pr->Attribute_Handle == host->Context.BatteryLevelCharHandle)) {
+					TRACE(TRACE_HID_BATTERY, host->Player, pr->Attribute_Value[0], 0, 0);
+					host->BatteryLevel = pr->Attribute_Value[0];
+					UTIL_SEQ_SetTask(1 << CFG_TASK_APP_BATTERY_ID, CFG_SCH_PRIO_0);
 				}
 			}
 		}
 			break;/* end ACI_GATT_NOTIFICATION_VSEVT_CODE */
 
+		case ACI_GATT_DISC_READ_CHAR_BY_UUID_RESP_VSEVT_CODE: {
+			aci_gatt_disc_read_char_by_uuid_resp_event_rp0 *pr = (void*) blecore_evt->data;
+
+			if (host
+					&& host->Context.state == HID_HOST_READING_DATABASE_HASH
+					&& pr->Attribute_Value_Length == HID_DATABASE_HASH_SIZE) {
+				memcpy(host->DatabaseHash, pr->Attribute_Value, HID_DATABASE_HASH_SIZE);
+				host->DatabaseHashLength = HID_DATABASE_HASH_SIZE;
+			}
+		}
+			break; /*ACI_GATT_DISC_READ_CHAR_BY_UUID_RESP_VSEVT_CODE*/
+
+		case ACI_GATT_INDICATION_VSEVT_CODE: {
+			aci_gatt_indication_event_rp0 *pr = (void*) blecore_evt->data;
+
+			aci_gatt_confirm_indication(pr->Connection_Handle);
+			// Service Changed holds the range of the changed handles
+			if (host && host->Context.ServiceChangedCharHandle != 0
+					&& pr->Attribute_Handle == host->Context.ServiceChangedCharHandle) {
+				APP_DBG_MSG("-- GATT : Service Changed, discover again\n")
+				HID_Cache_Forget(host);
+				HID_Host_Rediscover(host);
+			}
+		}
+			break; /*ACI_GATT_INDICATION_VSEVT_CODE*/
+
 		case ACI_GATT_PROC_COMPLETE_VSEVT_CODE: {
-			aci_gatt_proc_complete_event_rp0 *pr = (void*) blecore_evt->data;
 			APP_DBG_MSG("-- GATT : ACI_GATT_PROC_COMPLETE_VSEVT_CODE \n")
 			APP_DBG_MSG("\n")
 
-			if (HIDHostContext.connHandle == pr->Connection_Handle) {
-				UTIL_SEQ_SetTask(1 << CFG_TASK_SEARCH_SERVICE_ID, CFG_SCH_PRIO_0);
+			if (host) {
+				HID_Host_Step(host);
 			}
 		}
 			break; /*ACI_GATT_PROC_COMPLETE_VSEVT_CODE*/
+
+		case ACI_GATT_TX_POOL_AVAILABLE_VSEVT_CODE:
+			HID_Output_Tx_Available();
+			break; /*ACI_GATT_TX_POOL_AVAILABLE_VSEVT_CODE*/
 		default:
 			break;
 		}
@@ -334,69 +418,456 @@ static SVCCTL_EvtAckStatus_t Event_Handler(void *Event) {
 		break;
 	}
 
+	PROFILE_END(HID_EVENT);
 	return (return_value);
 }/* end BLE_CTRL_Event_Acknowledged_Status_t */
 
-static void HID_Report_Notification(uint8_t *payload, size_t length) {
-	if (length == 16) {
-		char string[33] = { 0 };
-		for (int i = 0; i < length; i++) {
-			sprintf(&string[i * 2], "%02X", payload[i]);
+static void HID_Report_Notification(HID_Host_t *host, uint8_t *payload, size_t length, uint32_t stamp) {
+	HID_Report_t report = host->Report;
+	uint32_t changes;
+	bool queued;
+
+	// The controller repeats its last report, nothing to decode
+	if (length <= HID_REPORT_PAYLOAD_SIZE && length == host->PayloadLength
+			&& memcmp(payload, host->Payload, length) == 0) {
+		TRACE(TRACE_HID_DUPLICATE, host->Player, 0, 0, 0);
+		return;
+	}
+	host->PayloadLength = MIN(length, HID_REPORT_PAYLOAD_SIZE);
+	memcpy(host->Payload, payload, host->PayloadLength);
+
+	if (HID_Parser_Decode(&host->ReportPlan, payload, length, &report)) {
+		changes = HID_Report_Changes(host, &report);
+		// First 8 bytes of the report, big endian so they read in order as hex
+		TRACE(TRACE_HID_REPORT, host->Player, __REV(HID_Payload_Word(payload, length, 0)),
+				__REV(HID_Payload_Word(payload, length, 4)), changes);
+		Seqlock_Write_Begin(&host->ReportSeq);
+		memcpy(&host->Report, &report, sizeof(HID_Report_t));
+		host->Changes |= changes;
+		Seqlock_Write_End(&host->ReportSeq);
+		host->ReportTick = HAL_GetTick();
+		queued = Input_Report(host->Player, &host->Report, host->ReportTick, stamp);
+		// Axis noise under the change deltas does not wake the application, a stick crossing a key threshold does
+		if (changes || queued) {
+			UTIL_SEQ_SetTask(1 << CFG_TASK_APP_INPUT_ID, CFG_SCH_PRIO_0);
 		}
-		APP_DBG_MSG(string)
-		memcpy(&HIDReport, payload, length);
 	}
 
 	return;
 }
 
+static uint32_t HID_Payload_Word(const uint8_t *payload, size_t length, uint8_t offset) {
+	uint32_t word = 0;
+
+	for (uint8_t i = 0; i < 4 && offset + i < length; i++) {
+		word |= (uint32_t) payload[offset + i] << (8 * i);
+	}
+	return word;
+}
+
+static uint32_t HID_Report_Pack_Buttons(const HID_Report_t *report) {
+	return (report->BTN_A << HID_CHANGE_BTN_A) | (report->BTN_B << HID_CHANGE_BTN_B)
+			| (report->BTN_X << HID_CHANGE_BTN_X) | (report->BTN_Y << HID_CHANGE_BTN_Y)
+			| (report->BTN_BackLeft << HID_CHANGE_BTN_BACKLEFT) | (report->BTN_BackRight << HID_CHANGE_BTN_BACKRIGHT)
+			| (report->BTN_View << HID_CHANGE_BTN_VIEW) | (report->BTN_Menu << HID_CHANGE_BTN_MENU)
+			| (report->BTN_Xbox << HID_CHANGE_BTN_XBOX) | (report->BTN_Profile << HID_CHANGE_BTN_PROFILE)
+			| (report->BTN_LeftJoystick << HID_CHANGE_BTN_LEFTJOYSTICK)
+			| (report->BTN_RightJoystick << HID_CHANGE_BTN_RIGHTJOYSTICK)
+			| ((uint32_t) report->HAT_Switch << HID_CHANGE_HAT);
+}
+
+/**
+ * @brief  Fields changed by a report, buttons by XOR of the packed words, axes past their deltas
+ * @param  report: Decoded report
+ * @retval Mask of HID_CHANGE_MASK bits
+ */
+static uint32_t HID_Report_Changes(HID_Host_t *host, const HID_Report_t *report) {
+	const uint16_t axes[HID_CHANGE_AXES] = {
+		report->JOY_LeftAxisX, report->JOY_LeftAxisY, report->JOY_RightAxisX, report->JOY_RightAxisY,
+		report->TRG_Left, report->TRG_Right,
+	};
+	uint32_t buttons = HID_Report_Pack_Buttons(report);
+	uint32_t diff = buttons ^ host->ChangeButtons;
+	uint32_t changes = diff & HID_CHANGE_BUTTONS;
+
+	if (diff & ~HID_CHANGE_BUTTONS) {
+		changes |= HID_CHANGE_MASK(HID_CHANGE_HAT);
+	}
+	host->ChangeButtons = buttons;
+	for (uint8_t i = 0; i < HID_CHANGE_AXES; i++) {
+		uint16_t delta = (i + HID_CHANGE_LEFT_X < HID_CHANGE_TRG_LEFT) ? HID_CHANGE_STICK_DELTA : HID_CHANGE_TRIGGER_DELTA;
+
+		// Compared to the value of the last change, a slow drift is reported once it adds up
+		if (abs((int32_t) axes[i] - host->ChangeAxes[i]) >= delta) {
+			changes |= HID_CHANGE_MASK(HID_CHANGE_LEFT_X + i);
+			host->ChangeAxes[i] = axes[i];
+		}
+	}
+	return changes;
+}
+
+static void HID_Report_Map_Data(HID_Host_t *host, const uint8_t *data, uint8_t length) {
+	if (host->Context.state != HID_HOST_READING_REPORT_MAP) {
+		return;
+	}
+	// A longer map is truncated, its tail is usually vendor reports
+	if (length > HID_PARSER_MAP_SIZE - host->ReportMapLength) {
+		length = HID_PARSER_MAP_SIZE - host->ReportMapLength;
+	}
+	memcpy(&host->ReportMap[host->ReportMapLength], data, length);
+	host->ReportMapLength += length;
+}
+
+/**
+ * @brief  Back to the built-in Xbox plan, with the sticks centered
+ * @param  None
+ * @retval None
+ */
+static void HID_Report_Plan_Reset(HID_Host_t *host) {
+	HID_Report_t report;
+
+	HID_Parser_Default(&host->ReportPlan);
+	HID_Parser_Neutral(&report);
+	Seqlock_Write_Begin(&host->ReportSeq);
+	memcpy(&host->Report, &report, sizeof(HID_Report_t));
+	host->Changes |= HID_Report_Changes(host, &report);
+	Seqlock_Write_End(&host->ReportSeq);
+	host->ReportMapLength = 0;
+	host->PayloadLength = 0;
+}
+
+/**
+ * @brief  Read the cache from the NVM, the other player may have changed it since the last read
+ * @param  None
+ * @retval Entry of the connected controller, -1 if it is not cached
+ */
+static int8_t HID_Cache_Read(HID_Host_t *host) {
+	const uint8_t *address;
+	uint8_t type;
+
+	if (!Nvm_Read(NVM_SLOT_GATT_CACHE, &HIDCache, sizeof(HID_Cache_t))) {
+		memset(&HIDCache, 0, sizeof(HID_Cache_t));
+		return -1;
+	}
+	address = APP_BLE_Get_Peer_Address(host->Context.connHandle, &type);
+	for (uint8_t i = 0; i < HID_CACHE_PEERS; i++) {
+		const HID_CacheEntry_t *entry = &HIDCache.Entries[i];
+
+		if (entry->Stamp != 0 && entry->AddressType == type && memcmp(entry->Address, address, 6) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/**
+ * @brief  Restore the handles and the report plan of the connected controller if it is cached
+ * @param  None
+ * @retval True on a cache hit
+ */
+static bool HID_Cache_Load(HID_Host_t *host) {
+	int8_t index = HID_Cache_Read(host);
+	const HID_CacheEntry_t *entry;
+	uint16_t connHandle = host->Context.connHandle;
+
+	host->Cached = (index >= 0);
+	if (!host->Cached) {
+		return false;
+	}
+	entry = &HIDCache.Entries[index];
+	host->Context = entry->Context;
+	host->Context.connHandle = connHandle;
+	host->ReportPlan = entry->Plan;
+	// Kept with the host, the entry may be replaced before the hash of the controller is read
+	host->CachedHashValid = entry->HashValid;
+	memcpy(host->CachedHash, entry->Hash, HID_DATABASE_HASH_SIZE);
+	APP_DBG_MSG("-- GATT : Handles restored from the cache\n")
+	return true;
+}
+
+/**
+ * @brief  Check the database hash read from the controller against the cached one
+ * @param  None
+ * @retval True if the cached handles are still valid
+ */
+static bool HID_Cache_Check(HID_Host_t *host) {
+	if (!host->CachedHashValid) {
+		// Without a hash only a Service Changed indication tells the database changed, if it is enabled
+		return host->DatabaseHashLength == 0 && host->Context.ServiceChangedCharDescHandle != 0;
+	}
+	return host->DatabaseHashLength == HID_DATABASE_HASH_SIZE
+			&& memcmp(host->CachedHash, host->DatabaseHash, HID_DATABASE_HASH_SIZE) == 0;
+}
+
+/**
+ * @brief  Save the discovered handles, replacing the entry of the controller or the oldest one
+ * @param  None
+ * @retval None
+ */
+static void HID_Cache_Store(HID_Host_t *host) {
+	int8_t index;
+	HID_CacheEntry_t *entry = &HIDCache.Entries[0];
+	const uint8_t *address;
+	uint8_t type;
+
+	// Nothing would tell the handles changed, they could never be reused
+	if (host->DatabaseHashLength != HID_DATABASE_HASH_SIZE && host->Context.ServiceChangedCharDescHandle == 0) {
+		return;
+	}
+	index = HID_Cache_Read(host);
+	if (index >= 0) {
+		entry = &HIDCache.Entries[index];
+	} else {
+		for (uint8_t i = 1; i < HID_CACHE_PEERS; i++) {
+			if (HIDCache.Entries[i].Stamp < entry->Stamp) {
+				entry = &HIDCache.Entries[i];
+			}
+		}
+	}
+
+	address = APP_BLE_Get_Peer_Address(host->Context.connHandle, &type);
+	memcpy(entry->Address, address, 6);
+	entry->AddressType = type;
+	entry->HashValid = (host->DatabaseHashLength == HID_DATABASE_HASH_SIZE);
+	memcpy(entry->Hash, host->DatabaseHash, HID_DATABASE_HASH_SIZE);
+	entry->Stamp = ++HIDCache.Stamp;
+	entry->Context = host->Context;
+	entry->Context.state = HID_HOST_IDLE;
+	entry->Plan = host->ReportPlan;
+	if (Nvm_Write(NVM_SLOT_GATT_CACHE, &HIDCache, sizeof(HID_Cache_t))) {
+		APP_DBG_MSG("-- GATT : Handles saved to the cache\n")
+	}
+}
+
+/**
+ * @brief  Remove the entry of the connected controller, matched by its address
+ * @param  None
+ * @retval None
+ */
+static void HID_Cache_Forget(HID_Host_t *host) {
+	int8_t index = HID_Cache_Read(host);
+
+	host->Cached = false;
+	if (index < 0) {
+		return;
+	}
+	memset(&HIDCache.Entries[index], 0, sizeof(HID_CacheEntry_t));
+	Nvm_Write(NVM_SLOT_GATT_CACHE, &HIDCache, sizeof(HID_Cache_t));
+}
+
+/**
+ * @brief  Drop the handles and run the full discovery on the current connection
+ * @param  None
+ * @retval None
+ */
+static void HID_Host_Rediscover(HID_Host_t *host) {
+	uint16_t connHandle = host->Context.connHandle;
+
+	HID_Output_Detach(host->Player);
+	memset(&host->Context, 0, sizeof(HID_ClientContext_t));
+	host->Context.connHandle = connHandle;
+	host->Context.state = HID_HOST_EXCHANGE_MTU;
+	HID_Host_Step(host);
+}
+
+/**
+ * @brief  Disconnect a peer that is not a controller, the disconnection event frees its player
+ * @param  None
+ * @retval None
+ */
+static void HID_Host_Abort(HID_Host_t *host) {
+	tBleStatus result = aci_gap_terminate(host->Context.connHandle, HCI_REMOTE_USER_TERMINATED_CONNECTION_ERR_CODE);
+
+	if (result != BLE_STATUS_SUCCESS) {
+		APP_DBG_MSG("-- HID HOST : disconnection failed, result: 0x%x\n", result)
+	}
+}
+
+/**
+ * @brief  Take the handles used by the host from the attribute table
+ * @param  None
+ * @retval False if the peer has no HID report
+ */
+static bool HID_Host_Resolve(HID_Host_t *host) {
+	HID_Attribute_Handles_t handles;
+
+	if (!HID_Attribute_Resolve(&host->Attributes, &handles)) {
+		return false;
+	}
+	host->Context.HIDReport1CharHandle = handles.Report1;
+	host->Context.HIDClientCharDescHandle = handles.Report1Cccd;
+	host->Context.HIDReportReferenceDescHandle = handles.Report1Ref;
+	host->Context.HIDReport2CharHandle = handles.Report2;
+	host->Context.HIDReportReferenceDesc2Handle = handles.Report2Ref;
+	host->Context.HIDOutputReportCharHandle = handles.OutputReport;
+	host->Context.HIDReportMapCharHandle = handles.ReportMap;
+	host->Context.HIDReadInformationCharHandle = handles.Information;
+	host->Context.BatteryLevelCharHandle = handles.BatteryLevel;
+	host->Context.BatteryLevelCharDescHandle = handles.BatteryLevelCccd;
+	host->Context.ServiceChangedCharHandle = handles.ServiceChanged;
+	host->Context.ServiceChangedCharDescHandle = handles.ServiceChangedCccd;
+	APP_DBG_MSG("-- GATT : %d characteristics, report 0x%x, output 0x%x, report map 0x%x, battery level 0x%x\n",
+			host->Attributes.Count, handles.Report1, handles.OutputReport, handles.ReportMap, handles.BatteryLevel)
+	return true;
+}
+
+/**
+ * @brief  Connection handle to controller, a linear search over the few players
+ * @param  connHandle: Handle of the connection
+ * @retval Controller, NULL if the connection is not a controller
+ */
+static HID_Host_t* HID_Host_Find(uint16_t connHandle) {
+	for (uint8_t i = 0; i < HID_HOST_MAX_PLAYERS; i++) {
+		if (HIDHosts[i].Context.state != HID_HOST_IDLE && HIDHosts[i].Context.connHandle == connHandle) {
+			return &HIDHosts[i];
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief  Give a new connection the first free player
+ * @param  connHandle: Handle of the connection
+ * @retval Controller, NULL if every player is taken
+ */
+static HID_Host_t* HID_Host_Attach(uint16_t connHandle) {
+	for (uint8_t i = 0; i < HID_HOST_MAX_PLAYERS; i++) {
+		if (HIDHosts[i].Context.state == HID_HOST_IDLE) {
+			HIDHosts[i].Context.connHandle = connHandle;
+			return &HIDHosts[i];
+		}
+	}
+	return NULL;
+}
+
+/* Schedule the next discovery step of a controller */
+static void HID_Host_Step(HID_Host_t *host) {
+	host->Pending = true;
+	UTIL_SEQ_SetTask(1 << CFG_TASK_SEARCH_SERVICE_ID, CFG_SCH_PRIO_0);
+}
+
 static void Update_Discovery() {
+	PROFILE_BEGIN(TASK_DISCOVERY);
+
+	for (uint8_t i = 0; i < HID_HOST_MAX_PLAYERS; i++) {
+		if (HIDHosts[i].Pending) {
+			HIDHosts[i].Pending = false;
+			HID_Host_Discover(&HIDHosts[i]);
+		}
+	}
+	PROFILE_END(TASK_DISCOVERY);
+}
+
+static void HID_Host_Discover(HID_Host_t *host) {
 	uint16_t enable = 0x0001;
 
-	switch (HIDHostContext.state) {
-	case HID_HOST_DISCOVER_SERVICES:
-		APP_DBG_MSG("* GATT :  Start Searching Primary Services \r\n\r")
-		HIDHostContext.state = HID_HOST_DISCOVERING_SERVICES;
-		aci_gatt_disc_all_primary_services(HIDHostContext.connHandle);
-		break;
-	case HID_HOST_DISCOVER_HID_CHARACS:
-		APP_DBG_MSG("* GATT : Discover HID Characteristics\n")
-		HIDHostContext.state = HID_HOST_DISCOVERING_HID_CHARACS;
-		aci_gatt_disc_all_char_of_service(HIDHostContext.connHandle, HIDHostContext.HIDServiceHandle,
-				HIDHostContext.HIDServiceEndHandle);
+	switch (host->Context.state) {
+	case HID_HOST_EXCHANGE_MTU:
+		APP_DBG_MSG("* GATT : Exchange MTU\n")
+		host->Context.state = HID_HOST_EXCHANGING_MTU;
+		host->DiscoveryProcedures = 1;
+		host->DiscoveryResponses = 0;
+		if (aci_gatt_exchange_config(host->Context.connHandle) == BLE_STATUS_SUCCESS) {
+			break;
+		}
+		/* fall through */
+	case HID_HOST_EXCHANGING_MTU:
+		// Larger responses, the whole database is discovered in a few round trips
+		APP_DBG_MSG("* GATT : Discover all Characteristics\n")
+		host->Context.state = HID_HOST_DISCOVERING_CHARACS;
+		HID_Attribute_Reset(&host->Attributes);
+		host->DiscoveryProcedures++;
+		aci_gatt_disc_all_char_of_service(host->Context.connHandle, 0x0001, 0xFFFF);
 		break;
-	case HID_HOST_DISCOVER_REPORT_1_DESC:
-		APP_DBG_MSG("* GATT : Discover Descriptor of Report 1 Characteristic\n")
-		HIDHostContext.state = HID_HOST_DISCOVERING_REPORT_1_DESC;
-		aci_gatt_disc_all_char_desc(HIDHostContext.connHandle, HIDHostContext.HIDReport1CharHandle,
-				HIDHostContext.HIDReport1CharHandle + 2);
+	case HID_HOST_DISCOVERING_CHARACS:
+		if (host->Attributes.Count == 0) {
+			APP_DBG_MSG("* GATT : No Characteristic found\n")
+			HID_Host_Abort(host);
+			break;
+		}
+		APP_DBG_MSG("* GATT : Discover all Descriptors\n")
+		host->Context.state = HID_HOST_DISCOVERING_DESCS;
+		host->DiscoveryProcedures++;
+		aci_gatt_disc_all_char_desc(host->Context.connHandle, host->Attributes.Attributes[0].ValueHandle + 1, 0xFFFF);
 		break;
-	case HID_HOST_DISCOVER_REPORT_2_DESC:
-		APP_DBG_MSG("* GATT : Discover Descriptor of Report 2 Characteristic\n")
-		HIDHostContext.state = HID_HOST_DISCOVERING_REPORT_2_DESC;
-		aci_gatt_disc_all_char_desc(HIDHostContext.connHandle, HIDHostContext.HIDReport2CharHandle,
-				HIDHostContext.HIDReport2CharHandle + 2);
+	case HID_HOST_DISCOVERING_DESCS:
+		if (!HID_Host_Resolve(host)) {
+			APP_DBG_MSG("* GATT : No HID Report found\n")
+			HID_Host_Abort(host);
+			break;
+		}
+		APP_DBG_MSG("* GATT : Discovered in %d procedures, %d responses\n", host->DiscoveryProcedures, host->DiscoveryResponses)
+		host->Context.state = (host->Context.HIDReportMapCharHandle != 0) ?
+				HID_HOST_READ_REPORT_MAP : HID_HOST_READ_DATABASE_HASH;
+		HID_Host_Step(host);
 		break;
-	case HID_HOST_DISCOVER_LEVEL_CHARACS:
-		APP_DBG_MSG("* GATT : Discover Battery Characteristics\n")
-		HIDHostContext.state = HID_HOST_DISCOVERING_BAT_CHARACS;
-		aci_gatt_disc_all_char_of_service(HIDHostContext.connHandle, HIDHostContext.BatteryServiceHandle,
-				HIDHostContext.BatteryServiceEndHandle);
+	case HID_HOST_READ_REPORT_MAP:
+		APP_DBG_MSG("* GATT : Read Report Map\n")
+		host->Context.state = HID_HOST_READING_REPORT_MAP;
+		host->ReportMapLength = 0;
+		if (aci_gatt_read_long_char_value(host->Context.connHandle, host->Context.HIDReportMapCharHandle, 0)
+				!= BLE_STATUS_SUCCESS) {
+			// No procedure complete will come, the empty map falls back to the default plan
+			HID_Host_Step(host);
+		}
 		break;
-	case HID_HOST_DISCOVER_LEVEL_DESC:
-		APP_DBG_MSG("* GATT : Discover Descriptor of Battery Level Characteristic\n")
-		HIDHostContext.state = HID_HOST_DISCOVERING_LEVEL_DESC;
-		aci_gatt_disc_all_char_desc(HIDHostContext.connHandle, HIDHostContext.BatteryLevelCharHandle,
-				HIDHostContext.BatteryLevelCharHandle + 2);
+	case HID_HOST_READING_REPORT_MAP:
+		if (!HID_Parser_Compile(host->ReportMap, host->ReportMapLength, &host->ReportPlan)) {
+			APP_DBG_MSG("* GATT : Report Map of %d bytes not supported, using the default one\n", host->ReportMapLength)
+			HID_Parser_Default(&host->ReportPlan);
+		}
+		APP_DBG_MSG("* GATT : Report %d decoded from %d fields\n", host->ReportPlan.report_id, host->ReportPlan.count)
+		/* fall through */
+	case HID_HOST_READ_DATABASE_HASH: {
+		UUID_t uuid = { .UUID_16 = DATABASE_HASH_UUID };
+
+		APP_DBG_MSG("* GATT : Read Database Hash\n")
+		host->Context.state = HID_HOST_READING_DATABASE_HASH;
+		host->DatabaseHashLength = 0;
+		if (aci_gatt_read_using_char_uuid(host->Context.connHandle, 0x0001, 0xFFFF, UUID_TYPE_16, &uuid)
+				!= BLE_STATUS_SUCCESS) {
+			// No procedure complete will come, carry on without the hash
+			HID_Host_Step(host);
+		}
+	}
 		break;
+	case HID_HOST_READING_DATABASE_HASH:
+		if (host->Cached && !HID_Cache_Check(host)) {
+			APP_DBG_MSG("* GATT : Database Hash changed, discover again\n")
+			HID_Cache_Forget(host);
+			HID_Host_Rediscover(host);
+			break;
+		}
+		if (!host->Cached) {
+			HID_Cache_Store(host);
+		}
+		/* fall through */
+	case HID_HOST_ENABLE_SERVICE_CHANGED: {
+		uint16_t indicate = 0x0002;
+
+		host->Context.state = HID_HOST_ENABLING_SERVICE_CHANGED;
+		if (host->Context.ServiceChangedCharDescHandle != 0) {
+			APP_DBG_MSG("* GATT : Enable Service Changed Indication\n")
+			if (aci_gatt_write_char_desc(host->Context.connHandle, host->Context.ServiceChangedCharDescHandle, 2,
+					(uint8_t*) &indicate) == BLE_STATUS_SUCCESS) {
+				break;
+			}
+		}
+	}
+		/* fall through */
+	case HID_HOST_ENABLING_SERVICE_CHANGED:
 	case HID_HOST_ENABLE_ALL_NOTIFICATION_DESC:
 		APP_DBG_MSG("* GATT : Enable Battery Level Notification\n")
-		aci_gatt_write_char_desc(HIDHostContext.connHandle, HIDHostContext.BatteryLevelCharDescHandle, 2,
+		aci_gatt_write_char_desc(host->Context.connHandle, host->Context.BatteryLevelCharDescHandle, 2,
 				(uint8_t*) &enable);
 		APP_DBG_MSG("* GATT : Enable Report Notification\n")
-		aci_gatt_write_char_desc(HIDHostContext.connHandle, HIDHostContext.HIDClientCharDescHandle, 2,
+		aci_gatt_write_char_desc(host->Context.connHandle, host->Context.HIDClientCharDescHandle, 2,
 				(uint8_t*) &enable);
-		HIDHostContext.state = HID_HOST_DONE;
+		host->Context.state = HID_HOST_DONE;
+		HID_Output_Attach(host->Player, host->Context.connHandle, host->Context.HIDOutputReportCharHandle);
+		APP_DBG_MSG("-- HID HOST : player %d ready\n", host->Player)
+		APP_BLE_Link_Ready(host->Context.connHandle);
+		UTIL_SEQ_SetTask(1 << CFG_TASK_APP_LINK_ID, CFG_SCH_PRIO_0);
 	case HID_HOST_DONE:
 		break;
 
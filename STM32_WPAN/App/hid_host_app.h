@@ -42,18 +42,16 @@ typedef enum
 {
 	HID_HOST_IDLE,
 	HID_HOST_CONNECTED,
-	HID_HOST_DISCOVER_SERVICES,
-	HID_HOST_DISCOVERING_SERVICES,
-	HID_HOST_DISCOVER_HID_CHARACS,
-	HID_HOST_DISCOVERING_HID_CHARACS,
-	HID_HOST_DISCOVER_REPORT_1_DESC,
-	HID_HOST_DISCOVERING_REPORT_1_DESC,
-	HID_HOST_DISCOVER_REPORT_2_DESC,
-	HID_HOST_DISCOVERING_REPORT_2_DESC,
-	HID_HOST_DISCOVERING_BAT_CHARACS,
-	HID_HOST_DISCOVER_LEVEL_CHARACS,
-	HID_HOST_DISCOVER_LEVEL_DESC,
-	HID_HOST_DISCOVERING_LEVEL_DESC,
+	HID_HOST_EXCHANGE_MTU,
+	HID_HOST_EXCHANGING_MTU,
+	HID_HOST_DISCOVERING_CHARACS,
+	HID_HOST_DISCOVERING_DESCS,
+	HID_HOST_READ_REPORT_MAP,
+	HID_HOST_READING_REPORT_MAP,
+	HID_HOST_READ_DATABASE_HASH,
+	HID_HOST_READING_DATABASE_HASH,
+	HID_HOST_ENABLE_SERVICE_CHANGED,
+	HID_HOST_ENABLING_SERVICE_CHANGED,
 	HID_HOST_ENABLE_ALL_NOTIFICATION_DESC,
 	HID_HOST_DONE,
 } HID_HOST_Status_t;
@@ -66,20 +64,18 @@ typedef struct
 
 } HID_APP_ConnHandle_Not_evt_t;
 
-typedef struct __attribute__((packed))
+/* Normalized gamepad state, decoded from the controller reports by the HID parser */
+typedef struct
 {
-  uint16_t JOY_LeftAxisX;                      		 // Left Joystick X, Value = 0 to 65535
-  uint16_t JOY_LeftAxisY;                       	 // Left Joystick Y, Value = 0 to 65535
+  uint16_t JOY_LeftAxisX;                      		 // Left Joystick X, Value = 0 to 65535, centered on 0x8000
+  uint16_t JOY_LeftAxisY;                       	 // Left Joystick Y, Value = 0 to 65535, grows downwards
   uint16_t JOY_RightAxisX;                       	 // Right Joystick X, Value = 0 to 65535
   uint16_t JOY_RightAxisY;                     		 // Right Joystick Y, Value = 0 to 65535
 
-  uint16_t TRG_Left : 10;                   		 // Left Trigger, Value = 0 to 1023
-  uint8_t  : 6;
-
-  uint16_t TRG_Right : 10;             				 // Right Trigger, Value = 0 to 1023
-  uint8_t  : 6;
+  uint16_t TRG_Left;                   		 		 // Left Trigger, Value = 0 to 1023
+  uint16_t TRG_Right;             				 	 // Right Trigger, Value = 0 to 1023
 
-  uint8_t  HAT_Switch : 4;                  		// Hat switch, Value = 1 to 8, Physical = (Value - 1) x 45 in degrees
+  uint8_t  HAT_Switch;                  			 // Hat switch, Value = 1 to 8, Physical = (Value - 1) x 45 in degrees
 #define HATSWITCH_NONE          0x00
 #define HATSWITCH_UP      		0x01
 #define HATSWITCH_UPRIGHT       0x02
@@ -89,28 +85,59 @@ typedef struct __attribute__((packed))
 #define HATSWITCH_DOWNLEFT      0x06
 #define HATSWITCH_LEFT          0x07
 #define HATSWITCH_UPLEFT        0x08
-  uint8_t  : 4;
-
-  uint8_t  BTN_A : 1;
-  uint8_t  BTN_B : 1;
-  uint8_t  BTN_RightJoystick : 1;
-  uint8_t  BTN_X : 1;
-  uint8_t  BTN_Y : 1;
-  uint8_t  BTN_BackLeft : 1;
-  uint8_t  BTN_BackRight : 1;
-
-  uint8_t  : 2;
-  uint8_t  BTN_View : 1;
-  uint8_t  BTN_Menu : 1;
-  uint8_t  BTN_Xbox : 1;
-  uint8_t  BTN_LeftJoystick : 1;
-  uint8_t  : 2;
-
-  uint8_t  BTN_Profile : 1;
-  uint8_t  : 7;
+
+  // Buttons, Value = 0 or 1
+  uint8_t  BTN_A;
+  uint8_t  BTN_B;
+  uint8_t  BTN_X;
+  uint8_t  BTN_Y;
+  uint8_t  BTN_BackLeft;
+  uint8_t  BTN_BackRight;
+  uint8_t  BTN_View;
+  uint8_t  BTN_Menu;
+  uint8_t  BTN_Xbox;
+  uint8_t  BTN_Profile;
+  uint8_t  BTN_LeftJoystick;
+  uint8_t  BTN_RightJoystick;
 } HID_Report_t;
 
+/* Fields of HID_Report_t, as bits of the change mask published with each report */
+typedef enum
+{
+  HID_CHANGE_BTN_A = 0,
+  HID_CHANGE_BTN_B,
+  HID_CHANGE_BTN_X,
+  HID_CHANGE_BTN_Y,
+  HID_CHANGE_BTN_BACKLEFT,
+  HID_CHANGE_BTN_BACKRIGHT,
+  HID_CHANGE_BTN_VIEW,
+  HID_CHANGE_BTN_MENU,
+  HID_CHANGE_BTN_XBOX,
+  HID_CHANGE_BTN_PROFILE,
+  HID_CHANGE_BTN_LEFTJOYSTICK,
+  HID_CHANGE_BTN_RIGHTJOYSTICK,
+  HID_CHANGE_HAT,
+  HID_CHANGE_LEFT_X,
+  HID_CHANGE_LEFT_Y,
+  HID_CHANGE_RIGHT_X,
+  HID_CHANGE_RIGHT_Y,
+  HID_CHANGE_TRG_LEFT,
+  HID_CHANGE_TRG_RIGHT,
+  HID_CHANGE_COUNT,
+} HID_Change_t;
+
 /* Exported constants --------------------------------------------------------*/
+/* Controllers connected at the same time, at most CFG_BLE_NUM_LINK */
+#define HID_HOST_MAX_PLAYERS 2
+
+#define HID_CHANGE_MASK(change) (1UL << (change))
+#define HID_CHANGE_BUTTONS      (HID_CHANGE_MASK(HID_CHANGE_HAT) - 1)
+#define HID_CHANGE_STICKS       (HID_CHANGE_MASK(HID_CHANGE_LEFT_X) | HID_CHANGE_MASK(HID_CHANGE_LEFT_Y) \
+                                | HID_CHANGE_MASK(HID_CHANGE_RIGHT_X) | HID_CHANGE_MASK(HID_CHANGE_RIGHT_Y))
+#define HID_CHANGE_TRIGGERS     (HID_CHANGE_MASK(HID_CHANGE_TRG_LEFT) | HID_CHANGE_MASK(HID_CHANGE_TRG_RIGHT))
+/* Smallest axis moves reported as a change, in report units */
+#define HID_CHANGE_STICK_DELTA   0x0100
+#define HID_CHANGE_TRIGGER_DELTA 4
 
 /* External variables --------------------------------------------------------*/
 
@@ -119,9 +146,12 @@ typedef struct __attribute__((packed))
 /* Exported functions ---------------------------------------------*/
 void HID_Host_Init( void );
 void HID_Host_Notification( HID_APP_ConnHandle_Not_evt_t *pNotification );
-HID_HOST_Status_t HID_Host_Get_State(void);
-HID_Report_t* HID_Host_Get_Report(void);
-uint8_t HID_Host_Get_Battery_Level(void);
+HID_HOST_Status_t HID_Host_Get_State(uint8_t player);
+uint32_t HID_Host_Read_Report(uint8_t player, HID_Report_t *report);
+uint8_t HID_Host_Get_Battery_Level(uint8_t player);
+uint32_t HID_Host_Get_Report_Tick(uint8_t player);
+uint32_t HID_Host_Take_Changes(uint8_t player);
+uint8_t HID_Host_Get_Player_Count(void);
 
 #ifdef __cplusplus
 }
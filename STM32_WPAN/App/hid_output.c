@@ -0,0 +1,130 @@
+#include <string.h>
+#include "hid_output.h"
+#include "hid_host_app.h"
+#include "main.h"
+#include "app_common.h"
+#include "ble.h"
+#include "stm32_seq.h"
+#include "dbg_trace.h"
+#include "trace.h"
+#include "profile.h"
+
+// Output report 0x03 of the Xbox controller, without its ID which the characteristic implies
+#define HID_OUTPUT_REPORT_SIZE 8
+#define HID_OUTPUT_ENABLE_WEAK 0x01
+#define HID_OUTPUT_ENABLE_STRONG 0x02
+#define HID_OUTPUT_ENABLE_RIGHT 0x04
+#define HID_OUTPUT_ENABLE_LEFT 0x08
+#define HID_OUTPUT_MAGNITUDE_MAX 100
+
+typedef struct {
+	uint16_t connHandle;
+	uint16_t charHandle;	// 0 when the controller has no output report
+	// Single entry queue, a newer command replaces the one not sent yet
+	bool pending;
+	uint8_t report[HID_OUTPUT_REPORT_SIZE];
+} hid_output_t;
+
+typedef struct {
+	hid_output_t players[HID_HOST_MAX_PLAYERS];
+	// The stack TX pool is full, nothing is sent until it reports free buffers
+	bool tx_full;
+} hid_outputs_t;
+
+static hid_outputs_t outputs;
+
+static void HID_Output_Task(void);
+
+void HID_Output_Init(void) {
+	memset(&outputs, 0, sizeof(outputs));
+	UTIL_SEQ_RegTask(1 << CFG_TASK_HID_OUTPUT_ID, UTIL_SEQ_RFU, HID_Output_Task);
+}
+
+/*
+ * Called by the HID host once the controller is ready, with its output report characteristic.
+ */
+void HID_Output_Attach(uint8_t player, uint16_t connHandle, uint16_t charHandle) {
+	if (player >= HID_HOST_MAX_PLAYERS) {
+		return;
+	}
+	outputs.players[player].connHandle = connHandle;
+	outputs.players[player].charHandle = charHandle;
+	outputs.players[player].pending = false;
+}
+
+void HID_Output_Detach(uint8_t player) {
+	if (player < HID_HOST_MAX_PLAYERS) {
+		memset(&outputs.players[player], 0, sizeof(hid_output_t));
+	}
+}
+
+/*
+ * Queue a rumble command, never blocks. Return false if the controller cannot rumble.
+ */
+bool HID_Output_Rumble(uint8_t player, const HID_Rumble_t *rumble) {
+	hid_output_t *output;
+	uint8_t *report;
+
+	if (player >= HID_HOST_MAX_PLAYERS || outputs.players[player].charHandle == 0) {
+		return false;
+	}
+	output = &outputs.players[player];
+	report = output->report;
+	report[0] = HID_OUTPUT_ENABLE_WEAK | HID_OUTPUT_ENABLE_STRONG | HID_OUTPUT_ENABLE_RIGHT | HID_OUTPUT_ENABLE_LEFT;
+	report[1] = MIN(rumble->left_trigger, HID_OUTPUT_MAGNITUDE_MAX);
+	report[2] = MIN(rumble->right_trigger, HID_OUTPUT_MAGNITUDE_MAX);
+	report[3] = MIN(rumble->strong, HID_OUTPUT_MAGNITUDE_MAX);
+	report[4] = MIN(rumble->weak, HID_OUTPUT_MAGNITUDE_MAX);
+	report[5] = MIN(rumble->duration_ms / 10, UINT8_MAX);	// Sustain, unit 10 ms
+	report[6] = 0;											// Start delay, unit 10 ms
+	report[7] = 0;											// Loop count
+	output->pending = true;
+	if (!outputs.tx_full) {
+		UTIL_SEQ_SetTask(1 << CFG_TASK_HID_OUTPUT_ID, CFG_SCH_PRIO_0);
+	}
+	return true;
+}
+
+void HID_Output_Stop(uint8_t player) {
+	const HID_Rumble_t stop = { 0 };
+
+	HID_Output_Rumble(player, &stop);
+}
+
+/*
+ * Called on ACI_GATT_TX_POOL_AVAILABLE, the writes left pending can go.
+ */
+void HID_Output_Tx_Available(void) {
+	outputs.tx_full = false;
+	for (uint8_t i = 0; i < HID_HOST_MAX_PLAYERS; i++) {
+		if (outputs.players[i].pending) {
+			UTIL_SEQ_SetTask(1 << CFG_TASK_HID_OUTPUT_ID, CFG_SCH_PRIO_0);
+			return;
+		}
+	}
+}
+
+/*
+ * Write without response, the stack only copies the report into its TX pool.
+ */
+static void HID_Output_Task(void) {
+	PROFILE_BEGIN(TASK_HID_OUTPUT);
+
+	for (uint8_t i = 0; i < HID_HOST_MAX_PLAYERS && !outputs.tx_full; i++) {
+		hid_output_t *output = &outputs.players[i];
+		tBleStatus result;
+
+		if (!output->pending) {
+			continue;
+		}
+		result = aci_gatt_write_without_resp(output->connHandle, output->charHandle, HID_OUTPUT_REPORT_SIZE,
+				output->report);
+		if (result == BLE_STATUS_INSUFFICIENT_RESOURCES) {
+			outputs.tx_full = true;
+			break;
+		}
+		TRACE(TRACE_HID_OUTPUT, i, result, 0, 0);
+		output->pending = false;
+	}
+	PROFILE_END(TASK_HID_OUTPUT);
+}
@@ -0,0 +1,23 @@
+#ifndef __HID_OUTPUT_H__
+#define __HID_OUTPUT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Rumble of the Xbox controller, magnitudes 0 to 100, all zero to stop */
+typedef struct {
+	uint8_t left_trigger;
+	uint8_t right_trigger;
+	uint8_t strong;			// Left handle motor
+	uint8_t weak;			// Right handle motor
+	uint16_t duration_ms;	// Rounded to 10 ms, at most 2550 ms
+} HID_Rumble_t;
+
+void HID_Output_Init(void);
+void HID_Output_Attach(uint8_t player, uint16_t connHandle, uint16_t charHandle);
+void HID_Output_Detach(uint8_t player);
+bool HID_Output_Rumble(uint8_t player, const HID_Rumble_t *rumble);
+void HID_Output_Stop(uint8_t player);
+void HID_Output_Tx_Available(void);
+
+#endif /* __HID_OUTPUT_H__ */
@@ -0,0 +1,158 @@
+/*
+ * Replay of the ACI events of an Xbox Wireless Controller discovery through the attribute table,
+ * dispatched as the HID host event handler does, at the MTU of CFG_BLE_MAX_ATT_MTU.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "hid_attribute.h"
+#include "ble_defs.h"
+#include "ble_vs_codes.h"
+#include "uuid.h"
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			printf("%s:%d: %s\n", __FILE__, __LINE__, #condition); \
+			failures++; \
+		} \
+	} while (0)
+
+typedef struct {
+	uint16_t ecode;
+	// Pair length of a read by type response, UUID format of a find information response
+	uint8_t format;
+	uint8_t length;
+	uint8_t data[128];
+} replay_event_t;
+
+/*
+ * GAP, GATT with Service Changed, Device Information, Battery, HID with two reports, then a
+ * vendor service with a 128 bit characteristic. Descriptors are searched from the value handle
+ * of the first characteristic.
+ */
+static const replay_event_t xbox_discovery[] = {
+	{ ACI_ATT_READ_BY_TYPE_RESP_VSEVT_CODE, 7, 77, {
+			0x02, 0x00, 0x02, 0x03, 0x00, 0x00, 0x2A, 0x04, 0x00, 0x02, 0x05, 0x00, 0x01, 0x2A,
+			0x06, 0x00, 0x02, 0x07, 0x00, 0x04, 0x2A, 0x09, 0x00, 0x20, 0x0A, 0x00, 0x05, 0x2A,
+			0x0D, 0x00, 0x02, 0x0E, 0x00, 0x50, 0x2A, 0x10, 0x00, 0x12, 0x11, 0x00, 0x19, 0x2A,
+			0x14, 0x00, 0x02, 0x15, 0x00, 0x4A, 0x2A, 0x16, 0x00, 0x02, 0x17, 0x00, 0x4B, 0x2A,
+			0x18, 0x00, 0x04, 0x19, 0x00, 0x4C, 0x2A, 0x1A, 0x00, 0x12, 0x1B, 0x00, 0x4D, 0x2A,
+			0x1E, 0x00, 0x0E, 0x1F, 0x00, 0x4D, 0x2A,
+	} },
+	{ ACI_ATT_READ_BY_TYPE_RESP_VSEVT_CODE, 21, 21, {
+			0x22, 0x00, 0x18, 0x23, 0x00, 0x9E, 0xCA, 0xDC, 0x24, 0x0E, 0xE5, 0xA9, 0xE0, 0x93,
+			0xF3, 0xA3, 0xB5, 0x01, 0x00, 0x40, 0x6E,
+	} },
+	{ ACI_ATT_FIND_INFO_RESP_VSEVT_CODE, UUID_TYPE_16, 124, {
+			0x04, 0x00, 0x03, 0x28, 0x05, 0x00, 0x01, 0x2A, 0x06, 0x00, 0x03, 0x28, 0x07, 0x00,
+			0x04, 0x2A, 0x08, 0x00, 0x00, 0x28, 0x09, 0x00, 0x03, 0x28, 0x0A, 0x00, 0x05, 0x2A,
+			0x0B, 0x00, 0x02, 0x29, 0x0C, 0x00, 0x00, 0x28, 0x0D, 0x00, 0x03, 0x28, 0x0E, 0x00,
+			0x50, 0x2A, 0x0F, 0x00, 0x00, 0x28, 0x10, 0x00, 0x03, 0x28, 0x11, 0x00, 0x19, 0x2A,
+			0x12, 0x00, 0x02, 0x29, 0x13, 0x00, 0x00, 0x28, 0x14, 0x00, 0x03, 0x28, 0x15, 0x00,
+			0x4A, 0x2A, 0x16, 0x00, 0x03, 0x28, 0x17, 0x00, 0x4B, 0x2A, 0x18, 0x00, 0x03, 0x28,
+			0x19, 0x00, 0x4C, 0x2A, 0x1A, 0x00, 0x03, 0x28, 0x1B, 0x00, 0x4D, 0x2A, 0x1C, 0x00,
+			0x02, 0x29, 0x1D, 0x00, 0x08, 0x29, 0x1E, 0x00, 0x03, 0x28, 0x1F, 0x00, 0x4D, 0x2A,
+			0x20, 0x00, 0x08, 0x29, 0x21, 0x00, 0x00, 0x28, 0x22, 0x00, 0x03, 0x28,
+	} },
+	{ ACI_ATT_FIND_INFO_RESP_VSEVT_CODE, UUID_TYPE_128, 18, {
+			0x23, 0x00, 0x9E, 0xCA, 0xDC, 0x24, 0x0E, 0xE5, 0xA9, 0xE0, 0x93, 0xF3, 0xA3, 0xB5,
+			0x01, 0x00, 0x40, 0x6E,
+	} },
+	{ ACI_ATT_FIND_INFO_RESP_VSEVT_CODE, UUID_TYPE_16, 4, {
+			0x24, 0x00, 0x02, 0x29,
+	} },
+};
+
+static unsigned failures;
+
+static void Replay(HID_Attribute_Table_t *table, const replay_event_t *events, size_t count) {
+	HID_Attribute_Reset(table);
+	for (size_t i = 0; i < count; i++) {
+		const replay_event_t *event = &events[i];
+
+		if (event->ecode == ACI_ATT_READ_BY_TYPE_RESP_VSEVT_CODE) {
+			HID_Attribute_Characs(table, event->data, event->length, event->format);
+		} else if (event->ecode == ACI_ATT_FIND_INFO_RESP_VSEVT_CODE && event->format == UUID_TYPE_16) {
+			HID_Attribute_Descs(table, event->data, event->length);
+		}
+	}
+}
+
+static void Test_Xbox_Discovery(void) {
+	HID_Attribute_Table_t table;
+	HID_Attribute_Handles_t handles;
+	const HID_Attribute_t *attribute;
+
+	Replay(&table, xbox_discovery, sizeof(xbox_discovery) / sizeof(xbox_discovery[0]));
+	CHECK(table.Count == 12);
+	CHECK(HID_Attribute_Resolve(&table, &handles));
+	CHECK(handles.Report1 == 0x001B);
+	CHECK(handles.Report1Cccd == 0x001C);
+	CHECK(handles.Report1Ref == 0x001D);
+	CHECK(handles.Report2 == 0x001F);
+	CHECK(handles.Report2Ref == 0x0020);
+	// The HID Control Point is also written without response, but it is not a report
+	CHECK(handles.OutputReport == 0x001F);
+	CHECK(handles.ReportMap == 0x0017);
+	CHECK(handles.Information == 0x0015);
+	CHECK(handles.BatteryLevel == 0x0011);
+	CHECK(handles.BatteryLevelCccd == 0x0012);
+	CHECK(handles.ServiceChanged == 0x000A);
+	CHECK(handles.ServiceChangedCccd == 0x000B);
+
+	// The CCCD of the vendor characteristic is not given to the output report before it
+	attribute = HID_Attribute_Find(&table, REPORT_CHAR_UUID, 1);
+	CHECK(attribute && attribute->CccdHandle == 0);
+	attribute = &table.Attributes[table.Count - 1];
+	CHECK(attribute->Uuid == 0 && attribute->ValueHandle == 0x0023 && attribute->CccdHandle == 0x0024);
+}
+
+static void Test_No_Report(void) {
+	HID_Attribute_Table_t table;
+	HID_Attribute_Handles_t handles;
+	// GAP and Battery only
+	const uint8_t characs[] = { 0x02, 0x00, 0x02, 0x03, 0x00, 0x00, 0x2A, 0x10, 0x00, 0x12, 0x11, 0x00, 0x19, 0x2A };
+
+	HID_Attribute_Reset(&table);
+	HID_Attribute_Characs(&table, characs, sizeof(characs), 7);
+	CHECK(table.Count == 2);
+	CHECK(!HID_Attribute_Resolve(&table, &handles));
+	CHECK(handles.BatteryLevel == 0);
+	CHECK(handles.ServiceChanged == 0);
+}
+
+static void Test_Malformed(void) {
+	HID_Attribute_Table_t table;
+	uint8_t characs[7 * (HID_MAX_ATTRIBUTES + 4)];
+
+	HID_Attribute_Reset(&table);
+	// Unknown pair length, and a truncated pair
+	HID_Attribute_Characs(&table, xbox_discovery[0].data, 77, 9);
+	CHECK(table.Count == 0);
+	HID_Attribute_Characs(&table, xbox_discovery[0].data, 6, 7);
+	CHECK(table.Count == 0);
+
+	// More characteristics than the table holds
+	for (uint8_t i = 0; i < HID_MAX_ATTRIBUTES + 4; i++) {
+		const uint8_t pair[7] = { 2 * i + 1, 0x00, 0x02, 2 * i + 2, 0x00, 0x4D, 0x2A };
+
+		memcpy(&characs[7 * i], pair, sizeof(pair));
+	}
+	HID_Attribute_Characs(&table, characs, sizeof(characs), 7);
+	CHECK(table.Count == HID_MAX_ATTRIBUTES);
+
+	// A descriptor before every characteristic has no owner
+	HID_Attribute_Reset(&table);
+	HID_Attribute_Characs(&table, &xbox_discovery[0].data[63], 14, 7);
+	HID_Attribute_Descs(&table, (const uint8_t[]) { 0x05, 0x00, 0x02, 0x29 }, 4);
+	CHECK(table.Attributes[0].CccdHandle == 0 && table.Attributes[1].CccdHandle == 0);
+}
+
+int main(void) {
+	Test_Xbox_Discovery();
+	Test_No_Report();
+	Test_Malformed();
+
+	printf("hid_attribute: %u failures\n", failures);
+	return failures ? 1 : 0;
+}
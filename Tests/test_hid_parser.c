@@ -0,0 +1,170 @@
+/*
+ * Report map compilation and report decoding, with the map of an Xbox Wireless Controller.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "hid_parser.h"
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			printf("%s:%d: %s\n", __FILE__, __LINE__, #condition); \
+			failures++; \
+		} \
+	} while (0)
+
+/*
+ * Gamepad input report 1 of 16 bytes, then the rumble output report 3 and the battery report 4.
+ */
+static const uint8_t xbox_map[] = {
+	0x05, 0x01, 0x09, 0x05, 0xA1, 0x01, 0x85, 0x01,
+	// Left and right sticks
+	0xA1, 0x00, 0x09, 0x30, 0x09, 0x31, 0x15, 0x00, 0x27, 0xFF, 0xFF, 0x00, 0x00, 0x95, 0x02, 0x75,
+	0x10, 0x81, 0x02, 0xC0,
+	0xA1, 0x00, 0x09, 0x32, 0x09, 0x35, 0x15, 0x00, 0x27, 0xFF, 0xFF, 0x00, 0x00, 0x95, 0x02, 0x75,
+	0x10, 0x81, 0x02, 0xC0,
+	// Brake and accelerator, 10 bits padded to 16
+	0x05, 0x02, 0x09, 0xC5, 0x15, 0x00, 0x26, 0xFF, 0x03, 0x95, 0x01, 0x75, 0x0A, 0x81, 0x02, 0x15,
+	0x00, 0x25, 0x00, 0x75, 0x06, 0x95, 0x01, 0x81, 0x03,
+	0x05, 0x02, 0x09, 0xC4, 0x15, 0x00, 0x26, 0xFF, 0x03, 0x95, 0x01, 0x75, 0x0A, 0x81, 0x02, 0x15,
+	0x00, 0x25, 0x00, 0x75, 0x06, 0x95, 0x01, 0x81, 0x03,
+	// Hat switch with its physical range and unit, 4 bits padded to 8
+	0x05, 0x01, 0x09, 0x39, 0x15, 0x01, 0x25, 0x08, 0x35, 0x00, 0x46, 0x3B, 0x01, 0x66, 0x14, 0x00,
+	0x75, 0x04, 0x95, 0x01, 0x81, 0x42, 0x75, 0x04, 0x95, 0x01, 0x15, 0x00, 0x25, 0x00, 0x35, 0x00,
+	0x45, 0x00, 0x65, 0x00, 0x81, 0x03,
+	// 15 buttons padded to 16
+	0x05, 0x09, 0x19, 0x01, 0x29, 0x0F, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x0F, 0x81, 0x02,
+	0x15, 0x00, 0x25, 0x00, 0x75, 0x01, 0x95, 0x01, 0x81, 0x03,
+	// Record button padded to 8
+	0x05, 0x0C, 0x0A, 0xB2, 0x00, 0x15, 0x00, 0x25, 0x01, 0x95, 0x01, 0x75, 0x01, 0x81, 0x02, 0x15,
+	0x00, 0x25, 0x00, 0x75, 0x07, 0x95, 0x01, 0x81, 0x03,
+	// Rumble output report
+	0x05, 0x0F, 0x09, 0x21, 0x85, 0x03, 0xA1, 0x02, 0x09, 0x97, 0x15, 0x00, 0x25, 0x01, 0x75, 0x04,
+	0x95, 0x01, 0x91, 0x02, 0x15, 0x00, 0x25, 0x00, 0x75, 0x04, 0x95, 0x01, 0x91, 0x03, 0x09, 0x70,
+	0x15, 0x00, 0x25, 0x64, 0x75, 0x08, 0x95, 0x04, 0x91, 0x02, 0x09, 0x50, 0x66, 0x01, 0x10, 0x55,
+	0x0E, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, 0x01, 0x91, 0x02, 0x09, 0xA7, 0x15, 0x00,
+	0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, 0x01, 0x91, 0x02, 0x65, 0x00, 0x55, 0x00, 0x09, 0x7C, 0x15,
+	0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, 0x01, 0x91, 0x02, 0xC0,
+	// Battery strength input report
+	0x85, 0x04, 0x05, 0x06, 0x09, 0x20, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, 0x01, 0x81,
+	0x02, 0xC0,
+};
+
+static const uint8_t neutral_payload[16] = {
+	0x00, 0x80, 0x00, 0x80, 0x00, 0x80, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+/*
+ * Left stick full right and up, right stick off center, left trigger fully pressed with its padding
+ * bits set, right trigger half way, hat right, A, X and Menu pressed, Record pressed.
+ */
+static const uint8_t pressed_payload[16] = {
+	0xFF, 0xFF, 0x00, 0x00, 0x34, 0x12, 0xCD, 0xAB, 0xFF, 0xFF, 0x00, 0x02, 0x03, 0x09, 0x04, 0x01,
+};
+
+static unsigned failures;
+
+/* Field by field, the padding of the struct is not written by the decoder */
+static bool Report_Equal(const HID_Report_t *a, const HID_Report_t *b) {
+	return a->JOY_LeftAxisX == b->JOY_LeftAxisX && a->JOY_LeftAxisY == b->JOY_LeftAxisY
+			&& a->JOY_RightAxisX == b->JOY_RightAxisX && a->JOY_RightAxisY == b->JOY_RightAxisY
+			&& a->TRG_Left == b->TRG_Left && a->TRG_Right == b->TRG_Right && a->HAT_Switch == b->HAT_Switch
+			&& a->BTN_A == b->BTN_A && a->BTN_B == b->BTN_B && a->BTN_X == b->BTN_X && a->BTN_Y == b->BTN_Y
+			&& a->BTN_BackLeft == b->BTN_BackLeft && a->BTN_BackRight == b->BTN_BackRight
+			&& a->BTN_View == b->BTN_View && a->BTN_Menu == b->BTN_Menu && a->BTN_Xbox == b->BTN_Xbox
+			&& a->BTN_Profile == b->BTN_Profile && a->BTN_LeftJoystick == b->BTN_LeftJoystick
+			&& a->BTN_RightJoystick == b->BTN_RightJoystick;
+}
+
+static void Test_Compile(HID_Plan_t *plan) {
+	CHECK(HID_Parser_Compile(xbox_map, sizeof(xbox_map), plan));
+	CHECK(plan->report_id == 1);
+	CHECK(plan->length == 16);
+	// 4 axes, 2 triggers, the hat, 11 of the 15 buttons and Record
+	CHECK(plan->count == 19);
+}
+
+static void Test_Neutral(const HID_Plan_t *plan) {
+	HID_Report_t report, neutral;
+
+	HID_Parser_Neutral(&neutral);
+	memset(&report, 0xAA, sizeof(report));
+	CHECK(HID_Parser_Decode(plan, neutral_payload, sizeof(neutral_payload), &report));
+	// Every field is covered by the plan, none keeps the filler
+	CHECK(Report_Equal(&report, &neutral));
+}
+
+static void Test_Pressed(const HID_Plan_t *plan) {
+	HID_Report_t report;
+
+	HID_Parser_Neutral(&report);
+	CHECK(HID_Parser_Decode(plan, pressed_payload, sizeof(pressed_payload), &report));
+	CHECK(report.JOY_LeftAxisX == 0xFFFF);
+	CHECK(report.JOY_LeftAxisY == 0x0000);
+	CHECK(report.JOY_RightAxisX == 0x1234);
+	CHECK(report.JOY_RightAxisY == 0xABCD);
+	CHECK(report.TRG_Left == 1023);
+	CHECK(report.TRG_Right == 512);
+	CHECK(report.HAT_Switch == HATSWITCH_RIGHT);
+	CHECK(report.BTN_A == 1);
+	CHECK(report.BTN_B == 0);
+	CHECK(report.BTN_X == 1);
+	CHECK(report.BTN_Y == 0);
+	CHECK(report.BTN_Menu == 1);
+	CHECK(report.BTN_View == 0);
+	CHECK(report.BTN_Xbox == 0);
+	CHECK(report.BTN_Profile == 1);
+}
+
+static void Test_Hat(const HID_Plan_t *plan) {
+	uint8_t payload[16];
+	HID_Report_t report;
+
+	memcpy(payload, neutral_payload, sizeof(payload));
+	for (uint8_t hat = 0; hat <= 0x0F; hat++) {
+		payload[12] = hat;
+		HID_Parser_Neutral(&report);
+		CHECK(HID_Parser_Decode(plan, payload, sizeof(payload), &report));
+		// 1 to 8 are the directions, anything else is the null state
+		CHECK(report.HAT_Switch == ((hat >= 1 && hat <= 8) ? hat : HATSWITCH_NONE));
+	}
+}
+
+static void Test_Default(const HID_Plan_t *plan) {
+	HID_Plan_t fallback;
+	HID_Report_t expected, report;
+
+	// The built-in plan decodes the reports of the controller as its own map does
+	HID_Parser_Default(&fallback);
+	CHECK(fallback.length == plan->length);
+	HID_Parser_Neutral(&expected);
+	HID_Parser_Neutral(&report);
+	HID_Parser_Decode(plan, pressed_payload, sizeof(pressed_payload), &expected);
+	CHECK(HID_Parser_Decode(&fallback, pressed_payload, sizeof(pressed_payload), &report));
+	CHECK(Report_Equal(&report, &expected));
+}
+
+static void Test_Malformed(const HID_Plan_t *plan) {
+	HID_Plan_t broken;
+	HID_Report_t report;
+
+	// A report shorter than the plan is not decoded
+	CHECK(!HID_Parser_Decode(plan, pressed_payload, 15, &report));
+	// A map cut in the middle of an item, and a map without any gamepad usage
+	CHECK(!HID_Parser_Compile(xbox_map, 17, &broken));
+	CHECK(!HID_Parser_Compile(&xbox_map[sizeof(xbox_map) - 18], 18, &broken));
+}
+
+int main(void) {
+	HID_Plan_t plan;
+
+	Test_Compile(&plan);
+	Test_Neutral(&plan);
+	Test_Pressed(&plan);
+	Test_Hat(&plan);
+	Test_Default(&plan);
+	Test_Malformed(&plan);
+
+	printf("hid_parser: %u failures\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * Profiling zone statistics and their dump, on the host clock of PROFILE_HOST.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "profile.h"
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			printf("%s:%d: %s\n", __FILE__, __LINE__, #condition); \
+			failures++; \
+		} \
+	} while (0)
+
+typedef struct {
+	unsigned long count;
+	unsigned long min;
+	unsigned long avg;
+	unsigned long max;
+	unsigned long total_k;
+} dump_row_t;
+
+static unsigned failures;
+
+/* Run the dump with stdout captured, return the number of zone rows, the header is skipped */
+static unsigned Dump_Capture(const char *name, dump_row_t *row) {
+	char line[160];
+	unsigned rows = 0;
+	FILE *capture = tmpfile();
+	int saved;
+
+	fflush(stdout);
+	saved = dup(fileno(stdout));
+	dup2(fileno(capture), fileno(stdout));
+	Profile_Dump();
+	fflush(stdout);
+	dup2(saved, fileno(stdout));
+	close(saved);
+
+	rewind(capture);
+	fgets(line, sizeof(line), capture);
+	while (fgets(line, sizeof(line), capture)) {
+		rows++;
+		// The name is padded to 20 columns
+		if (strncmp(line, name, strlen(name)) == 0 && line[strlen(name)] == ' ') {
+			sscanf(&line[20], "%lu %lu %lu %lu %lu", &row->count, &row->min, &row->avg, &row->max, &row->total_k);
+		}
+	}
+	fclose(capture);
+	return rows;
+}
+
+static void Test_Add(void) {
+	const Profile_Zone_t *zone = Profile_Get_Zone(PROFILE_TASK_FRAME);
+
+	Profile_Reset();
+	CHECK(zone->count == 0);
+	Profile_Add(PROFILE_TASK_FRAME, 3000);
+	Profile_Add(PROFILE_TASK_FRAME, 1000);
+	Profile_Add(PROFILE_TASK_FRAME, 2000);
+	CHECK(zone->count == 3);
+	CHECK(zone->min == 1000);
+	CHECK(zone->max == 3000);
+	CHECK(zone->total == 6000);
+
+	// The first sample sets the minimum, even when it is 0
+	Profile_Add(PROFILE_TASK_INPUT, 0);
+	Profile_Add(PROFILE_TASK_INPUT, 5);
+	CHECK(Profile_Get_Zone(PROFILE_TASK_INPUT)->min == 0);
+	CHECK(Profile_Get_Zone(PROFILE_TASK_INPUT)->max == 5);
+
+	// The total does not wrap with the 32 bit samples
+	Profile_Add(PROFILE_LCD_FILL, UINT32_MAX);
+	Profile_Add(PROFILE_LCD_FILL, UINT32_MAX);
+	CHECK(Profile_Get_Zone(PROFILE_LCD_FILL)->total == 2ULL * UINT32_MAX);
+
+	CHECK(Profile_Get_Zone(PROFILE_ZONE_COUNT) == NULL);
+}
+
+static void Test_Dump(void) {
+	dump_row_t row = { 0 };
+
+	Profile_Reset();
+	Profile_Add(PROFILE_TASK_FRAME, 3000);
+	Profile_Add(PROFILE_TASK_FRAME, 1000);
+	Profile_Add(PROFILE_TASK_FRAME, 2500);
+	Profile_Add(PROFILE_LCD_FILL, UINT32_MAX);
+	Profile_Add(PROFILE_LCD_FILL, UINT32_MAX);
+
+	// Zones without samples are not printed
+	CHECK(Dump_Capture("task frame", &row) == 2);
+	CHECK(row.count == 3);
+	CHECK(row.min == 1000);
+	// Average rounded down, total in thousands
+	CHECK(row.avg == 2166);
+	CHECK(row.max == 3000);
+	CHECK(row.total_k == 6);
+
+	memset(&row, 0, sizeof(row));
+	Dump_Capture("ST7735 fill", &row);
+	CHECK(row.avg == UINT32_MAX);
+	CHECK(row.total_k == 2ULL * UINT32_MAX / 1000);
+}
+
+static void Test_Reset(void) {
+	dump_row_t row = { 0 };
+
+	Profile_Add(PROFILE_TASK_LINK, 10);
+	Profile_Reset();
+	for (int i = 0; i < PROFILE_ZONE_COUNT; i++) {
+		CHECK(Profile_Get_Zone(i)->count == 0 && Profile_Get_Zone(i)->total == 0);
+	}
+	CHECK(Dump_Capture("task link", &row) == 0);
+}
+
+static void Test_Macros(void) {
+	const Profile_Zone_t *zone = Profile_Get_Zone(PROFILE_STAGE_UPDATE);
+
+	Profile_Reset();
+	{
+		PROFILE_BEGIN(STAGE_UPDATE);
+
+		usleep(1000);
+		PROFILE_END(STAGE_UPDATE);
+	}
+	CHECK(zone->count == 1);
+	CHECK(zone->min >= 1000000);
+}
+
+int main(void) {
+	Test_Add();
+	Test_Dump();
+	Test_Reset();
+	Test_Macros();
+
+	printf("profile: %u failures\n", failures);
+	return failures ? 1 : 0;
+}
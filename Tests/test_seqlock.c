@@ -0,0 +1,78 @@
+/*
+ * Stress test of the sequence lock: a writer thread publishes records whose words all hold
+ * the same value, reader threads check they never copy a record mixing two writes.
+ */
+#include <stdio.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "seqlock.h"
+
+#define WRITES 2000000
+#define READERS 2
+#define RECORD_WORDS 16
+
+typedef struct {
+	uint32_t words[RECORD_WORDS];
+} record_t;
+
+static Seqlock_t seq;
+static volatile record_t shared;
+static volatile bool writing = true;
+
+static void* Writer(void *arg) {
+	record_t record;
+
+	for (uint32_t n = 1; n <= WRITES; n++) {
+		for (uint8_t i = 0; i < RECORD_WORDS; i++) {
+			record.words[i] = n;
+		}
+		Seqlock_Write_Begin(&seq);
+		memcpy((void*) &shared, &record, sizeof(record_t));
+		Seqlock_Write_End(&seq);
+	}
+	writing = false;
+	return NULL;
+}
+
+static void* Reader(void *arg) {
+	uintptr_t failures = 0;
+	uint32_t last = 0;
+	record_t record;
+
+	while (writing) {
+		uint32_t writes = Seqlock_Read(&seq, &record, &shared, sizeof(record_t));
+
+		// The record of write n is published once n writes are counted
+		if (writes < last || record.words[0] != writes) {
+			failures++;
+		}
+		for (uint8_t i = 1; i < RECORD_WORDS; i++) {
+			if (record.words[i] != record.words[0]) {
+				failures++;
+				break;
+			}
+		}
+		last = writes;
+	}
+	return (void*) failures;
+}
+
+int main(void) {
+	pthread_t writer, readers[READERS];
+	uintptr_t failures = 0;
+
+	for (uint8_t i = 0; i < READERS; i++) {
+		pthread_create(&readers[i], NULL, Reader, NULL);
+	}
+	pthread_create(&writer, NULL, Writer, NULL);
+	pthread_join(writer, NULL);
+	for (uint8_t i = 0; i < READERS; i++) {
+		void *result;
+
+		pthread_join(readers[i], &result);
+		failures += (uintptr_t) result;
+	}
+
+	printf("seqlock: %u writes, %lu torn reads\n", WRITES, (unsigned long) failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""Decode the binary trace records of the console, mixed with the text traces on the same UART.
+
+The event table is read from Core/Inc/trace.h, so the decoder follows the firmware it is run from.
+
+    trace_decode.py capture.bin
+    trace_decode.py --port /dev/ttyACM0
+"""
+import argparse
+import os
+import re
+import struct
+import sys
+
+TRACE_SYNC = 0xA5
+RECORD = struct.Struct('<BBHI4I')
+HEADER = os.path.join(os.path.dirname(__file__), '..', 'Core', 'Inc', 'trace.h')
+
+
+def load_events(path):
+    events = []
+    with open(path) as header:
+        for line in header:
+            match = re.match(r'\s*X\((\w+),\s*("(?:[^"\\]|\\.)*")\)', line)
+            if match:
+                events.append((match.group(1), match.group(2)[1:-1]))
+    return events
+
+
+def format_record(events, record):
+    _, event_id, seq, stamp, *args = record
+    name, fmt = events[event_id]
+    count = len(re.findall(r'%[^%]', fmt.replace('%%', '')))
+    return '[%10.3f ms] #%05u %s: %s' % (stamp / 1000, seq, name, fmt % tuple(args[:count]))
+
+
+def decode(stream, events, out):
+    pending = b''
+    text = bytearray()
+    last_seq = None
+    while True:
+        chunk = stream.read(256)
+        if not chunk:
+            break
+        pending += chunk
+        while pending:
+            sync = pending.find(bytes([TRACE_SYNC]))
+            if sync < 0:
+                text += pending
+                pending = b''
+                break
+            text += pending[:sync]
+            pending = pending[sync:]
+            if len(pending) < RECORD.size:
+                break
+            record = RECORD.unpack_from(pending)
+            if record[1] >= len(events):
+                # Not a record, a stray byte
+                pending = pending[1:]
+                continue
+            if text:
+                out.write(text.decode('ascii', 'replace'))
+                text.clear()
+            if last_seq is not None and (record[2] - last_seq) & 0xFFFF != 1:
+                out.write('\n-- %d records lost' % (((record[2] - last_seq) & 0xFFFF) - 1))
+            last_seq = record[2]
+            out.write('\n' + format_record(events, record) + '\n')
+            pending = pending[RECORD.size:]
+        if text:
+            out.write(text.decode('ascii', 'replace'))
+            text.clear()
+        out.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('capture', nargs='?', help='raw UART capture, stdin if omitted')
+    parser.add_argument('--port', help='serial port to read live, needs pyserial')
+    parser.add_argument('--baud', type=int, default=115200)
+    parser.add_argument('--header', default=HEADER, help='trace.h holding the event table')
+    options = parser.parse_args()
+
+    events = load_events(options.header)
+    if options.port:
+        import serial
+        stream = serial.Serial(options.port, options.baud, timeout=None)
+    elif options.capture:
+        stream = open(options.capture, 'rb')
+    else:
+        stream = sys.stdin.buffer
+    try:
+        decode(stream, events, sys.stdout)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()